@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "dataset.h"
+#ifdef _WIN32
+#define NO_MMAP
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const int elemsizes[4] = {1, 4, 4, 8};
+
+int dset_init_header(dset_header *h, const char *name, const char *attrs,
+		     int type, int ndims, const int *dims, const int *chunk) {
+  int d;
+
+  if (ndims < 1 || ndims > DSET_MAXDIMS || type < DSET_CHAR || type > DSET_DOUBLE)
+    return -1;
+  memset(h, 0, sizeof(dset_header));
+  h->version = DSET_VERSION;
+  h->ndims = ndims;
+  h->type = type;
+  h->elemsize = elemsizes[type];
+  for (d=0; d<ndims; d++) {
+    if (dims[d] < 1 || chunk[d] < 1) return -1;
+    h->dims[d] = dims[d];
+    h->chunk[d] = chunk[d] < dims[d] ? chunk[d] : dims[d];
+  }
+  h->nchunks = 1;
+  for (d=0; d<ndims; d++) h->nchunks *= dset_chunks_along(h, d);
+  h->index_offset = DSET_HEADERSIZE;
+  h->data_offset = DSET_HEADERSIZE + 2*h->nchunks*sizeof(long long);
+  strncpy(h->name, name ? name : "", sizeof(h->name)-1);
+  strncpy(h->attrs, attrs ? attrs : "", sizeof(h->attrs)-1);
+  return 0;
+}
+
+void dset_pack_header(const dset_header *h, unsigned char *buf) {
+  memset(buf, 0, DSET_HEADERSIZE);
+  memcpy(buf, DSET_MAGIC, 8);
+  memcpy(&buf[8], &h->version, 7*sizeof(long long));
+  memcpy(&buf[64], h->dims, DSET_MAXDIMS*sizeof(long long));
+  memcpy(&buf[128], h->chunk, DSET_MAXDIMS*sizeof(long long));
+  memcpy(&buf[192], h->name, sizeof(h->name));
+  memcpy(&buf[256], h->attrs, sizeof(h->attrs));
+}
+
+int dset_unpack_header(const unsigned char *buf, dset_header *h) {
+  long long n = 1, e = 1, along;
+  int d;
+
+  if (memcmp(buf, DSET_MAGIC, 8) != 0) return -1;
+  memcpy(&h->version, &buf[8], 7*sizeof(long long));
+  memcpy(h->dims, &buf[64], DSET_MAXDIMS*sizeof(long long));
+  memcpy(h->chunk, &buf[128], DSET_MAXDIMS*sizeof(long long));
+  memcpy(h->name, &buf[192], sizeof(h->name));
+  memcpy(h->attrs, &buf[256], sizeof(h->attrs));
+  h->name[sizeof(h->name)-1] = 0;
+  h->attrs[sizeof(h->attrs)-1] = 0;
+  /* The same checks as in dset_init_header, so that a corrupt or
+     foreign file cannot make the readers divide by zero or index out of
+     bounds. The products are checked for overflow as they are formed */
+  if (h->version != DSET_VERSION || h->ndims < 1 || h->ndims > DSET_MAXDIMS ||
+      h->type < DSET_CHAR || h->type > DSET_DOUBLE || h->elemsize != elemsizes[h->type])
+    return -1;
+  for (d=0; d<h->ndims; d++) {
+    if (h->dims[d] < 1 || h->dims[d] > INT_MAX || h->chunk[d] < 1 || h->chunk[d] > h->dims[d])
+      return -1;
+    along = dset_chunks_along(h, d);
+    if (along > h->nchunks/n || h->chunk[d] > LLONG_MAX/16/e) return -1;
+    n *= along;
+    e *= h->chunk[d];
+  }
+  if (n != h->nchunks || n > LLONG_MAX/16 || e > LLONG_MAX/16/n ||
+      h->index_offset != DSET_HEADERSIZE ||
+      h->data_offset != DSET_HEADERSIZE + 2*n*(long long)sizeof(long long))
+    return -1;
+  return 0;
+}
+
+long long dset_chunks_along(const dset_header *h, int d) {
+  return (h->dims[d] + h->chunk[d] - 1)/h->chunk[d];
+}
+
+long long dset_chunk_elements(const dset_header *h) {
+  long long n = 1;
+  int d;
+  for (d=0; d<h->ndims; d++) n *= h->chunk[d];
+  return n;
+}
+
+int dset_map(const char *filename, dset_file *f) {
+#ifdef NO_MMAP
+  /* Read the whole file instead */
+  FILE *fp = fopen(filename, "rb");
+  long size;
+
+  if (fp == NULL) return -1;
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  f->data = (unsigned char *) malloc(size);
+  f->size = size;
+  f->fd = -1;
+  if (fread(f->data, 1, size, fp) != (size_t) size) {
+    fclose(fp);
+    free(f->data);
+    return -1;
+  }
+  fclose(fp);
+#else
+  struct stat st;
+
+  f->fd = open(filename, O_RDONLY);
+  if (f->fd < 0) return -1;
+  if (fstat(f->fd, &st) != 0) {
+    close(f->fd);
+    return -1;
+  }
+  f->size = st.st_size;
+  f->data = (unsigned char *) mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+  if (f->data == MAP_FAILED) {
+    close(f->fd);
+    return -1;
+  }
+#endif
+  if (f->size < DSET_HEADERSIZE || dset_unpack_header(f->data, &f->h) != 0 ||
+      f->h.data_offset + f->h.nchunks*f->h.elemsize*dset_chunk_elements(&f->h) > (long long) f->size) {
+    dset_unmap(f);
+    return -1;
+  }
+  f->index = (long long *) &f->data[f->h.index_offset];
+  return 0;
+}
+
+void dset_unmap(dset_file *f) {
+#ifdef NO_MMAP
+  free(f->data);
+#else
+  munmap(f->data, f->size);
+  close(f->fd);
+#endif
+  f->data = NULL;
+}
+
+void *dset_chunk(dset_file *f, const long long *coords) {
+  long long c = 0;
+  int d;
+  for (d=0; d<f->h.ndims; d++) c = c*dset_chunks_along(&f->h, d) + coords[d];
+  return &f->data[f->index[2*c]];
+}
+
+double dset_get(dset_file *f, const long long *idx) {
+  long long coords[DSET_MAXDIMS], i = 0;
+  unsigned char *p;
+  int d;
+
+  for (d=0; d<f->h.ndims; d++) {
+    coords[d] = idx[d]/f->h.chunk[d];
+    i = i*f->h.chunk[d] + idx[d]%f->h.chunk[d];
+  }
+  p = (unsigned char *) dset_chunk(f, coords) + i*f->h.elemsize;
+  switch (f->h.type) {
+  case DSET_CHAR: return (double) *(char *) p;
+  case DSET_INT: return (double) *(int *) p;
+  case DSET_FLOAT: return (double) *(float *) p;
+  default: return *(double *) p;
+  }
+}
@@ -0,0 +1,88 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+/*
+  A simple self-describing file format for N-dimensional arrays, such
+  as snapshots from simulations.
+
+  The array is divided into chunks of equal size, and the file contains
+  the chunks one after the other in row-major order of the chunks. The
+  elements in a chunk are also in row-major order. Chunks at the upper
+  edges of the array are stored with full size, the elements outside
+  the array are zero. The file layout is
+
+    header   512 bytes, see dset_header below
+    index    two 64-bit integers per chunk: file offset and size
+    chunks
+
+  All numbers are stored in the byte order of the machine that wrote
+  the file. The version field can be used to check that the byte order
+  is the same.
+
+  The functions in this file do not use MPI and can be used by serial
+  tools. They map the whole file into memory, so any chunk or element
+  can be accessed without reading the rest of the file. Parallel
+  reading and writing is done with the functions in mpi_dataset.c.
+*/
+
+#include <stddef.h>
+
+#define DSET_MAGIC "PaPPdset"
+#define DSET_VERSION 1
+#define DSET_MAXDIMS 8
+#define DSET_HEADERSIZE 512
+
+/* Element types */
+#define DSET_CHAR   0
+#define DSET_INT    1
+#define DSET_FLOAT  2
+#define DSET_DOUBLE 3
+
+typedef struct {
+  long long version;
+  long long ndims;
+  long long type;                    /* DSET_INT, DSET_FLOAT, ... */
+  long long elemsize;                /* Bytes per element */
+  long long nchunks;
+  long long index_offset;            /* File offset of the chunk index */
+  long long data_offset;             /* File offset of the first chunk */
+  long long dims[DSET_MAXDIMS];      /* Size of the array */
+  long long chunk[DSET_MAXDIMS];     /* Size of a chunk */
+  char name[64];                     /* Name of the array */
+  char attrs[256];                   /* Free text, e.g. "step=10 r=0.2" */
+} dset_header;
+
+typedef struct {
+  dset_header h;
+  unsigned char *data;               /* The whole file */
+  size_t size;
+  long long *index;
+  int fd;
+} dset_file;
+
+/* Fill in a header. Returns 0, or -1 if the arguments are wrong */
+int dset_init_header(dset_header *h, const char *name, const char *attrs,
+		     int type, int ndims, const int *dims, const int *chunk);
+
+/* Convert a header to and from the 512 bytes stored in the file.
+   dset_unpack_header returns -1 if it is not a valid header */
+void dset_pack_header(const dset_header *h, unsigned char *buf);
+int dset_unpack_header(const unsigned char *buf, dset_header *h);
+
+/* Number of chunks along dimension d */
+long long dset_chunks_along(const dset_header *h, int d);
+
+/* Number of elements in a chunk */
+long long dset_chunk_elements(const dset_header *h);
+
+/* Map a file into memory. Returns 0 or -1 */
+int dset_map(const char *filename, dset_file *f);
+void dset_unmap(dset_file *f);
+
+/* Pointer to the chunk with the given chunk coordinates */
+void *dset_chunk(dset_file *f, const long long *coords);
+
+/* Element at the given array index, converted to double */
+double dset_get(dset_file *f, const long long *idx);
+
+#endif
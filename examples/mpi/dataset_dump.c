@@ -0,0 +1,125 @@
+/*
+  Serial tool that shows the contents of a file in the chunked array
+  format of dataset.h, as written by mpi_snapshot.c.
+
+  The file is mapped into memory with dset_map, so only the parts that
+  are looked at are read from the disk. Without indices the header and
+  the minimum, maximum and mean of every chunk are printed. With -c the
+  chunk with the given chunk coordinates is printed, and with indices
+  only the elements at those indices.
+
+  The program does not use MPI.
+
+  Compile the program with 'gcc -O2 dataset_dump.c dataset.c -o dataset_dump'
+  Run the program with './dataset_dump snap_0100.dat'
+  or './dataset_dump snap_0100.dat 256 256'
+  or './dataset_dump -c snap_0100.dat 4 4'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dataset.h"
+
+void print_usage(char *s) {
+  printf("Usage: %s [-c] <file> [index ...]\n", s);
+}
+
+/* Statistics of the elements of one chunk that are inside the array */
+void chunk_statistics(dset_file *f, long long *coords) {
+  long long idx[DSET_MAXDIMS], first[DSET_MAXDIMS], last[DSET_MAXDIMS], n = 0;
+  double x, min = 1e300, max = -1e300, sum = 0.0;
+  int d, nd = (int) f->h.ndims;
+
+  for (d=0; d<nd; d++) {
+    first[d] = idx[d] = coords[d]*f->h.chunk[d];
+    last[d] = first[d] + f->h.chunk[d] < f->h.dims[d] ? first[d] + f->h.chunk[d] : f->h.dims[d];
+  }
+  while (1) {
+    x = dset_get(f, idx);
+    if (x < min) min = x;
+    if (x > max) max = x;
+    sum += x;
+    n++;
+    for (d=nd-1; d>=0; d--) {
+      if (++idx[d] < last[d]) break;
+      idx[d] = first[d];
+    }
+    if (d < 0) break;
+  }
+
+  printf("chunk");
+  for (d=0; d<nd; d++) printf(" %lld", coords[d]);
+  printf(": min %g, max %g, mean %g\n", min, max, sum/n);
+}
+
+int main(int argc, char* argv[]) {
+  char *types[4] = {"char", "int", "float", "double"};
+  long long idx[DSET_MAXDIMS], coords[DSET_MAXDIMS], i, j, n;
+  int d, a = 1, chunks = 0;
+  dset_file f;
+
+  if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+    chunks = 1;
+    a++;
+  }
+  if (a >= argc) {
+    print_usage(argv[0]);
+    exit(0);
+  }
+  if (dset_map(argv[a], &f) != 0) {
+    printf("%s is not a dataset file\n", argv[a]);
+    exit(1);
+  }
+
+  printf("%s: %s, %s", argv[a], f.h.name, types[f.h.type]);
+  for (d=0; d<f.h.ndims; d++) printf("%s%lld", d ? " x " : " ", f.h.dims[d]);
+  printf(" in %lld chunks of", f.h.nchunks);
+  for (d=0; d<f.h.ndims; d++) printf("%s%lld", d ? " x " : " ", f.h.chunk[d]);
+  printf("\n%s\n", f.h.attrs);
+
+  if (argc - a - 1 == f.h.ndims) {
+    for (d=0; d<f.h.ndims; d++) {
+      idx[d] = atoll(argv[a+1+d]);
+      if (idx[d] < 0 || idx[d] >= (chunks ? dset_chunks_along(&f.h, d) : f.h.dims[d])) {
+	printf("Index %lld is outside the array\n", idx[d]);
+	dset_unmap(&f);
+	exit(1);
+      }
+    }
+    if (chunks) {
+      /* The elements of one chunk, the last dimension on one line */
+      n = dset_chunk_elements(&f.h);
+      for (i=0; i<n; i+=f.h.chunk[f.h.ndims-1]) {
+	for (j=0; j<f.h.chunk[f.h.ndims-1]; j++) {
+	  switch (f.h.type) {
+	  case DSET_CHAR: printf("%c", ((char *) dset_chunk(&f, idx))[i+j]); break;
+	  case DSET_INT: printf(" %d", ((int *) dset_chunk(&f, idx))[i+j]); break;
+	  case DSET_FLOAT: printf(" %g", ((float *) dset_chunk(&f, idx))[i+j]); break;
+	  default: printf(" %g", ((double *) dset_chunk(&f, idx))[i+j]);
+	  }
+	}
+	printf("\n");
+      }
+    }
+    else {
+      printf("%g\n", dset_get(&f, idx));
+    }
+  }
+  else if (argc - a - 1 == 0) {
+    for (d=0; d<f.h.ndims; d++) coords[d] = 0;
+    for (i=0; i<f.h.nchunks; i++) {
+      chunk_statistics(&f, coords);
+      for (d=(int)f.h.ndims-1; d>=0; d--) {
+	if (++coords[d] < dset_chunks_along(&f.h, d)) break;
+	coords[d] = 0;
+      }
+    }
+  }
+  else {
+    printf("Give %lld indices\n", f.h.ndims);
+  }
+
+  dset_unmap(&f);
+  exit(0);
+}
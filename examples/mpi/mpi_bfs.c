@@ -0,0 +1,540 @@
+/*
+  MPI example program that runs a breadth-first search (BFS) on a large
+  random graph, in the style of the Graph500 benchmark.
+
+  The graph has 2^SCALE vertices and EDGEFACTOR*2^SCALE undirected edges,
+  generated with the Kronecker (R-MAT) generator used by Graph500, with
+  the vertex numbers scrambled so that the high degree vertices are
+  spread out. Edge e is generated from its own random seed, so the graph
+  does not depend on the number of processes.
+
+  The vertices are distributed cyclically (1D partitioning): vertex v is
+  owned by process v%np, which stores the list of neighbours of v in
+  compressed sparse row (CSR) format. The edges are sent to their owners
+  with MPI_Alltoallv after they have been generated.
+
+  The search is level-synchronous. In each level every process goes
+  through the neighbours of its frontier vertices. Neighbours owned by
+  the process itself are visited directly, while the others are
+  collected (without duplicates) and sent to their owners together with
+  the parent vertex. The messages of a level are sent with one
+  MPI_Alltoallv, using one of two encodings:
+
+  sparse  A list of (vertex, parent) pairs, 16 bytes per vertex.
+  bitmap  A bitmap with one bit for every vertex of the receiver,
+          followed by the parents of the set bits in order. This costs
+          nlocal/8 bytes per receiver plus 8 bytes per vertex.
+
+  The encoding is chosen for each level from the total number of vertices
+  to send, so the large middle levels use bitmaps and the small first and
+  last levels use lists. Duplicates are removed before sending with a
+  hash table of the remote vertices found in the level, with room for
+  twice the local edges, so the memory that a process needs only grows
+  with its own part of the graph.
+
+  Each search is validated like in Graph500: the parent of every vertex
+  must be a neighbour one level closer to the root, and the levels of
+  the two end points of every edge may differ by at most one. The levels
+  of the neighbours and parents are asked from their owners with
+  MPI_Alltoallv. The performance is reported in traversed edges per
+  second (TEPS), as the harmonic mean over all searches.
+
+  Compile the program with 'mpicc -O3 mpi_bfs.c -o mpi_bfs'
+  Run the program with 'mpiexec -n 4 ./mpi_bfs -s 18 -e 16 -r 16'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <mpi.h>
+
+#define OWNER(v)  ((int)((v) % np))           /* Owner of global vertex v */
+#define LOCAL(v)  ((v) / np)                  /* Local index of vertex v */
+#define GLOBAL(l,p) ((int64_t)(l)*np + (p))   /* Global vertex number */
+
+int me, np;                   /* Process id and number of processes */
+int SCALE = 16;               /* log2 of the number of vertices */
+int edgefactor = 16;          /* Number of edges per vertex */
+int64_t nglobal;              /* Number of vertices */
+int64_t nlocal;               /* Number of local vertices */
+int64_t *rowstart, *adj;      /* Local adjacency lists in CSR format */
+int64_t *pred;                /* Parent of each local vertex in the BFS tree */
+int *level;                   /* Level of each local vertex */
+
+/* Statistics of the last search */
+int levels_sparse, levels_bitmap;
+double bytes_sent;
+
+void print_usage(char *s) {
+  printf("Usage: %s -s <scale> -e <edge factor> -r <nr of searches>\n", s);
+}
+
+/* The splitmix64 random number generator */
+uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+double uniform(uint64_t *state) {
+  return (double)(next_random(state) >> 11) * (1.0/9007199254740992.0);
+}
+
+/* Bijective scrambling of the SCALE bit vertex numbers */
+int64_t scramble(int64_t v) {
+  const uint64_t mask = ((uint64_t)1 << SCALE) - 1;
+  uint64_t x = (uint64_t)v;
+  x = (x * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull) & mask;
+  x ^= x >> (SCALE/2 + 1);
+  x = (x * 0xD6E8FEB86659FD93ull) & mask;
+  return (int64_t)x;
+}
+
+/* Generate edge number e with the Kronecker generator. The probabilities
+   of the four quadrants are A=0.57, B=0.19, C=0.19 and D=0.05 */
+void kronecker_edge(int64_t e, int64_t *u, int64_t *v) {
+  uint64_t state = 0x5EED ^ ((uint64_t)e * 0xA24BAED4963EE407ull);
+  int64_t a = 0, b = 0;
+  double r;
+  int i;
+
+  for (i=0; i<SCALE; i++) {
+    r = uniform(&state);
+    a <<= 1;  b <<= 1;
+    if (r >= 0.95) { a |= 1; b |= 1; }
+    else if (r >= 0.76) a |= 1;
+    else if (r >= 0.57) b |= 1;
+  }
+  *u = scramble(a);
+  *v = scramble(b);
+}
+
+/* Number of vertices owned by process p */
+int64_t owned(int p) {
+  return (nglobal - p + np - 1)/np;
+}
+
+/* Generate the local share of the edges and send each edge to the
+   owners of its two end points, which build their adjacency lists */
+void build_graph(void) {
+  const int64_t nedges = (int64_t)edgefactor*nglobal;
+  const int64_t e0 = nedges*me/np, e1 = nedges*(me+1)/np;
+  int *scount, *rcount, *sdispl, *rdispl, *pos, p;
+  int64_t *sbuf, *rbuf, e, u, v, i, nrecv, *fill;
+
+  scount = (int *) calloc(np, sizeof(int));
+  rcount = (int *) malloc(np*sizeof(int));
+  sdispl = (int *) malloc(np*sizeof(int));
+  rdispl = (int *) malloc(np*sizeof(int));
+  pos = (int *) malloc(np*sizeof(int));
+  sbuf = (int64_t *) malloc(4*(e1-e0+1)*sizeof(int64_t));
+
+  /* Count the messages, then fill the send buffer. Self loops are
+     dropped. Each edge is sent in both directions */
+  for (e=e0; e<e1; e++) {
+    kronecker_edge(e, &u, &v);
+    if (u == v) continue;
+    scount[OWNER(u)] += 2;
+    scount[OWNER(v)] += 2;
+  }
+  sdispl[0] = 0;
+  for (p=1; p<np; p++) sdispl[p] = sdispl[p-1] + scount[p-1];
+  memcpy(pos, sdispl, np*sizeof(int));
+  for (e=e0; e<e1; e++) {
+    kronecker_edge(e, &u, &v);
+    if (u == v) continue;
+    sbuf[pos[OWNER(u)]++] = u;  sbuf[pos[OWNER(u)]++] = v;
+    sbuf[pos[OWNER(v)]++] = v;  sbuf[pos[OWNER(v)]++] = u;
+  }
+
+  MPI_Alltoall(scount, 1, MPI_INT, rcount, 1, MPI_INT, MPI_COMM_WORLD);
+  rdispl[0] = 0;
+  for (p=1; p<np; p++) rdispl[p] = rdispl[p-1] + rcount[p-1];
+  nrecv = rdispl[np-1] + rcount[np-1];
+  rbuf = (int64_t *) malloc((nrecv+1)*sizeof(int64_t));
+  MPI_Alltoallv(sbuf, scount, sdispl, MPI_LONG_LONG, rbuf, rcount, rdispl,
+		MPI_LONG_LONG, MPI_COMM_WORLD);
+
+  /* Build the CSR structure from the received (u,v) pairs */
+  rowstart = (int64_t *) calloc(nlocal+1, sizeof(int64_t));
+  for (i=0; i<nrecv; i+=2) rowstart[LOCAL(rbuf[i])+1]++;
+  for (i=0; i<nlocal; i++) rowstart[i+1] += rowstart[i];
+  adj = (int64_t *) malloc((rowstart[nlocal]+1)*sizeof(int64_t));
+  fill = (int64_t *) malloc((nlocal+1)*sizeof(int64_t));
+  memcpy(fill, rowstart, (nlocal+1)*sizeof(int64_t));
+  for (i=0; i<nrecv; i+=2) adj[fill[LOCAL(rbuf[i])]++] = rbuf[i+1];
+
+  free(scount); free(rcount); free(sdispl); free(rdispl); free(pos);
+  free(sbuf); free(rbuf); free(fill);
+}
+
+/* Hash table of the remote vertices found in a level, with the first
+   parent found for each. Empty slots have the key -1 */
+int64_t *hkey, *hval, hmask;
+
+/* The slot of vertex v, or the empty slot where it goes */
+int64_t hash_slot(int64_t v) {
+  int64_t h = (int64_t)(((uint64_t)v * 0x9E3779B97F4A7C15ull) >> 20) & hmask;
+
+  while (hkey[h] != -1 && hkey[h] != v) h = (h+1) & hmask;
+  return h;
+}
+
+/* Breadth-first search from vertex root */
+void bfs(int64_t root) {
+  static int64_t *frontier, *next, *touched, *sbuf, *rbuf;
+  static int *scount, *rcount, *sdispl, *rdispl, *pos, *nsend;
+  static int64_t rbuf_size;
+  int64_t nf, nn, nt, i, j, k, l, v, u, h, nrecv, words, total, *tmp;
+  int p, lvl, use_bitmap;
+
+  if (frontier == NULL) {
+    /* Work arrays, allocated for the first search. A level finds at most
+       one remote vertex per local edge, so the hash table is at most
+       half full */
+    frontier = (int64_t *) malloc((nlocal+1)*sizeof(int64_t));
+    next = (int64_t *) malloc((nlocal+1)*sizeof(int64_t));
+    for (hmask=1; hmask < 2*(rowstart[nlocal]+1); hmask*=2) ;
+    hkey = (int64_t *) malloc(hmask*sizeof(int64_t));
+    hval = (int64_t *) malloc(hmask*sizeof(int64_t));
+    for (h=0; h<hmask; h++) hkey[h] = -1;
+    hmask--;
+    touched = (int64_t *) malloc((rowstart[nlocal]+1)*sizeof(int64_t));
+    sbuf = (int64_t *) malloc((2*rowstart[nlocal] + nglobal/64 + np + 1)*sizeof(int64_t));
+    scount = (int *) malloc(np*sizeof(int));
+    rcount = (int *) malloc(np*sizeof(int));
+    sdispl = (int *) malloc(np*sizeof(int));
+    rdispl = (int *) malloc(np*sizeof(int));
+    pos = (int *) malloc(np*sizeof(int));
+    nsend = (int *) malloc(np*sizeof(int));
+  }
+
+  for (l=0; l<nlocal; l++) {
+    pred[l] = -1;
+    level[l] = -1;
+  }
+  nf = 0;
+  if (OWNER(root) == me) {
+    pred[LOCAL(root)] = root;
+    level[LOCAL(root)] = 0;
+    frontier[nf++] = LOCAL(root);
+  }
+  levels_sparse = levels_bitmap = 0;
+  bytes_sent = 0.0;
+
+  for (lvl=0; ; lvl++) {
+    MPI_Allreduce(&nf, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (total == 0) break;
+
+    /* Visit the neighbours of the frontier. Remote vertices are stored
+       once in the hash table, with the first parent found, and touched
+       has their slots */
+    nn = nt = 0;
+    memset(nsend, 0, np*sizeof(int));
+    for (i=0; i<nf; i++) {
+      u = GLOBAL(frontier[i], me);
+      for (j=rowstart[frontier[i]]; j<rowstart[frontier[i]+1]; j++) {
+	v = adj[j];
+	p = OWNER(v);
+	if (p == me) {
+	  l = LOCAL(v);
+	  if (pred[l] == -1) {
+	    pred[l] = u;
+	    level[l] = lvl+1;
+	    next[nn++] = l;
+	  }
+	} else if (hkey[h = hash_slot(v)] == -1) {
+	  hkey[h] = v;
+	  hval[h] = u;
+	  touched[nt++] = h;
+	  nsend[p]++;
+	}
+      }
+    }
+
+    /* Use bitmaps if they are smaller than the lists in total */
+    MPI_Allreduce(&nt, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    use_bitmap = (total > (int64_t)np*(nglobal/64));
+    if (use_bitmap) levels_bitmap++; else levels_sparse++;
+
+    for (p=0; p<np; p++) {
+      if (p == me) scount[p] = 0;
+      else if (use_bitmap) scount[p] = (int)((owned(p)+63)/64) + nsend[p];
+      else scount[p] = 2*nsend[p];
+    }
+    sdispl[0] = 0;
+    for (p=1; p<np; p++) sdispl[p] = sdispl[p-1] + scount[p-1];
+
+    if (use_bitmap) {
+      /* Set the bits, then append the parents in the order of the bits */
+      for (p=0; p<np; p++) {
+	if (p == me) continue;
+	memset(&sbuf[sdispl[p]], 0, ((owned(p)+63)/64)*sizeof(int64_t));
+      }
+      for (k=0; k<nt; k++) {
+	v = hkey[touched[k]];
+	l = LOCAL(v);
+	sbuf[sdispl[OWNER(v)] + l/64] |= (int64_t)((uint64_t)1 << (l%64));
+      }
+      for (p=0; p<np; p++) {
+	if (p == me) continue;
+	words = (owned(p)+63)/64;
+	k = sdispl[p] + words;
+	for (j=0; j<words; j++) {
+	  uint64_t bits = (uint64_t)sbuf[sdispl[p]+j];
+	  while (bits) {
+	    l = j*64 + __builtin_ctzll(bits);
+	    sbuf[k++] = hval[hash_slot(GLOBAL(l, p))];
+	    bits &= bits-1;
+	  }
+	}
+      }
+    } else {
+      memcpy(pos, sdispl, np*sizeof(int));
+      for (k=0; k<nt; k++) {
+	v = hkey[touched[k]];
+	p = OWNER(v);
+	sbuf[pos[p]++] = LOCAL(v);
+	sbuf[pos[p]++] = hval[touched[k]];
+      }
+    }
+    for (k=0; k<nt; k++) hkey[touched[k]] = -1;
+
+    /* Exchange the discovered vertices */
+    MPI_Alltoall(scount, 1, MPI_INT, rcount, 1, MPI_INT, MPI_COMM_WORLD);
+    rdispl[0] = 0;
+    for (p=1; p<np; p++) rdispl[p] = rdispl[p-1] + rcount[p-1];
+    nrecv = rdispl[np-1] + rcount[np-1];
+    if (nrecv > rbuf_size) {
+      free(rbuf);
+      rbuf_size = 2*nrecv;
+      rbuf = (int64_t *) malloc(rbuf_size*sizeof(int64_t));
+    }
+    MPI_Alltoallv(sbuf, scount, sdispl, MPI_LONG_LONG, rbuf, rcount, rdispl,
+		  MPI_LONG_LONG, MPI_COMM_WORLD);
+    for (p=0; p<np; p++) bytes_sent += scount[p]*sizeof(int64_t);
+
+    /* Visit the received vertices */
+    for (p=0; p<np; p++) {
+      if (rcount[p] == 0) continue;
+      if (use_bitmap) {
+	words = (nlocal+63)/64;
+	k = rdispl[p] + words;
+	for (j=0; j<words; j++) {
+	  uint64_t bits = (uint64_t)rbuf[rdispl[p]+j];
+	  while (bits) {
+	    l = j*64 + __builtin_ctzll(bits);
+	    u = rbuf[k++];
+	    if (pred[l] == -1) {
+	      pred[l] = u;
+	      level[l] = lvl+1;
+	      next[nn++] = l;
+	    }
+	    bits &= bits-1;
+	  }
+	}
+      } else {
+	for (k=rdispl[p]; k<rdispl[p]+rcount[p]; k+=2) {
+	  l = rbuf[k];
+	  if (pred[l] == -1) {
+	    pred[l] = rbuf[k+1];
+	    level[l] = lvl+1;
+	    next[nn++] = l;
+	  }
+	}
+      }
+    }
+
+    /* The next frontier becomes the current one */
+    nf = nn;
+    tmp = frontier;  frontier = next;  next = tmp;
+  }
+}
+
+/* Validate the BFS tree, returns the global number of errors. Query q
+   is the level of adj[q] for q < nadj, and of the parent of local
+   vertex q-nadj after that. The queries are sent to the owners of the
+   vertices, and slot[q] is where the answer to q comes back */
+int64_t validate(int64_t root) {
+  int *scount, *rcount, *sdispl, *rdispl, *pos, *ask, *ans, p, lv;
+  int64_t nadj = rowstart[nlocal], nq = nadj + nlocal, q, l, j, v, nrecv, errors = 0, found;
+  int64_t *slot, *sreq, *rreq;
+
+  scount = (int *) calloc(np, sizeof(int));
+  rcount = (int *) malloc(np*sizeof(int));
+  sdispl = (int *) malloc(np*sizeof(int));
+  rdispl = (int *) malloc(np*sizeof(int));
+  pos = (int *) malloc(np*sizeof(int));
+  slot = (int64_t *) malloc((nq+1)*sizeof(int64_t));
+  sreq = (int64_t *) malloc((nq+1)*sizeof(int64_t));
+  ans = (int *) malloc((nq+1)*sizeof(int));
+
+  for (q=0; q<nq; q++) {
+    v = q < nadj ? adj[q] : pred[q-nadj];
+    if (v >= 0) scount[OWNER(v)]++;
+  }
+  sdispl[0] = 0;
+  for (p=1; p<np; p++) sdispl[p] = sdispl[p-1] + scount[p-1];
+  memcpy(pos, sdispl, np*sizeof(int));
+  for (q=0; q<nq; q++) {
+    v = q < nadj ? adj[q] : pred[q-nadj];
+    if (v >= 0) {
+      slot[q] = pos[OWNER(v)];
+      sreq[pos[OWNER(v)]++] = LOCAL(v);
+    } else {
+      slot[q] = -1;
+    }
+  }
+
+  /* Send the local indices to the owners, which answer with the levels */
+  MPI_Alltoall(scount, 1, MPI_INT, rcount, 1, MPI_INT, MPI_COMM_WORLD);
+  rdispl[0] = 0;
+  for (p=1; p<np; p++) rdispl[p] = rdispl[p-1] + rcount[p-1];
+  nrecv = rdispl[np-1] + rcount[np-1];
+  rreq = (int64_t *) malloc((nrecv+1)*sizeof(int64_t));
+  ask = (int *) malloc((nrecv+1)*sizeof(int));
+  MPI_Alltoallv(sreq, scount, sdispl, MPI_LONG_LONG, rreq, rcount, rdispl,
+		MPI_LONG_LONG, MPI_COMM_WORLD);
+  for (j=0; j<nrecv; j++) ask[j] = level[rreq[j]];
+  MPI_Alltoallv(ask, rcount, rdispl, MPI_INT, ans, scount, sdispl,
+		MPI_INT, MPI_COMM_WORLD);
+#define LEVEL(q) ans[slot[q]]
+
+  for (l=0; l<nlocal; l++) {
+    v = GLOBAL(l, me);
+    lv = level[l];
+    if (v == root) {
+      if (pred[l] != root || lv != 0) errors++;
+    } else if (lv >= 0) {
+      /* The parent must be a neighbour on the previous level */
+      found = 0;
+      for (j=rowstart[l]; j<rowstart[l+1]; j++)
+	if (adj[j] == pred[l]) found = 1;
+      if (!found || pred[l] < 0 || LEVEL(nadj+l) != lv-1) errors++;
+    } else if (pred[l] != -1) {
+      errors++;
+    }
+    /* Both end points of an edge are reached, and their levels differ
+       by at most one */
+    for (j=rowstart[l]; j<rowstart[l+1]; j++) {
+      if ((lv >= 0) != (LEVEL(j) >= 0)) errors++;
+      else if (lv >= 0 && abs(lv - LEVEL(j)) > 1) errors++;
+    }
+  }
+#undef LEVEL
+  MPI_Allreduce(MPI_IN_PLACE, &errors, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  free(scount); free(rcount); free(sdispl); free(rdispl); free(pos);
+  free(slot); free(sreq); free(rreq); free(ask); free(ans);
+  return errors;
+}
+
+int main(int argc, char *argv[]) {
+  int nroots = 16, r, c, ok = 1;
+  int64_t root, deg, l, edges, nvisited, errors;
+  uint64_t seed = 2;
+  double t0, t, sum_inv_teps = 0.0, min_teps = 1e30, max_teps = 0.0, sum_time = 0.0;
+  double teps, data[2], bytes;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+  while ((c=getopt(argc, argv, "hs:e:r:")) != EOF) {
+    switch (c) {
+    case 's':
+      SCALE = atoi(optarg);
+      break;
+    case 'e':
+      edgefactor = atoi(optarg);
+      break;
+    case 'r':
+      nroots = atoi(optarg);
+      break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+  if (SCALE < 2 || SCALE > 40) {
+    if (me == 0) printf("The scale must be between 2 and 40\n");
+    MPI_Finalize();
+    exit(1);
+  }
+
+  nglobal = (int64_t)1 << SCALE;
+  nlocal = owned(me);
+
+  if (me == 0)
+    printf("Graph with 2^%d vertices and %lld edges on %d processes\n",
+	   SCALE, (long long)edgefactor*nglobal, np);
+
+  t0 = MPI_Wtime();
+  build_graph();
+  t = MPI_Wtime()-t0;
+  if (me == 0) printf("Graph generation and distribution: %f s\n\n", t);
+
+  pred = (int64_t *) malloc((nlocal+1)*sizeof(int64_t));
+  level = (int *) malloc((nlocal+1)*sizeof(int));
+
+  for (r=0; r<nroots; r++) {
+    /* Pick a random root that has at least one edge */
+    do {
+      root = (int64_t)(next_random(&seed) % (uint64_t)nglobal);
+      deg = (OWNER(root) == me) ? rowstart[LOCAL(root)+1]-rowstart[LOCAL(root)] : 0;
+      MPI_Allreduce(MPI_IN_PLACE, &deg, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    } while (deg == 0);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    t0 = MPI_Wtime();
+    bfs(root);
+    t = MPI_Wtime()-t0;
+    MPI_Allreduce(MPI_IN_PLACE, &t, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    /* Count the edges in the searched component. Every edge is stored
+       twice, once with each end point */
+    data[0] = data[1] = 0.0;
+    for (l=0; l<nlocal; l++) {
+      if (level[l] >= 0) {
+	data[0] += 1.0;
+	data[1] += (double)(rowstart[l+1]-rowstart[l]);
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, data, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    nvisited = (int64_t)data[0];
+    edges = (int64_t)(data[1]/2);
+    bytes = bytes_sent;
+    MPI_Allreduce(MPI_IN_PLACE, &bytes, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    errors = validate(root);
+    if (errors) ok = 0;
+
+    teps = edges/t;
+    sum_inv_teps += 1.0/teps;
+    sum_time += t;
+    if (teps < min_teps) min_teps = teps;
+    if (teps > max_teps) max_teps = teps;
+
+    if (me == 0) {
+      printf("BFS %2d from %10lld: %9lld vertices, %10lld edges, %f s, %8.3e TEPS, "
+	     "levels sparse/bitmap %d/%d, %.1f MB sent, %s\n",
+	     r, (long long)root, (long long)nvisited, (long long)edges, t, teps,
+	     levels_sparse, levels_bitmap, bytes*1e-6,
+	     errors ? "INVALID" : "valid");
+    }
+  }
+
+  if (me == 0 && nroots > 0) {
+    printf("\nMean time:          %f s\n", sum_time/nroots);
+    printf("Harmonic mean TEPS: %8.3e\n", nroots/sum_inv_teps);
+    printf("Min/max TEPS:       %8.3e / %8.3e\n", min_teps, max_teps);
+    printf("Validation %s\n", ok ? "passed" : "FAILED");
+  }
+
+  free(rowstart); free(adj); free(pred); free(level); free(hkey); free(hval);
+  MPI_Finalize();
+  exit(0);
+}
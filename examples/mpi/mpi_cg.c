@@ -0,0 +1,335 @@
+/*
+  MPI example program that solves the Poisson equation -Laplace(u) = 1 on
+  a square or a cube with zero boundary values, using the conjugate
+  gradient (CG) method.
+
+  The n*n (2D) or n*n*n (3D) grid is decomposed in slabs along the last
+  dimension, like the string in mpi_wave.c: each process has a number of
+  consecutive planes and one ghost plane on each side, which is exchanged
+  with the left and right neighbours before every matrix-vector product.
+  The interior planes are computed while the ghost planes are in transit.
+
+  Two versions of CG are compared:
+
+  classic    The textbook algorithm. Every iteration has two dot products,
+             and each is a blocking MPI_Allreduce that has to finish
+             before the iteration can continue.
+
+  pipelined  The pipelined CG of Ghysels and Vanroose (Parallel Computing
+             40, 2014). The recurrences are rearranged so that the two
+             dot products of an iteration are combined into one reduction,
+             and it is started with MPI_Iallreduce before the
+             matrix-vector product and completed after it. On many
+             processes the latency of the reduction is then hidden behind
+             the computation, at the cost of a few more vector updates.
+
+  MPI_Iallreduce is part of MPI-3. With older MPI libraries the pipelined
+  version falls back to a blocking MPI_Allreduce after the matrix-vector
+  product, which still saves one reduction per iteration.
+
+  After each solve the true residual ||b-Ax|| is computed again to check
+  the result, since the recurrences of pipelined CG can drift.
+
+  Compile the program with 'mpicc -O3 mpi_cg.c -o mpi_cg -lm'
+  Run the program with 'mpiexec -n 4 ./mpi_cg -d 3 -n 100'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+
+#define PROGRESS_PLANES 8   /* Poll the pending reduction this often */
+
+int id, nproc;              /* Process id and number of processes */
+int left, right;            /* Left and right neighbour */
+int dim;                    /* 2 or 3 dimensions */
+int nx, ny;                 /* Size of one plane (ny=1 in 2D) */
+int nz;                     /* Number of local planes */
+int plane;                  /* Number of points in a plane */
+size_t nloc;                /* Number of local points */
+double t_reduce;            /* Time spent waiting for reductions */
+
+void print_usage(char *s) {
+  printf("Usage: %s -d <2|3> -n <grid size> -t <tolerance> -m <max iterations>\n", s);
+}
+
+/* Allocate a vector with ghost planes, set to zero */
+double *new_vector(void) {
+  return (double *) calloc(nloc + 2*plane, sizeof(double));
+}
+
+/* Compute the stencil for local plane k (1..nz) of u into v */
+void stencil_plane(const double *u, double *v, int k) {
+  const double diag = 2.0*dim;
+  const double *c = u + (size_t)k*plane;
+  double *o = v + (size_t)k*plane;
+  double s;
+  int i, j, idx;
+
+  for (j=0; j<ny; j++) {
+    for (i=0; i<nx; i++) {
+      idx = j*nx+i;
+      s = diag*c[idx] - c[idx-plane] - c[idx+plane];
+      if (i > 0)    s -= c[idx-1];
+      if (i < nx-1) s -= c[idx+1];
+      if (dim == 3) {
+	if (j > 0)    s -= c[idx-nx];
+	if (j < ny-1) s -= c[idx+nx];
+      }
+      o[idx] = s;
+    }
+  }
+}
+
+/* Matrix-vector product v = A*u. The ghost planes of u are exchanged
+   while the interior planes are computed. If req is not NULL, it is a
+   pending reduction which is polled now and then so that the MPI library
+   can make progress on it */
+void matvec(double *u, double *v, MPI_Request *req) {
+  const int tag = 42;
+  MPI_Request halo[4];
+  int k, flag;
+
+  MPI_Irecv(u, plane, MPI_DOUBLE, left, tag, MPI_COMM_WORLD, &halo[0]);
+  MPI_Irecv(u+(size_t)(nz+1)*plane, plane, MPI_DOUBLE, right, tag, MPI_COMM_WORLD, &halo[1]);
+  MPI_Isend(u+plane, plane, MPI_DOUBLE, left, tag, MPI_COMM_WORLD, &halo[2]);
+  MPI_Isend(u+(size_t)nz*plane, plane, MPI_DOUBLE, right, tag, MPI_COMM_WORLD, &halo[3]);
+
+  for (k=2; k<nz; k++) {
+    stencil_plane(u, v, k);
+    if (req != NULL && k%PROGRESS_PLANES == 0) MPI_Test(req, &flag, MPI_STATUS_IGNORE);
+  }
+  MPI_Waitall(4, halo, MPI_STATUSES_IGNORE);
+  stencil_plane(u, v, 1);
+  if (nz > 1) stencil_plane(u, v, nz);
+}
+
+/* Local part of the dot product of the interior points */
+double local_dot(const double *a, const double *b) {
+  double s = 0.0;
+  size_t i;
+  for (i=plane; i<nloc+plane; i++) s += a[i]*b[i];
+  return s;
+}
+
+/* Blocking global sum, timed */
+void global_sum(double *x, int n) {
+  double t = MPI_Wtime();
+  MPI_Allreduce(MPI_IN_PLACE, x, n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  t_reduce += MPI_Wtime()-t;
+}
+
+/* Classic CG, returns the number of iterations */
+int cg_classic(const double *b, double *x, double tol, int maxit) {
+  double *r = new_vector(), *p = new_vector(), *q = new_vector();
+  double gamma, gamma_old, alpha, beta, pq, bnorm;
+  size_t i;
+  int it;
+
+  /* x = 0, r = b, p = r */
+  memset(x, 0, (nloc+2*plane)*sizeof(double));
+  memcpy(r, b, (nloc+2*plane)*sizeof(double));
+  memcpy(p, b, (nloc+2*plane)*sizeof(double));
+  gamma = local_dot(r, r);
+  global_sum(&gamma, 1);
+  bnorm = sqrt(gamma);
+
+  for (it=0; it<maxit && sqrt(gamma) > tol*bnorm; it++) {
+    matvec(p, q, NULL);
+    pq = local_dot(p, q);
+    global_sum(&pq, 1);
+    alpha = gamma/pq;
+    for (i=plane; i<nloc+plane; i++) {
+      x[i] += alpha*p[i];
+      r[i] -= alpha*q[i];
+    }
+    gamma_old = gamma;
+    gamma = local_dot(r, r);
+    global_sum(&gamma, 1);
+    beta = gamma/gamma_old;
+    for (i=plane; i<nloc+plane; i++) p[i] = r[i] + beta*p[i];
+  }
+  free(r); free(p); free(q);
+  return it;
+}
+
+/* Pipelined CG (Ghysels and Vanroose), returns the number of iterations */
+int cg_pipelined(const double *b, double *x, double tol, int maxit) {
+  double *r = new_vector(), *w = new_vector(), *q = new_vector();
+  double *z = new_vector(), *s = new_vector(), *p = new_vector();
+  double dots[2], gamma, gamma_old=0.0, delta, alpha=0.0, beta, bnorm=0.0;
+  size_t i;
+  int it;
+
+  /* x = 0, r = b, w = A*r */
+  memset(x, 0, (nloc+2*plane)*sizeof(double));
+  memcpy(r, b, (nloc+2*plane)*sizeof(double));
+  matvec(r, w, NULL);
+
+  for (it=0; it<maxit; it++) {
+    /* Start the reduction of gamma = (r,r) and delta = (w,r) */
+    dots[0] = local_dot(r, r);
+    dots[1] = local_dot(w, r);
+#if MPI_VERSION >= 3
+    {
+      MPI_Request req;
+      double t;
+      MPI_Iallreduce(MPI_IN_PLACE, dots, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, &req);
+      /* q = A*w while the reduction is in progress */
+      matvec(w, q, &req);
+      t = MPI_Wtime();
+      MPI_Wait(&req, MPI_STATUS_IGNORE);
+      t_reduce += MPI_Wtime()-t;
+    }
+#else
+    matvec(w, q, NULL);
+    global_sum(dots, 2);
+#endif
+    gamma = dots[0];
+    delta = dots[1];
+    if (it == 0) bnorm = sqrt(gamma);
+    if (sqrt(gamma) <= tol*bnorm) break;
+
+    if (it > 0) {
+      beta = gamma/gamma_old;
+      alpha = gamma/(delta - beta*gamma/alpha);
+    } else {
+      beta = 0.0;
+      alpha = gamma/delta;
+    }
+    for (i=plane; i<nloc+plane; i++) {
+      z[i] = q[i] + beta*z[i];
+      s[i] = w[i] + beta*s[i];
+      p[i] = r[i] + beta*p[i];
+      x[i] += alpha*p[i];
+      r[i] -= alpha*s[i];
+      w[i] -= alpha*z[i];
+    }
+    gamma_old = gamma;
+  }
+  free(r); free(w); free(q); free(z); free(s); free(p);
+  return it;
+}
+
+/* Relative true residual ||b-Ax|| / ||b|| */
+double true_residual(const double *b, double *x) {
+  double *ax = new_vector(), sums[2] = {0.0, 0.0};
+  size_t i;
+  matvec(x, ax, NULL);
+  for (i=plane; i<nloc+plane; i++) {
+    sums[0] += (b[i]-ax[i])*(b[i]-ax[i]);
+    sums[1] += b[i]*b[i];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, sums, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  free(ax);
+  return sqrt(sums[0]/sums[1]);
+}
+
+int main(int argc, char *argv[]) {
+  int n=0, maxit=10000, it, c;
+  double tol=1e-8, *b, *x1, *x2, t0, t1, t2, tr1, tr2, diff, res1, res2;
+  size_t i;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &id);
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  dim = 3;
+  while ((c=getopt(argc, argv, "hd:n:t:m:")) != EOF) {
+    switch (c) {
+    case 'd':
+      dim = atoi(optarg);
+      break;
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 't':
+      tol = atof(optarg);
+      break;
+    case 'm':
+      maxit = atoi(optarg);
+      break;
+    default:
+      if (id == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+  if (n == 0) n = (dim == 2) ? 512 : 64;
+
+  if ((dim != 2 && dim != 3) || n < nproc) {
+    if (id == 0) printf("Use 2 or 3 dimensions and at least %d grid points\n", nproc);
+    MPI_Finalize();
+    exit(1);
+  }
+
+  /* Determine the left and right neighbors */
+  left  = (id == 0) ? MPI_PROC_NULL : id-1;
+  right = (id == nproc-1) ? MPI_PROC_NULL : id+1;
+
+  /* Distribute the planes as evenly as possible */
+  nx = n;
+  ny = (dim == 3) ? n : 1;
+  nz = n/nproc + ((id < n%nproc) ? 1 : 0);
+  plane = nx*ny;
+  nloc = (size_t)nz*plane;
+
+  b = new_vector();
+  x1 = new_vector();
+  x2 = new_vector();
+  for (i=plane; i<nloc+plane; i++) b[i] = 1.0;
+
+  if (id == 0) {
+    printf("CG for the %dD Poisson equation on a grid of %d^%d points, %d processes\n",
+	   dim, n, dim, nproc);
+#if MPI_VERSION >= 3
+    printf("Pipelined CG uses MPI_Iallreduce\n");
+#else
+    printf("MPI-3 is not available, pipelined CG uses a blocking MPI_Allreduce\n");
+#endif
+  }
+
+  /* Classic CG */
+  t_reduce = 0.0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  t0 = MPI_Wtime();
+  it = cg_classic(b, x1, tol, maxit);
+  t1 = MPI_Wtime();
+  tr1 = t_reduce;
+  res1 = true_residual(b, x1);
+  if (id == 0) {
+    printf("\nClassic CG:   %5d iterations, true residual %e\n", it, res1);
+    printf("  time %f s, %f ms/iteration, waiting for reductions %f s (%4.1f%%)\n",
+	   t1-t0, 1000.0*(t1-t0)/it, tr1, 100.0*tr1/(t1-t0));
+  }
+
+  /* Pipelined CG */
+  t_reduce = 0.0;
+  MPI_Barrier(MPI_COMM_WORLD);
+  t1 = MPI_Wtime();
+  it = cg_pipelined(b, x2, tol, maxit);
+  t2 = MPI_Wtime();
+  tr2 = t_reduce;
+  res2 = true_residual(b, x2);
+  if (id == 0) {
+    printf("Pipelined CG: %5d iterations, true residual %e\n", it, res2);
+    printf("  time %f s, %f ms/iteration, waiting for reductions %f s (%4.1f%%)\n",
+	   t2-t1, 1000.0*(t2-t1)/it, tr2, 100.0*tr2/(t2-t1));
+  }
+
+  /* The two solutions should agree */
+  diff = 0.0;
+  for (i=plane; i<nloc+plane; i++) diff = fmax(diff, fabs(x1[i]-x2[i]));
+  MPI_Allreduce(MPI_IN_PLACE, &diff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  if (id == 0) {
+    printf("\nMax difference between the solutions: %e\n", diff);
+    printf("Speedup of pipelined CG: %4.2f\n", (t1-t0)/(t2-t1));
+  }
+
+  free(b); free(x1); free(x2);
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi_compress.h"
+
+#define HEADER 8              /* Size of the header with codec and data size */
+#define HASH_BITS 12          /* Size of the LZ hash table */
+#define MINMATCH 4
+#define WINDOW 65536
+#define SAMPLES 3             /* Samples used to choose the codec */
+#define SAMPLE 4096           /* Maximum size of one sample */
+#define NCODECS 3
+
+static int threshold = 32768;
+static double bandwidth = 1e9;        /* Estimated network bandwidth */
+static int fixed_bandwidth = 0;
+static double comp_speed[NCODECS] = {0.0, 0.0, 0.0};    /* Bytes/s, 0 = unknown */
+static double decomp_speed[NCODECS] = {0.0, 0.0, 0.0};
+static compress_stats stats;
+
+/* Work buffers that grow as needed */
+static unsigned char *work = NULL, *shuf = NULL;
+static int work_size = 0, shuf_size = 0;
+
+static unsigned char *grow(unsigned char **buf, int *size, int n) {
+  if (n > *size) {
+    free(*buf);
+    *buf = (unsigned char *) malloc(n);
+    *size = n;
+  }
+  return *buf;
+}
+
+static unsigned int hash4(const unsigned char *p) {
+  unsigned int v;
+  memcpy(&v, p, 4);
+  return (v*2654435761u) >> (32-HASH_BITS);
+}
+
+/* Number of equal bytes at a and b, at most max. Compares 8 bytes at
+   a time */
+static int match_length(const unsigned char *a, const unsigned char *b, int max) {
+  unsigned long long x, y;
+  int len = 0;
+
+  while (len + 8 <= max) {
+    memcpy(&x, &a[len], 8);
+    memcpy(&y, &b[len], 8);
+    if (x != y) break;
+    len += 8;
+  }
+  while (len < max && a[len] == b[len]) len++;
+  return len;
+}
+
+/* Write a length that did not fit in the 4 bits of the token */
+static int put_length(unsigned char *out, int op, int len) {
+  while (len >= 255) {
+    out[op++] = 255;
+    len -= 255;
+  }
+  out[op++] = (unsigned char) len;
+  return op;
+}
+
+int lz_compress(const unsigned char *in, int n, unsigned char *out, int max) {
+  int table[1<<HASH_BITS];
+  int ip = 0, anchor = 0, op = 0, ref, len, lit, misses = 0, i;
+  unsigned int h;
+
+  for (i=0; i<(1<<HASH_BITS); i++) table[i] = -1;
+
+  /* Each sequence is a token with the number of literals in the high
+     and the match length in the low 4 bits, the literals, a 2 byte
+     offset and the rest of the match length. The last sequence has
+     only literals */
+  while (ip + MINMATCH + 5 < n) {
+    h = hash4(&in[ip]);
+    ref = table[h];
+    table[h] = ip;
+    if (ref < 0 || ip - ref >= WINDOW || memcmp(&in[ref], &in[ip], MINMATCH) != 0) {
+      /* Move faster through data that does not compress */
+      ip += 1 + (misses++ >> 6);
+      continue;
+    }
+    misses = 0;
+    len = MINMATCH;
+    len += match_length(&in[ref+len], &in[ip+len], n - ip - len);
+
+    lit = ip - anchor;
+    if (op + 1 + lit/255 + 1 + lit + 2 + len/255 + 1 > max) return -1;
+    out[op++] = (unsigned char) (((lit < 15 ? lit : 15) << 4) |
+				 (len-MINMATCH < 15 ? len-MINMATCH : 15));
+    if (lit >= 15) op = put_length(out, op, lit-15);
+    memcpy(&out[op], &in[anchor], lit);
+    op += lit;
+    out[op++] = (unsigned char) ((ip-ref) & 0xff);
+    out[op++] = (unsigned char) ((ip-ref) >> 8);
+    if (len-MINMATCH >= 15) op = put_length(out, op, len-MINMATCH-15);
+
+    ip += len;
+    anchor = ip;
+  }
+
+  lit = n - anchor;
+  if (op + 1 + lit/255 + 1 + lit > max) return -1;
+  out[op++] = (unsigned char) ((lit < 15 ? lit : 15) << 4);
+  if (lit >= 15) op = put_length(out, op, lit-15);
+  memcpy(&out[op], &in[anchor], lit);
+  return op + lit;
+}
+
+int lz_decompress(const unsigned char *in, int n, unsigned char *out, int max) {
+  int ip = 0, op = 0, lit, len, offset, token, b;
+
+  while (ip < n) {
+    token = in[ip++];
+    lit = token >> 4;
+    if (lit == 15) {
+      do {
+	if (ip >= n) return -1;
+	b = in[ip++];
+	lit += b;
+      } while (b == 255);
+    }
+    if (ip + lit > n || op + lit > max) return -1;
+    memcpy(&out[op], &in[ip], lit);
+    ip += lit;
+    op += lit;
+    if (ip == n) break;           /* The last sequence */
+
+    if (ip + 2 > n) return -1;
+    offset = in[ip] | (in[ip+1] << 8);
+    ip += 2;
+    len = token & 15;
+    if (len == 15) {
+      do {
+	if (ip >= n) return -1;
+	b = in[ip++];
+	len += b;
+      } while (b == 255);
+    }
+    len += MINMATCH;
+    if (offset == 0 || offset > op || op + len > max) return -1;
+    /* The match may overlap the bytes it produces. The copied part is
+       a repetition of the first offset bytes, so it can be used as the
+       source of the next, twice as large, copy */
+    b = op - offset;
+    while (len > 0) {
+      offset = op - b < len ? op - b : len;
+      memcpy(&out[op], &out[b], offset);
+      op += offset;
+      len -= offset;
+    }
+  }
+  return op;
+}
+
+int shuffle_compress(const unsigned char *in, int n, int wordsize,
+		     unsigned char *out, int max, unsigned char *tmp) {
+  int nw = n/wordsize, i, b;
+  unsigned int prev4 = 0, w4;
+  unsigned long long prev8 = 0, w8;
+
+  /* XOR with the previous word and put byte b of word i at b*nw+i */
+  if (wordsize == 4) {
+    for (i=0; i<nw; i++) {
+      memcpy(&w4, &in[4*i], 4);
+      prev4 ^= w4;
+      for (b=0; b<4; b++) tmp[b*nw+i] = (unsigned char) (prev4 >> (8*b));
+      prev4 = w4;
+    }
+  }
+  else {
+    for (i=0; i<nw; i++) {
+      memcpy(&w8, &in[8*i], 8);
+      prev8 ^= w8;
+      for (b=0; b<8; b++) tmp[b*nw+i] = (unsigned char) (prev8 >> (8*b));
+      prev8 = w8;
+    }
+  }
+  memcpy(&tmp[nw*wordsize], &in[nw*wordsize], n - nw*wordsize);
+  return lz_compress(tmp, n, out, max);
+}
+
+int shuffle_decompress(const unsigned char *in, int n, int wordsize,
+		       unsigned char *out, int max, unsigned char *tmp) {
+  int m = lz_decompress(in, n, tmp, max), nw, i, b;
+  unsigned int w4 = 0;
+  unsigned long long w8 = 0;
+
+  if (m < 0) return -1;
+  nw = m/wordsize;
+  if (wordsize == 4) {
+    for (i=0; i<nw; i++) {
+      for (b=0; b<4; b++) w4 ^= (unsigned int) tmp[b*nw+i] << (8*b);
+      memcpy(&out[4*i], &w4, 4);
+    }
+  }
+  else {
+    for (i=0; i<nw; i++) {
+      for (b=0; b<8; b++) w8 ^= (unsigned long long) tmp[b*nw+i] << (8*b);
+      memcpy(&out[8*i], &w8, 8);
+    }
+  }
+  memcpy(&out[nw*wordsize], &tmp[nw*wordsize], m - nw*wordsize);
+  return m;
+}
+
+static int encode(int codec, const unsigned char *in, int n, int wordsize,
+		  unsigned char *out, int max, unsigned char *tmp) {
+  if (codec == CODEC_LZ) return lz_compress(in, n, out, max);
+  return shuffle_compress(in, n, wordsize, out, max, tmp);
+}
+
+static int decode(int codec, const unsigned char *in, int n, int wordsize,
+		  unsigned char *out, int max, unsigned char *tmp) {
+  if (codec == CODEC_LZ) return lz_decompress(in, n, out, max);
+  return shuffle_decompress(in, n, wordsize, out, max, tmp);
+}
+
+/* Choose the codec that is estimated to give the shortest total time
+   for compression, transfer and decompression of n bytes */
+static int choose_codec(const unsigned char *buf, int n, int wordsize) {
+  unsigned char sample[SAMPLES*SAMPLE], out[SAMPLES*SAMPLE], tmp[SAMPLES*SAMPLE];
+  unsigned char back[SAMPLES*SAMPLE];
+  int s, len = 0, i, c, m, best = CODEC_NONE;
+  double t, ratio, est, best_est = n/bandwidth;
+
+  /* Samples from the beginning, middle and end, whole words */
+  s = n/(8*SAMPLES);
+  if (s > SAMPLE) s = SAMPLE;
+  s -= s % 8;
+  if (s < 64) return CODEC_NONE;
+  for (i=0; i<SAMPLES; i++) {
+    memcpy(&sample[len], &buf[(long long)(n-s)*i/(SAMPLES-1)/8*8], s);
+    len += s;
+  }
+
+  for (c=CODEC_LZ; c<NCODECS; c++) {
+    if (c == CODEC_SHUFFLE && wordsize != 4 && wordsize != 8) continue;
+    t = MPI_Wtime();
+    m = encode(c, sample, len, wordsize, out, len, tmp);
+    t = MPI_Wtime() - t;
+    if (m < 0) continue;          /* Does not compress */
+    comp_speed[c] = comp_speed[c] > 0.0 ? 0.8*comp_speed[c] + 0.2*len/(t+1e-9) : len/(t+1e-9);
+    t = MPI_Wtime();
+    decode(c, out, m, wordsize, back, len, tmp);
+    t = MPI_Wtime() - t;
+    decomp_speed[c] = decomp_speed[c] > 0.0 ? 0.8*decomp_speed[c] + 0.2*len/(t+1e-9) : len/(t+1e-9);
+
+    ratio = (double)m/len;
+    est = n/comp_speed[c] + ratio*n/bandwidth + n/decomp_speed[c];
+    if (est < best_est) {
+      best_est = est;
+      best = c;
+    }
+  }
+  return best;
+}
+
+int compress_send(void *buf, int count, MPI_Datatype type, int dest, int tag,
+		  MPI_Comm comm) {
+  int size, n, codec, m = -1, header[2], err;
+  double t0 = MPI_Wtime(), t;
+
+  MPI_Type_size(type, &size);
+  n = count*size;
+  if (n < threshold) {
+    err = MPI_Send(buf, count, type, dest, tag, comm);
+    stats.raw_bytes += n;
+    stats.wire_bytes += n;
+    stats.messages[CODEC_NONE]++;
+    stats.time += MPI_Wtime() - t0;
+    return err;
+  }
+
+  codec = choose_codec((unsigned char *) buf, n, size);
+  if (codec != CODEC_NONE) {
+    grow(&work, &work_size, n);
+    grow(&shuf, &shuf_size, n);
+    /* Only worth it if at least 1/16 is saved */
+    m = encode(codec, (unsigned char *) buf, n, size, work, n - n/16, shuf);
+    if (m < 0) codec = CODEC_NONE;
+  }
+
+  /* The header tells the receiver how to receive the data, which is
+     sent in a second message */
+  header[0] = codec;
+  header[1] = codec == CODEC_NONE ? n : m;
+  t = MPI_Wtime();
+  MPI_Send(header, 2, MPI_INT, dest, tag, comm);
+  if (codec == CODEC_NONE)
+    err = MPI_Send(buf, count, type, dest, tag, comm);
+  else
+    err = MPI_Send(work, m, MPI_BYTE, dest, tag, comm);
+  t = MPI_Wtime() - t;
+  if (!fixed_bandwidth && t > 0.0)
+    bandwidth = 0.75*bandwidth + 0.25*(HEADER + header[1])/t;
+
+  stats.raw_bytes += n;
+  stats.wire_bytes += HEADER + header[1];
+  stats.messages[codec]++;
+  stats.time += MPI_Wtime() - t0;
+  return err;
+}
+
+int compress_recv(void *buf, int count, MPI_Datatype type, int source, int tag,
+		  MPI_Comm comm, MPI_Status *status) {
+  int size, n, header[2], err, m;
+  MPI_Status st;
+
+  if (status == MPI_STATUS_IGNORE) status = &st;
+  MPI_Type_size(type, &size);
+  n = count*size;
+  if (n < threshold)
+    return MPI_Recv(buf, count, type, source, tag, comm, status);
+
+  /* The data comes from the same process as the header, and messages
+     between two processes do not overtake each other */
+  err = MPI_Recv(header, 2, MPI_INT, source, tag, comm, status);
+  if (err != MPI_SUCCESS) return err;
+  source = status->MPI_SOURCE;
+  if (header[0] == CODEC_NONE)
+    return MPI_Recv(buf, count, type, source, tag, comm, status);
+
+  grow(&work, &work_size, header[1]);
+  grow(&shuf, &shuf_size, n);
+  err = MPI_Recv(work, header[1], MPI_BYTE, source, tag, comm, status);
+  if (err != MPI_SUCCESS) return err;
+  m = decode(header[0], work, header[1], size, (unsigned char *) buf, n, shuf);
+  if (m < 0) {
+    fprintf(stderr, "compress_recv: corrupt message from %d\n", source);
+    MPI_Abort(comm, 1);
+  }
+  MPI_Status_set_elements(status, type, m/size);
+  return MPI_SUCCESS;
+}
+
+void compress_set_threshold(int bytes) {
+  threshold = bytes;
+}
+
+void compress_set_bandwidth(double bytes_per_second) {
+  fixed_bandwidth = bytes_per_second > 0.0;
+  if (fixed_bandwidth) bandwidth = bytes_per_second;
+}
+
+void compress_get_stats(compress_stats *s) {
+  *s = stats;
+}
+
+void compress_reset_stats(void) {
+  memset(&stats, 0, sizeof(stats));
+}
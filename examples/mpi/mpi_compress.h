@@ -0,0 +1,75 @@
+#ifndef MPI_COMPRESS_H
+#define MPI_COMPRESS_H
+
+/*
+  Send and receive with transparent compression of large messages.
+
+  Messages smaller than a threshold are sent as they are. Larger
+  messages are compressed with one of two codecs, or sent without
+  compression if that is estimated to be faster:
+
+    CODEC_LZ       an LZ77 block codec in the style of LZ4, byte
+                   oriented with a 64 KB window
+    CODEC_SHUFFLE  for 4 and 8 byte types such as MPI_FLOAT, MPI_INT
+                   and MPI_DOUBLE. Each word is XORed with the previous
+                   one, and the bytes are shuffled so that byte 0 of all
+                   words comes first, then byte 1 and so on. Neighbouring
+                   values of a smooth field share their sign, exponent and
+                   high mantissa bits, so this gives long runs of zero
+                   bytes that the LZ codec then compresses. The codec is
+                   lossless.
+
+  The codec is chosen for each message. A few small samples of the
+  message are compressed with each codec, which gives the compression
+  ratio and the speed of compression and decompression. Together with
+  the network bandwidth, measured from earlier sends, this gives an
+  estimate of the time for each choice.
+
+  Both sides have to use these functions with the same count, and only
+  contiguous data is supported. A large message is sent as a small
+  header with the codec and size, followed by the data, so data that is
+  not compressed is sent and received without extra copies.
+
+  See mpi_send-compressed.c for an example.
+*/
+
+#include <mpi.h>
+
+#define CODEC_NONE    0
+#define CODEC_LZ      1
+#define CODEC_SHUFFLE 2
+
+typedef struct {
+  double raw_bytes;      /* Bytes given to compress_send */
+  double wire_bytes;     /* Bytes actually sent */
+  double time;           /* Time in compress_send, including compression */
+  int messages[3];       /* Number of messages sent with each codec */
+} compress_stats;
+
+int compress_send(void *buf, int count, MPI_Datatype type, int dest, int tag,
+		  MPI_Comm comm);
+int compress_recv(void *buf, int count, MPI_Datatype type, int source, int tag,
+		  MPI_Comm comm, MPI_Status *status);
+
+/* Messages of at least this many bytes are considered for compression */
+void compress_set_threshold(int bytes);
+
+/* Use this bandwidth (bytes/s) in the estimates instead of measuring it.
+   0 returns to measuring */
+void compress_set_bandwidth(double bytes_per_second);
+
+void compress_get_stats(compress_stats *stats);
+void compress_reset_stats(void);
+
+/* The codecs on their own. The compress functions return the size of
+   the compressed data, or -1 if it would be larger than max bytes. The
+   decompress functions return the number of bytes produced, or -1 if
+   the data is corrupt */
+int lz_compress(const unsigned char *in, int n, unsigned char *out, int max);
+int lz_decompress(const unsigned char *in, int n, unsigned char *out, int max);
+int shuffle_compress(const unsigned char *in, int n, int wordsize,
+		     unsigned char *out, int max, unsigned char *tmp);
+int shuffle_decompress(const unsigned char *in, int n, int wordsize,
+		       unsigned char *out, int max, unsigned char *tmp);
+
+#endif
@@ -0,0 +1,41 @@
+#include "mpi_compressfile.h"
+
+long long block_checksum(const unsigned char *p, int n) {
+  unsigned int h = 2166136261u;
+  int i;
+  for (i=0; i<n; i++) h = (h ^ p[i]) * 16777619u;
+  return (long long) h;
+}
+
+/* Read or write in pieces of at most IO_CHUNK bytes. All processes make
+   as many calls as the one with the most pieces, since the calls are
+   collective, and the ones that are done read or write 0 bytes */
+static int io_at_all(MPI_File fh, MPI_Offset offset, char *buf, long long len,
+		     MPI_Comm comm, int write) {
+  long long pieces = (len + IO_CHUNK - 1)/IO_CHUNK, done = 0, k;
+  int n, err, result = MPI_SUCCESS;
+
+  MPI_Allreduce(MPI_IN_PLACE, &pieces, 1, MPI_LONG_LONG, MPI_MAX, comm);
+  for (k=0; k<pieces; k++) {
+    n = (int) (len - done < IO_CHUNK ? len - done : IO_CHUNK);
+    if (write)
+      err = MPI_File_write_at_all(fh, offset + done, buf + done, n, MPI_BYTE,
+				  MPI_STATUS_IGNORE);
+    else
+      err = MPI_File_read_at_all(fh, offset + done, buf + done, n, MPI_BYTE,
+				 MPI_STATUS_IGNORE);
+    if (result == MPI_SUCCESS) result = err;
+    done += n;
+  }
+  return result;
+}
+
+int file_write_at_all(MPI_File fh, MPI_Offset offset, void *buf, long long len,
+		      MPI_Comm comm) {
+  return io_at_all(fh, offset, (char *) buf, len, comm, 1);
+}
+
+int file_read_at_all(MPI_File fh, MPI_Offset offset, void *buf, long long len,
+		     MPI_Comm comm) {
+  return io_at_all(fh, offset, (char *) buf, len, comm, 0);
+}
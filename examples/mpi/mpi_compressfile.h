@@ -0,0 +1,47 @@
+#ifndef MPI_COMPRESSFILE_H
+#define MPI_COMPRESSFILE_H
+
+/*
+  The layout of the compressed files that mpi_writefile-compressed.c
+  writes and mpi_readfile-compressed.c reads:
+
+    magic      8 bytes "PaPPzip1"
+    blocksize  8 bytes
+    blocks     the compressed data of all processes in rank order
+    index      ENTRY long longs per block: file offset, compressed size,
+               offset in the uncompressed data, uncompressed size, codec
+               and checksum of the uncompressed data
+    trailer    4 long longs: index offset, number of blocks, uncompressed
+               size and TRAILER_MAGIC
+
+  The blocks are compressed with the codecs in mpi_compress.c, so that
+  any block can be decompressed on its own. The functions below are in
+  mpi_compressfile.c.
+*/
+
+#include <mpi.h>
+#include "mpi_compress.h"
+
+#define MAGIC "PaPPzip1"
+#define TRAILER_MAGIC 0x5061505046494cLL
+#define HEADERSIZE 16
+#define ENTRY 6              /* long longs per index entry */
+
+/* The counts of MPI-IO are ints, so larger reads and writes are done in
+   pieces of this many bytes */
+#ifndef IO_CHUNK
+#define IO_CHUNK (1 << 30)
+#endif
+
+/* FNV-1a checksum of the uncompressed data in a block */
+long long block_checksum(const unsigned char *p, int n);
+
+/* MPI_File_write_at_all and MPI_File_read_at_all of len bytes, which
+   may be more than fit in an int. All processes of comm, the
+   communicator the file was opened with, must call them */
+int file_write_at_all(MPI_File fh, MPI_Offset offset, void *buf, long long len,
+		      MPI_Comm comm);
+int file_read_at_all(MPI_File fh, MPI_Offset offset, void *buf, long long len,
+		     MPI_Comm comm);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi_dataset.h"
+
+MPI_Datatype dset_mpi_type(int type) {
+  switch (type) {
+  case DSET_CHAR: return MPI_CHAR;
+  case DSET_INT: return MPI_INT;
+  case DSET_FLOAT: return MPI_FLOAT;
+  default: return MPI_DOUBLE;
+  }
+}
+
+/* Build the file and memory types for the box start..start+count-1.
+   Returns 0 if the box is empty, in which case no types are created */
+static int build_types(const dset_header *h, const int *start, const int *count,
+		       const int *lsize, const int *lstart,
+		       MPI_Datatype *filetype, MPI_Datatype *memtype) {
+  int nd = (int) h->ndims, d, n, i, k;
+  int clo[DSET_MAXDIMS], chi[DSET_MAXDIMS], c[DSET_MAXDIMS];
+  int csize[DSET_MAXDIMS], sub[DSET_MAXDIMS], fstart[DSET_MAXDIMS];
+  int msize[DSET_MAXDIMS], mstart[DSET_MAXDIMS], lo, hi;
+  int *blocks;
+  long long chunkbytes = dset_chunk_elements(h)*h->elemsize, linear;
+  MPI_Aint *fdispl, *mdispl;
+  MPI_Datatype *ftypes, *mtypes, etype = dset_mpi_type((int) h->type);
+
+  /* The range of chunks that the box overlaps */
+  n = 1;
+  for (d=0; d<nd; d++) {
+    if (count[d] <= 0) return 0;
+    clo[d] = (int) (start[d]/h->chunk[d]);
+    chi[d] = (int) ((start[d]+count[d]-1)/h->chunk[d]);
+    n *= chi[d] - clo[d] + 1;
+    c[d] = clo[d];
+    csize[d] = (int) h->chunk[d];
+    msize[d] = lsize ? lsize[d] : count[d];
+  }
+
+  blocks = (int *) malloc(n*sizeof(int));
+  fdispl = (MPI_Aint *) malloc(n*sizeof(MPI_Aint));
+  mdispl = (MPI_Aint *) malloc(n*sizeof(MPI_Aint));
+  ftypes = (MPI_Datatype *) malloc(n*sizeof(MPI_Datatype));
+  mtypes = (MPI_Datatype *) malloc(n*sizeof(MPI_Datatype));
+
+  /* Visit the chunks in the order they are stored, so that the file
+     displacements increase */
+  for (k=0; k<n; k++) {
+    linear = 0;
+    for (d=0; d<nd; d++) {
+      lo = c[d]*csize[d] > start[d] ? c[d]*csize[d] : start[d];
+      hi = (c[d]+1)*csize[d] < start[d]+count[d] ? (c[d]+1)*csize[d] : start[d]+count[d];
+      sub[d] = hi - lo;
+      fstart[d] = lo - c[d]*csize[d];
+      mstart[d] = (lstart ? lstart[d] : 0) + lo - start[d];
+      linear = linear*dset_chunks_along(h, d) + c[d];
+    }
+    MPI_Type_create_subarray(nd, csize, sub, fstart, MPI_ORDER_C, etype, &ftypes[k]);
+    MPI_Type_create_subarray(nd, msize, sub, mstart, MPI_ORDER_C, etype, &mtypes[k]);
+    blocks[k] = 1;
+    fdispl[k] = (MPI_Aint) (linear*chunkbytes);
+    mdispl[k] = 0;
+
+    /* Next chunk, last dimension fastest */
+    for (i=nd-1; i>=0; i--) {
+      if (++c[i] <= chi[i]) break;
+      c[i] = clo[i];
+    }
+  }
+
+  MPI_Type_create_struct(n, blocks, fdispl, ftypes, filetype);
+  MPI_Type_create_struct(n, blocks, mdispl, mtypes, memtype);
+  MPI_Type_commit(filetype);
+  MPI_Type_commit(memtype);
+
+  for (k=0; k<n; k++) {
+    MPI_Type_free(&ftypes[k]);
+    MPI_Type_free(&mtypes[k]);
+  }
+  free(blocks); free(fdispl); free(mdispl); free(ftypes); free(mtypes);
+  return 1;
+}
+
+/* Read or write the box with one collective call */
+static int transfer(MPI_File fh, const dset_header *h, const int *start,
+		    const int *count, void *buf, const int *lsize,
+		    const int *lstart, int write) {
+  MPI_Datatype filetype, memtype, etype = dset_mpi_type((int) h->type);
+  int err, nonempty;
+
+  nonempty = build_types(h, start, count, lsize, lstart, &filetype, &memtype);
+  MPI_File_set_view(fh, h->data_offset, etype, nonempty ? filetype : etype,
+		    "native", MPI_INFO_NULL);
+  if (write)
+    err = MPI_File_write_all(fh, buf, nonempty, nonempty ? memtype : etype,
+			     MPI_STATUS_IGNORE);
+  else
+    err = MPI_File_read_all(fh, buf, nonempty, nonempty ? memtype : etype,
+			    MPI_STATUS_IGNORE);
+  if (nonempty) {
+    MPI_Type_free(&filetype);
+    MPI_Type_free(&memtype);
+  }
+  return err == MPI_SUCCESS ? 0 : -1;
+}
+
+int dset_write(MPI_Comm comm, const char *filename, const dset_header *h,
+	       const int *start, const int *count, void *buf,
+	       const int *lsize, const int *lstart) {
+  unsigned char header[DSET_HEADERSIZE];
+  long long *index, chunkbytes = dset_chunk_elements(h)*h->elemsize, i;
+  int me, err;
+  MPI_File fh;
+
+  MPI_Comm_rank(comm, &me);
+  if (me == 0) MPI_File_delete((char *) filename, MPI_INFO_NULL);
+  MPI_Barrier(comm);
+  if (MPI_File_open(comm, (char *) filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+		    MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+    return -1;
+
+  if (me == 0) {
+    dset_pack_header(h, header);
+    MPI_File_write_at(fh, 0, header, DSET_HEADERSIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    index = (long long *) malloc(2*h->nchunks*sizeof(long long));
+    for (i=0; i<h->nchunks; i++) {
+      index[2*i] = h->data_offset + i*chunkbytes;
+      index[2*i+1] = chunkbytes;
+    }
+    MPI_File_write_at(fh, h->index_offset, index, (int) (2*h->nchunks),
+		      MPI_LONG_LONG, MPI_STATUS_IGNORE);
+    free(index);
+  }
+  /* The padding at the edges is never written, but is part of the file */
+  MPI_File_set_size(fh, h->data_offset + h->nchunks*chunkbytes);
+
+  err = transfer(fh, h, start, count, buf, lsize, lstart, 1);
+  MPI_File_close(&fh);
+  return err;
+}
+
+int dset_read_header(MPI_Comm comm, const char *filename, dset_header *h) {
+  unsigned char header[DSET_HEADERSIZE];
+  int me, ok = 0;
+  MPI_File fh;
+
+  MPI_Comm_rank(comm, &me);
+  if (MPI_File_open(comm, (char *) filename, MPI_MODE_RDONLY, MPI_INFO_NULL,
+		    &fh) != MPI_SUCCESS)
+    return -1;
+  if (me == 0) {
+    MPI_File_read_at(fh, 0, header, DSET_HEADERSIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    ok = dset_unpack_header(header, h) == 0;
+  }
+  MPI_File_close(&fh);
+  MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+  if (!ok) return -1;
+  MPI_Bcast(h, sizeof(dset_header), MPI_BYTE, 0, comm);
+  return 0;
+}
+
+int dset_read(MPI_Comm comm, const char *filename, const int *start,
+	      const int *count, void *buf, const int *lsize, const int *lstart) {
+  dset_header h;
+  int err;
+  MPI_File fh;
+
+  if (dset_read_header(comm, filename, &h) != 0) return -1;
+  if (MPI_File_open(comm, (char *) filename, MPI_MODE_RDONLY, MPI_INFO_NULL,
+		    &fh) != MPI_SUCCESS)
+    return -1;
+  err = transfer(fh, &h, start, count, buf, lsize, lstart, 0);
+  MPI_File_close(&fh);
+  return err;
+}
@@ -0,0 +1,44 @@
+#ifndef MPI_DATASET_H
+#define MPI_DATASET_H
+
+/*
+  Parallel reading and writing of the chunked array files described in
+  dataset.h.
+
+  Every process gives the part of the global array it owns as a box
+  with a start index and a count in each dimension. The box may be
+  empty, and the boxes need not follow the chunks, so a file can be read
+  with a different number of processes and a different decomposition
+  than it was written with. The local data can have ghost cells: lsize
+  is the size of the local array and lstart the index of the first
+  element of the box in it. If lsize is NULL the local array is exactly
+  the box.
+
+  For each chunk that the box overlaps, the overlap is described by one
+  MPI subarray type in the file and one in memory. These are combined
+  with MPI_Type_create_struct into a file view and a memory type, and
+  all processes then read or write with a single collective call.
+
+  See mpi_snapshot.c for an example.
+*/
+
+#include <mpi.h>
+#include "dataset.h"
+
+/* The MPI datatype for an element type in dataset.h */
+MPI_Datatype dset_mpi_type(int type);
+
+/* Create a file and write an array to it. h is made with
+   dset_init_header and is the same in all processes. Returns 0 or -1 */
+int dset_write(MPI_Comm comm, const char *filename, const dset_header *h,
+	       const int *start, const int *count, void *buf,
+	       const int *lsize, const int *lstart);
+
+/* Read the header of a file. Returns 0 or -1 */
+int dset_read_header(MPI_Comm comm, const char *filename, dset_header *h);
+
+/* Read a box of the array in a file. Returns 0 or -1 */
+int dset_read(MPI_Comm comm, const char *filename, const int *start,
+	      const int *count, void *buf, const int *lsize, const int *lstart);
+
+#endif
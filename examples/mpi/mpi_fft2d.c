@@ -0,0 +1,349 @@
+/*
+  MPI example program that computes a distributed two-dimensional complex
+  FFT of an N*N matrix.
+
+  The matrix is decomposed in slabs: each of the np processes owns R=N/np
+  consecutive rows. A 2D FFT is computed in three phases:
+
+    1. every process does 1D FFTs on its own rows,
+    2. the matrix is transposed globally with one MPI_Alltoall,
+    3. every process does 1D FFTs on its rows of the transposed matrix,
+       which are the columns of the original matrix.
+
+  The result is left in transposed order, which is the usual convention
+  for slab decomposed FFTs. The inverse transform runs the same phases
+  backwards and brings the data back to the original layout.
+
+  The global transpose does not pack the data into a send buffer. Like the
+  column type in mpi_sendcol.c, derived datatypes describe where the
+  elements are: the send type picks an R*R block out of the local rows, and
+  the receive type scatters the incoming rows of that block into columns
+  of the local part of the transposed matrix. MPI_Alltoall then moves the
+  data straight between the two matrices.
+
+  The local FFTs are iterative radix-2 FFTs where two stages at a time are
+  combined into radix-4 butterflies, with one radix-2 stage first if log2(N)
+  is odd. A complex number is kept in one SSE register when the compiler
+  supports SSE3 (compile with -msse3 or -march=native), otherwise plain C
+  is used.
+
+  The program first transforms a plane wave and checks that all energy
+  ends up in one frequency. It then runs a number of forward and inverse
+  transforms of random data, checks the round trip error, and reports how
+  the time is split between computation and the transpose.
+
+  N must be a power of two and divisible by the number of processes.
+
+  Compile the program with 'mpicc -O3 -msse3 mpi_fft2d.c -o mpi_fft2d -lm'
+  Run the program with 'mpiexec -n 4 ./mpi_fft2d -n 1024 -r 10'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef __SSE3__
+#include <pmmintrin.h>
+#endif
+
+const double PI = 3.141592653589793238462643;
+
+/* One complex number, either an SSE register or a pair of doubles */
+#ifdef __SSE3__
+typedef __m128d cvec;
+
+static inline cvec cload(const double *p) { return _mm_loadu_pd(p); }
+static inline void cstore(double *p, cvec a) { _mm_storeu_pd(p, a); }
+static inline cvec cadd(cvec a, cvec b) { return _mm_add_pd(a, b); }
+static inline cvec csub(cvec a, cvec b) { return _mm_sub_pd(a, b); }
+
+/* (ar*br - ai*bi, ai*br + ar*bi) */
+static inline cvec cmul(cvec a, cvec b) {
+  __m128d br = _mm_movedup_pd(b);
+  __m128d bi = _mm_unpackhi_pd(b, b);
+  __m128d as = _mm_shuffle_pd(a, a, 1);
+  return _mm_addsub_pd(_mm_mul_pd(a, br), _mm_mul_pd(as, bi));
+}
+
+/* Multiply by -i (dir=1) or +i (dir=-1) */
+static inline cvec cmul_i(cvec a, int dir) {
+  __m128d s = _mm_shuffle_pd(a, a, 1);     /* (ai, ar) */
+  __m128d m = (dir > 0) ? _mm_set_pd(-0.0, 0.0) : _mm_set_pd(0.0, -0.0);
+  return _mm_xor_pd(s, m);
+}
+#else
+typedef struct { double re, im; } cvec;
+
+static inline cvec cload(const double *p) { cvec a; a.re = p[0]; a.im = p[1]; return a; }
+static inline void cstore(double *p, cvec a) { p[0] = a.re; p[1] = a.im; }
+static inline cvec cadd(cvec a, cvec b) { a.re += b.re; a.im += b.im; return a; }
+static inline cvec csub(cvec a, cvec b) { a.re -= b.re; a.im -= b.im; return a; }
+
+static inline cvec cmul(cvec a, cvec b) {
+  cvec c;
+  c.re = a.re*b.re - a.im*b.im;
+  c.im = a.im*b.re + a.re*b.im;
+  return c;
+}
+
+static inline cvec cmul_i(cvec a, int dir) {
+  cvec c;
+  if (dir > 0) { c.re = a.im;  c.im = -a.re; }
+  else         { c.re = -a.im; c.im = a.re;  }
+  return c;
+}
+#endif
+
+int N, logN;          /* Size of the matrix and log2(N) */
+int *rev;             /* Bit reversal permutation of 0..N-1 */
+double *tw[2];        /* Twiddle factors for forward and inverse FFT */
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <matrix size> -r <repetitions>\n", s);
+  MPI_Finalize();
+  exit(0);
+}
+
+/* Simple random number generator, the same on all platforms */
+double next_random(unsigned int *state) {
+  *state = *state * 1103515245u + 12345u;
+  return (double)((*state >> 8) & 0xffffff) / (double)0x1000000;
+}
+
+/* Precompute the bit reversal table and the twiddle factors */
+void init_fft(void) {
+  int i, j, k;
+
+  rev = (int *) malloc(N*sizeof(int));
+  for (i=0; i<N; i++) {
+    for (j=0, k=i, rev[i]=0; j<logN; j++, k>>=1)
+      rev[i] = (rev[i]<<1) | (k&1);
+  }
+
+  /* tw[0][k] = exp(-2*pi*i*k/N), tw[1][k] = exp(2*pi*i*k/N) */
+  tw[0] = (double *) malloc(N*sizeof(double));
+  tw[1] = (double *) malloc(N*sizeof(double));
+  for (k=0; k<N/2; k++) {
+    tw[0][2*k] = tw[1][2*k] = cos(2.0*PI*k/N);
+    tw[0][2*k+1] = -sin(2.0*PI*k/N);
+    tw[1][2*k+1] =  sin(2.0*PI*k/N);
+  }
+}
+
+/* In-place FFT of one row of N complex numbers.
+   dir = 1 is the forward transform, dir = -1 the inverse (unscaled) */
+void fft_row(double *x, int dir) {
+  const double *w = tw[dir > 0 ? 0 : 1];
+  int i, j, k, h;
+  double t;
+
+  /* Reorder the input in bit reversed order */
+  for (i=0; i<N; i++) {
+    j = rev[i];
+    if (i < j) {
+      t = x[2*i];   x[2*i] = x[2*j];     x[2*j] = t;
+      t = x[2*i+1]; x[2*i+1] = x[2*j+1]; x[2*j+1] = t;
+    }
+  }
+
+  h = 1;
+  /* One radix-2 stage if log2(N) is odd, the twiddle factors are all 1 */
+  if (logN & 1) {
+    for (k=0; k<N; k+=2) {
+      cvec a = cload(&x[2*k]), b = cload(&x[2*k+2]);
+      cstore(&x[2*k], cadd(a, b));
+      cstore(&x[2*k+2], csub(a, b));
+    }
+    h = 2;
+  }
+
+  /* Radix-4 butterflies, each doing the stages of length 2h and 4h */
+  for (; h<N; h*=4) {
+    const int s1 = N/(2*h), s2 = N/(4*h);   /* Twiddle strides */
+    for (k=0; k<N; k+=4*h) {
+      for (j=0; j<h; j++) {
+	double *p0 = &x[2*(k+j)], *p1 = p0+2*h, *p2 = p1+2*h, *p3 = p2+2*h;
+	cvec w1 = cload(&w[2*j*s1]);   /* W_2h^j */
+	cvec w2 = cload(&w[2*j*s2]);   /* W_4h^j */
+	cvec a = cload(p0), b = cmul(cload(p1), w1);
+	cvec c = cload(p2), d = cmul(cload(p3), w1);
+	cvec a1 = cadd(a, b), b1 = csub(a, b);
+	cvec c1 = cmul(cadd(c, d), w2);
+	cvec d1 = cmul_i(cmul(csub(c, d), w2), dir);   /* W_4h^(j+h) */
+	cstore(p0, cadd(a1, c1));
+	cstore(p2, csub(a1, c1));
+	cstore(p1, cadd(b1, d1));
+	cstore(p3, csub(b1, d1));
+      }
+    }
+  }
+}
+
+/* 1D FFTs of all local rows, returns the time used */
+double fft_rows(double *x, int rows, int dir) {
+  double t = MPI_Wtime();
+  int i;
+  for (i=0; i<rows; i++) fft_row(&x[2*i*N], dir);
+  return MPI_Wtime()-t;
+}
+
+/* Global transpose from src to dst, returns the time used */
+double transpose(double *src, double *dst, MPI_Datatype send_type,
+		 MPI_Datatype recv_type) {
+  double t = MPI_Wtime();
+  MPI_Alltoall(src, 1, send_type, dst, 1, recv_type, MPI_COMM_WORLD);
+  return MPI_Wtime()-t;
+}
+
+int main(int argc, char *argv[]) {
+  int np, me, R, reps=5, i, j, r;
+  int k1 = 3, k2 = 5;            /* Frequency of the test plane wave */
+  double *A, *T;                 /* Local rows of the matrix and its transpose */
+  double t_fft=0.0, t_trans=0.0, t_total, err, maxerr, tmax[3], tloc[3];
+  double flops;
+  unsigned int seed;
+  int c;
+  MPI_Datatype cplx, block, col, col1, rows, send_type, recv_type;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  N = 256;
+  while ((c=getopt(argc, argv, "hn:r:")) != EOF) {
+    switch (c) {
+    case 'n':
+      N = atoi(optarg);
+      break;
+    case 'r':
+      reps = atoi(optarg);
+      break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+
+  /* Check that N is a power of two that can be divided evenly */
+  for (logN=0; (1<<logN) < N; logN++) ;
+  if (N < 4 || (1<<logN) != N || N%np != 0) {
+    if (me == 0)
+      printf("The matrix size must be a power of two divisible by %d\n", np);
+    MPI_Finalize();
+    exit(1);
+  }
+  R = N/np;     /* Number of rows in each process */
+  k1 %= N;      /* Frequencies that fit in a small matrix */
+  k2 %= N;
+
+  init_fft();
+  A = (double *) malloc(2*R*N*sizeof(double));
+  T = (double *) malloc(2*R*N*sizeof(double));
+
+  /* A complex number is two doubles */
+  MPI_Type_contiguous(2, MPI_DOUBLE, &cplx);
+
+  /* Send type: an R*R block of the local rows. The extent is set to R
+     complex numbers so that the block for process p starts at column p*R */
+  MPI_Type_vector(R, R, N, cplx, &block);
+  MPI_Type_create_resized(block, 0, R*2*sizeof(double), &send_type);
+  MPI_Type_commit(&send_type);
+
+  /* Receive type: row r of the incoming block is stored in column r of
+     the block, so the elements of a row are N complex numbers apart.
+     Consecutive rows go to consecutive columns, and the block from
+     process p starts at column p*R of the transposed rows */
+  MPI_Type_vector(R, 1, N, cplx, &col);
+  MPI_Type_create_resized(col, 0, 2*sizeof(double), &col1);
+  MPI_Type_contiguous(R, col1, &rows);
+  MPI_Type_create_resized(rows, 0, R*2*sizeof(double), &recv_type);
+  MPI_Type_commit(&recv_type);
+
+  if (me == 0) {
+    printf("2D FFT of a %d*%d matrix on %d processes, %d rows each\n", N, N, np, R);
+#ifdef __SSE3__
+    printf("Using SSE3 butterflies\n");
+#else
+    printf("Using scalar butterflies\n");
+#endif
+  }
+
+  /* Test: a plane wave exp(2*pi*i*(k1*x+k2*y)/N) has all its energy in
+     frequency (k1,k2). In the transposed result that is row k2, column k1 */
+  for (i=0; i<R; i++) {
+    for (j=0; j<N; j++) {
+      double phase = 2.0*PI*(double)((k1*(me*R+i) + k2*j) % N)/N;
+      A[2*(i*N+j)] = cos(phase);
+      A[2*(i*N+j)+1] = sin(phase);
+    }
+  }
+  fft_rows(A, R, 1);
+  transpose(A, T, send_type, recv_type);
+  fft_rows(T, R, 1);
+  err = 0.0;
+  for (i=0; i<R; i++) {
+    for (j=0; j<N; j++) {
+      double expect = (me*R+i == k2 && j == k1) ? (double)N*N : 0.0;
+      err = fmax(err, fabs(T[2*(i*N+j)]-expect) + fabs(T[2*(i*N+j)+1]));
+    }
+  }
+  MPI_Reduce(&err, &maxerr, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (me == 0)
+    printf("Plane wave test: max error %e relative to %e %s\n", maxerr,
+	   (double)N*N, (maxerr < 1e-9*N*N) ? "OK" : "FAILED");
+
+  /* Benchmark with random data */
+  seed = 17 + me;
+  for (i=0; i<2*R*N; i++) A[i] = next_random(&seed) - 0.5;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t_total = MPI_Wtime();
+  for (r=0; r<reps; r++) {
+    /* Forward transform */
+    t_fft   += fft_rows(A, R, 1);
+    t_trans += transpose(A, T, send_type, recv_type);
+    t_fft   += fft_rows(T, R, 1);
+    /* Inverse transform back to the original layout */
+    t_fft   += fft_rows(T, R, -1);
+    t_trans += transpose(T, A, send_type, recv_type);
+    t_fft   += fft_rows(A, R, -1);
+    for (i=0; i<2*R*N; i++) A[i] *= 1.0/((double)N*N);
+  }
+  t_total = MPI_Wtime()-t_total;
+
+  /* Compare with the original data */
+  seed = 17 + me;
+  err = 0.0;
+  for (i=0; i<2*R*N; i++) err = fmax(err, fabs(A[i] - (next_random(&seed)-0.5)));
+  MPI_Reduce(&err, &maxerr, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  /* The slowest process determines the time */
+  tloc[0] = t_fft; tloc[1] = t_trans; tloc[2] = t_total;
+  MPI_Reduce(tloc, tmax, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  if (me == 0) {
+    /* The usual 5*N*log2(N) flop count, N*N points in a 2D FFT */
+    flops = 5.0*N*N*(2.0*logN) * 2.0*reps;
+    printf("%d forward and inverse transforms in %f seconds\n", reps, tmax[2]);
+    printf("Round trip max error %e %s\n", maxerr, (maxerr < 1e-10) ? "OK" : "FAILED");
+    printf("Time per 2D FFT:   %f ms\n", 1000.0*tmax[2]/(2.0*reps));
+    printf("  computation:     %f ms (%4.1f%%)\n", 1000.0*tmax[0]/(2.0*reps),
+	   100.0*tmax[0]/tmax[2]);
+    printf("  transpose:       %f ms (%4.1f%%)\n", 1000.0*tmax[1]/(2.0*reps),
+	   100.0*tmax[1]/tmax[2]);
+    printf("Performance: %f GFLOP/s\n", flops/tmax[2]*1e-9);
+    printf("Transpose bandwidth per process: %f MB/s\n",
+	   2.0*reps*(double)R*N*2*sizeof(double)*(np-1)/np/tmax[1]*1e-6);
+  }
+
+  MPI_Type_free(&send_type);  MPI_Type_free(&recv_type);
+  MPI_Type_free(&block);      MPI_Type_free(&col);
+  MPI_Type_free(&col1);       MPI_Type_free(&rows);
+  MPI_Type_free(&cplx);
+  free(A); free(T); free(rev); free(tw[0]); free(tw[1]);
+
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,311 @@
+/*
+  MPI example program that clusters a large set of points with the
+  k-means algorithm.
+
+  The points are read from a binary file with MPI-IO. The file starts
+  with two 32-bit integers, the number of points N and the dimension D,
+  followed by N*D single precision floats, one point after the other.
+  Each process reads its own consecutive block of points with one
+  collective MPI_File_read_at_all. With the -g flag the program first
+  writes such a file with N random points around K centers.
+
+  Every iteration has two steps:
+
+    1. Each process finds the nearest centroid for each of its points
+       and adds the point to a partial sum for that centroid. The
+       distances from a point to all centroids are computed with SIMD
+       instructions: the centroids are stored transposed, so that one
+       vector register holds the same coordinate of 4 (SSE) or 8 (AVX)
+       centroids.
+    2. The partial sums, the number of points in each cluster and the
+       sum of squared distances are combined with a single MPI_Allreduce
+       of K*D+K+1 values. All processes then compute the same new
+       centroids.
+
+  Compile the program with 'mpicc -O3 -march=native mpi_kmeans.c -o mpi_kmeans -lm'
+  Create a file and cluster it with
+    'mpiexec -n 4 ./mpi_kmeans -g 1000000 -d 16 -k 8 -f points.dat'
+  and cluster an existing file with
+    'mpiexec -n 4 ./mpi_kmeans -k 8 -f points.dat'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <limits.h>
+#include <mpi.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VLEN 8
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define VLEN 4
+#else
+#define VLEN 1
+#endif
+
+#define HEADER (2*sizeof(int))   /* Size of the file header */
+
+int me, np;
+
+void print_usage(char *s) {
+  printf("Usage: %s -f <file> -k <clusters> -i <max iterations> -t <tolerance>\n", s);
+  printf("          [-g <points to generate> -d <dimension>]\n");
+}
+
+/* Simple random number generator, different in each process */
+double next_random(unsigned long long *state) {
+  *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+  return (double)(*state >> 11) * (1.0/9007199254740992.0);
+}
+
+/* Normally distributed random number (Box-Muller) */
+double normal_random(unsigned long long *state) {
+  double u = next_random(state), v = next_random(state);
+  return sqrt(-2.0*log(u + 1e-300)) * cos(2.0*3.141592653589793*v);
+}
+
+/* Write a file with n points of dimension d around k random centers */
+void generate_file(char *filename, long long n, int d, int k) {
+  long long n0 = n*me/np, n1 = n*(me+1)/np, i;
+  unsigned long long state = 12345;
+  double *centers = (double *) malloc(k*d*sizeof(double));
+  float *buf = (float *) malloc(((n1-n0)*d+1)*sizeof(float));
+  int header[2], j, c;
+  MPI_Datatype point;
+  MPI_File fh;
+
+  /* All processes draw the same centers */
+  for (j=0; j<k*d; j++) centers[j] = 20.0*next_random(&state) - 10.0;
+
+  state = 1000 + me;
+  for (i=0; i<n1-n0; i++) {
+    c = (int)(next_random(&state)*k);
+    for (j=0; j<d; j++)
+      buf[i*d+j] = (float)(centers[c*d+j] + normal_random(&state));
+  }
+
+  MPI_File_delete(filename, MPI_INFO_NULL);
+  MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+		MPI_INFO_NULL, &fh);
+  if (me == 0) {
+    header[0] = (int)n;
+    header[1] = d;
+    MPI_File_write_at(fh, 0, header, 2, MPI_INT, MPI_STATUS_IGNORE);
+  }
+  /* Whole points are written, so that the count fits in an int */
+  MPI_Type_contiguous(d, MPI_FLOAT, &point);
+  MPI_Type_commit(&point);
+  MPI_File_write_at_all(fh, HEADER + (MPI_Offset)n0*d*sizeof(float), buf,
+			(int)(n1-n0), point, MPI_STATUS_IGNORE);
+  MPI_Type_free(&point);
+  MPI_File_close(&fh);
+
+  if (me == 0) printf("Wrote %lld points of dimension %d to %s\n", n, d, filename);
+  free(centers); free(buf);
+}
+
+/* Find the nearest of the k centroids to point x. ct holds the centroids
+   transposed, d rows of kpad floats. Returns the squared distance in *dmin */
+int nearest(const float *x, const float *ct, int d, int k, int kpad,
+	    float *dist, float *dmin) {
+  int j, c, best = 0;
+
+#if VLEN == 8
+  for (c=0; c<kpad; c+=8) {
+    __m256 acc = _mm256_setzero_ps();
+    for (j=0; j<d; j++) {
+      __m256 diff = _mm256_sub_ps(_mm256_set1_ps(x[j]), _mm256_loadu_ps(&ct[j*kpad+c]));
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(diff, diff));
+    }
+    _mm256_storeu_ps(&dist[c], acc);
+  }
+#elif VLEN == 4
+  for (c=0; c<kpad; c+=4) {
+    __m128 acc = _mm_setzero_ps();
+    for (j=0; j<d; j++) {
+      __m128 diff = _mm_sub_ps(_mm_set1_ps(x[j]), _mm_loadu_ps(&ct[j*kpad+c]));
+      acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+    }
+    _mm_storeu_ps(&dist[c], acc);
+  }
+#else
+  for (c=0; c<kpad; c++) {
+    float acc = 0.0f;
+    for (j=0; j<d; j++) acc += (x[j]-ct[j*kpad+c])*(x[j]-ct[j*kpad+c]);
+    dist[c] = acc;
+  }
+#endif
+  for (c=1; c<k; c++)
+    if (dist[c] < dist[best]) best = c;
+  *dmin = dist[best];
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  char *filename = "kmeans.dat";
+  long long ngen = 0, n, n0, n1, i;
+  int d = 16, k = 8, maxit = 50, kpad, it, j, c, opt, header[2];
+  double tol = 1e-4, *centroids, *sums, shift, t0, t1, t2;
+  double t_assign = 0.0, t_reduce = 0.0, t_iter;
+  float *points, *ct, *dist, dmin;
+  unsigned long long state = 4711;
+  MPI_Datatype point;
+  MPI_File fh;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+  while ((opt=getopt(argc, argv, "hf:k:i:t:g:d:")) != EOF) {
+    switch (opt) {
+    case 'f':
+      filename = optarg;
+      break;
+    case 'k':
+      k = atoi(optarg);
+      break;
+    case 'i':
+      maxit = atoi(optarg);
+      break;
+    case 't':
+      tol = atof(optarg);
+      break;
+    case 'g':
+      ngen = atoll(optarg);
+      break;
+    case 'd':
+      d = atoi(optarg);
+      break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+
+  /* The file header stores the number of points as a 32-bit integer */
+  if (ngen > INT_MAX || d < 1) {
+    if (me == 0) printf("The number of points must be at most %d, and the dimension positive\n",
+			INT_MAX);
+    MPI_Finalize();
+    exit(1);
+  }
+  if (ngen > 0) generate_file(filename, ngen, d, k);
+
+  /* Read the header and this process' block of points */
+  if (MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_RDONLY, MPI_INFO_NULL,
+		    &fh) != MPI_SUCCESS) {
+    if (me == 0) printf("Could not open %s, use -g to create it\n", filename);
+    MPI_Finalize();
+    exit(1);
+  }
+  MPI_File_read_at_all(fh, 0, header, 2, MPI_INT, MPI_STATUS_IGNORE);
+  n = header[0];
+  d = header[1];
+  if (k < 1 || k > n) {
+    if (me == 0) printf("The number of clusters must be between 1 and %lld\n", n);
+    MPI_Finalize();
+    exit(1);
+  }
+  n0 = n*me/np;
+  n1 = n*(me+1)/np;
+  points = (float *) malloc(((n1-n0)*d+1)*sizeof(float));
+  t0 = MPI_Wtime();
+  MPI_Type_contiguous(d, MPI_FLOAT, &point);
+  MPI_Type_commit(&point);
+  MPI_File_read_at_all(fh, HEADER + (MPI_Offset)n0*d*sizeof(float), points,
+		       (int)(n1-n0), point, MPI_STATUS_IGNORE);
+  MPI_Type_free(&point);
+  t1 = MPI_Wtime()-t0;
+
+  /* The initial centroids are k random points, read by process 0 */
+  centroids = (double *) malloc(k*d*sizeof(double));
+  if (me == 0) {
+    float *p = (float *) malloc(d*sizeof(float));
+    for (c=0; c<k; c++) {
+      i = (long long)(next_random(&state)*n);
+      MPI_File_read_at(fh, HEADER + (MPI_Offset)i*d*sizeof(float), p, d,
+		       MPI_FLOAT, MPI_STATUS_IGNORE);
+      for (j=0; j<d; j++) centroids[c*d+j] = p[j];
+    }
+    free(p);
+  }
+  MPI_Bcast(centroids, k*d, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  MPI_File_close(&fh);
+
+  if (me == 0) {
+    printf("k-means with %d clusters of %lld points of dimension %d on %d processes\n",
+	   k, n, d, np);
+    printf("Reading the points took %f s (%.1f MB/s per process)\n", t1,
+	   (n1-n0)*d*sizeof(float)/t1*1e-6);
+    printf("Distance kernel: %s\n", VLEN == 8 ? "AVX" : VLEN == 4 ? "SSE" : "scalar");
+  }
+
+  /* The transposed centroids are padded to a multiple of the vector length */
+  kpad = (k+VLEN-1)/VLEN*VLEN;
+  ct = (float *) malloc(d*kpad*sizeof(float));
+  dist = (float *) malloc(kpad*sizeof(float));
+  sums = (double *) malloc((k*d+k+1)*sizeof(double));
+
+  for (it=0; it<maxit; it++) {
+    t0 = MPI_Wtime();
+    for (j=0; j<d; j++)
+      for (c=0; c<kpad; c++)
+	ct[j*kpad+c] = (c < k) ? (float)centroids[c*d+j] : 0.0f;
+
+    /* Assign the points and accumulate the partial sums. The last k+1
+       values are the cluster sizes and the sum of squared distances */
+    memset(sums, 0, (k*d+k+1)*sizeof(double));
+    for (i=0; i<n1-n0; i++) {
+      const float *x = &points[i*d];
+      c = nearest(x, ct, d, k, kpad, dist, &dmin);
+      for (j=0; j<d; j++) sums[c*d+j] += x[j];
+      sums[k*d+c] += 1.0;
+      sums[k*d+k] += dmin;
+    }
+    t1 = MPI_Wtime();
+    MPI_Allreduce(MPI_IN_PLACE, sums, k*d+k+1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    t2 = MPI_Wtime();
+    t_assign += t1-t0;
+    t_reduce += t2-t1;
+
+    /* New centroids. An empty cluster keeps its old centroid */
+    shift = 0.0;
+    for (c=0; c<k; c++) {
+      if (sums[k*d+c] == 0.0) continue;
+      for (j=0; j<d; j++) {
+	double v = sums[c*d+j]/sums[k*d+c];
+	shift = fmax(shift, fabs(v - centroids[c*d+j]));
+	centroids[c*d+j] = v;
+      }
+    }
+
+    /* The time of process 0. It includes waiting for the slowest process
+       in the MPI_Allreduce, so no other reduction is needed */
+    t_iter = t2-t0;
+    if (me == 0)
+      printf("Iteration %3d: SSE %e, max shift %e, %f s, %8.3e points/s\n",
+	     it, sums[k*d+k], shift, t_iter, (double)n/t_iter);
+    if (shift < tol) break;
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &t_assign, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &t_reduce, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  if (me == 0) {
+    if (it < maxit) it++;     /* Count the last iteration */
+    printf("\n%d iterations, %e points/s on average\n", it,
+	   (double)n*it/(t_assign+t_reduce));
+    printf("Assignment: %f s, reduction: %f s (%4.1f%%)\n", t_assign, t_reduce,
+	   100.0*t_reduce/(t_assign+t_reduce));
+    printf("Cluster sizes:");
+    for (c=0; c<k; c++) printf(" %.0f", sums[k*d+c]);
+    printf("\n");
+  }
+
+  free(points); free(centroids); free(ct); free(dist); free(sums);
+  MPI_Finalize();
+  exit(0);
+}
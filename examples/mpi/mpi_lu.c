@@ -0,0 +1,473 @@
+/*
+  MPI example program that solves a dense linear system Ax=b with a
+  right-looking blocked LU factorization with partial pivoting, in the
+  same way as the HPL (High Performance Linpack) benchmark.
+
+  The processes are arranged in a q*q grid with row and column
+  communicators built with MPI_Comm_split, as in mpi_rowcol.c. The
+  N*(N+1) matrix [A b] is distributed block-cyclically in blocks of
+  NB*NB elements: block (I,J) is stored in the process on grid row I%q
+  and grid column J%q. Each process stores its blocks column by column
+  in one local array. Since b is the last column of the matrix, the
+  factorization also does the forward substitution, and only an upper
+  triangular system remains to be solved at the end.
+
+  For each block column k (the panel) the algorithm does:
+
+    1. The processes in the grid column that owns the panel factorize it
+       column by column. The pivot row is found with MPI_Allreduce and
+       MPI_MAXLOC in the column communicator, and the pivot row and the
+       current row are exchanged with two broadcasts.
+    2. The factorized panel (the L part) and the pivot indices are
+       broadcast along the grid rows.
+    3. All processes apply the row interchanges to the rest of their
+       columns, using MPI_Sendrecv_replace in the column communicator
+       when the two rows are in different processes.
+    4. The grid row that owns the diagonal block computes the block row
+       of U with a triangular solve and broadcasts it along the grid
+       columns.
+    5. All processes update the trailing matrix, A22 = A22 - L21*U12.
+
+  With lookahead (the default), the grid column that owns the next
+  panel first updates only the columns of the next panel, factorizes
+  it, starts its broadcast with MPI_Ibcast, and then updates the rest
+  of its trailing matrix. The broadcast is completed at the start of
+  the next step, so the other grid columns can go on with the next
+  panel as soon as they have finished their own update, instead of
+  waiting for the whole update in the owner. The panel factorization,
+  which consists of many small messages, is then no longer on the
+  critical path. The two panels in flight have separate buffers.
+
+  The solution is checked with the scaled residual used by HPL,
+  ||Ax-b|| / (eps * (||A||*||x|| + ||b||) * N), which should be below 16.
+  The matrix is generated from the global indices, so the residual is
+  computed without keeping a copy of A.
+
+  You have to use a square number of processes, for instance 1, 4 or 9.
+
+  Compile the program with 'mpicc -O3 mpi_lu.c -o mpi_lu -lm'
+  Run the program with 'mpiexec -n 4 ./mpi_lu -n 2000 -b 64'
+  Use '-l 0' to turn off the lookahead.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <float.h>
+#include <math.h>
+#include <mpi.h>
+
+#define ROWCHUNK 256      /* Rows of L21 kept in cache in the update */
+
+int N,                    /* Size of the matrix */
+    NB,                   /* Block size */
+    q,                    /* The process grid is q*q */
+    myrow, mycol,         /* Position of this process in the grid */
+    mloc, nloc;           /* Local number of rows and columns */
+double *A;                /* Local blocks of [A b], column major */
+double *Lbuf, *Ubuf;      /* The current panel and block row of U */
+double *rowbuf;           /* Buffer for row interchanges */
+int *ipiv;                /* Pivot rows of the current panel */
+double *Lbufs[2];         /* Panel k is in Lbufs[k%2] and its pivots */
+int *ipivs[2];            /*   in ipivs[k%2] */
+MPI_Request panel_req[2]; /* Broadcast of the next panel */
+int singular = 0;         /* Set if a zero pivot was found */
+MPI_Comm row_comm, col_comm;
+
+/* Element (i,j) of the local array */
+#define AL(i,j) A[(size_t)(j)*mloc + (i)]
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <matrix size> -b <block size> -l <lookahead 0|1>\n", s);
+}
+
+/* Number of the first n rows (or columns) that are stored in grid row
+   (or column) p. This is also the local index of global row n */
+int numroc(int n, int p) {
+  int nblocks = n/NB, num = (nblocks/q)*NB, extra = nblocks%q;
+  if (p < extra) num += NB;
+  else if (p == extra) num += n%NB;
+  return num;
+}
+
+/* Global index of local row (or column) l in grid row (or column) p */
+int global_index(int l, int p) {
+  return ((l/NB)*q + p)*NB + l%NB;
+}
+
+/* Matrix element (i,j), a uniform random value computed from i and j.
+   Column N is the right hand side b */
+double matrix_value(int i, int j) {
+  unsigned int h = (unsigned int)i*2654435761u ^ ((unsigned int)j+0x9e3779b9u)*40503u;
+  h ^= h >> 15;  h *= 2246822519u;
+  h ^= h >> 13;  h *= 3266489917u;
+  h ^= h >> 16;
+  return (double)h/4294967296.0 - 0.5;
+}
+
+/* Factorize panel k. Only called in the grid column that owns it */
+void factor_panel(int k) {
+  const int j0 = k*NB, jb = (N-j0 < NB) ? N-j0 : NB;
+  const int lc0 = numroc(j0, mycol);        /* Local column of the panel */
+  double *rowj = rowbuf, *rowp = rowbuf+NB;
+  struct { double val; int row; } in, out;
+  int t, i, c, lr, lc, p, owner_j, owner_p;
+  double piv;
+
+  for (t=0; t<jb; t++) {
+    const int j = j0+t;
+    lc = lc0+t;
+    lr = numroc(j, myrow);     /* First local row at or below the diagonal */
+
+    /* Find the largest element in column j, in this process and then
+       in the whole grid column */
+    in.val = -1.0;  in.row = N;
+    for (i=lr; i<mloc; i++) {
+      if (fabs(AL(i,lc)) > in.val) {
+	in.val = fabs(AL(i,lc));
+	in.row = global_index(i, myrow);
+      }
+    }
+    MPI_Allreduce(&in, &out, 1, MPI_DOUBLE_INT, MPI_MAXLOC, col_comm);
+    p = out.row;
+    ipivs[k%2][t] = p;
+
+    /* Both rows j and p are needed by all processes in the grid column */
+    owner_j = (j/NB)%q;
+    owner_p = (p/NB)%q;
+    if (myrow == owner_j)
+      for (c=0; c<jb; c++) rowj[c] = AL(numroc(j, myrow), lc0+c);
+    if (myrow == owner_p)
+      for (c=0; c<jb; c++) rowp[c] = AL(numroc(p, myrow), lc0+c);
+    MPI_Bcast(rowp, jb, MPI_DOUBLE, owner_p, col_comm);
+    if (p != j) {
+      MPI_Bcast(rowj, jb, MPI_DOUBLE, owner_j, col_comm);
+      /* Interchange the rows within the panel */
+      if (myrow == owner_j)
+	for (c=0; c<jb; c++) AL(numroc(j, myrow), lc0+c) = rowp[c];
+      if (myrow == owner_p)
+	for (c=0; c<jb; c++) AL(numroc(p, myrow), lc0+c) = rowj[c];
+    }
+
+    piv = rowp[t];
+    if (piv == 0.0) {
+      singular = 1;
+      continue;
+    }
+
+    /* Compute the multipliers and update the rest of the panel */
+    if (myrow == owner_j) lr++;      /* Skip the pivot row itself */
+    for (i=lr; i<mloc; i++) {
+      const double l = (AL(i,lc) /= piv);
+      for (c=t+1; c<jb; c++)
+	AL(i,lc0+c) -= l*rowp[c];
+    }
+  }
+}
+
+/* Start the broadcast of panel k and its pivots along the grid rows,
+   completed by waiting for panel_req. The local rows from the diagonal
+   block down are copied into Lbufs[k%2], column major */
+void bcast_panel(int k) {
+  const int j0 = k*NB, jb = (N-j0 < NB) ? N-j0 : NB;
+  const int lr0 = numroc(j0, myrow), mr = mloc-lr0, owner = k%q;
+  double *L = Lbufs[k%2];
+  int i, c;
+
+  if (mycol == owner) {
+    const int lc0 = numroc(j0, mycol);
+    for (c=0; c<jb; c++)
+      for (i=0; i<mr; i++)
+	L[(size_t)c*mr+i] = AL(lr0+i, lc0+c);
+  }
+  MPI_Ibcast(ipivs[k%2], jb, MPI_INT, owner, row_comm, &panel_req[0]);
+  MPI_Ibcast(L, mr*jb, MPI_DOUBLE, owner, row_comm, &panel_req[1]);
+}
+
+/* Apply the row interchanges of panel k to local columns c0..nloc-1.
+   The columns left of the panel are not interchanged, since L is not
+   used after the factorization */
+void apply_swaps(int k, int c0) {
+  const int j0 = k*NB, jb = (N-j0 < NB) ? N-j0 : NB, nc = nloc-c0;
+  const int tag = 42;
+  int t, c, j, p, owner_j, owner_p, lj, lp, other;
+  double tmp;
+
+  if (nc <= 0) return;
+  for (t=0; t<jb; t++) {
+    j = j0+t;
+    p = ipiv[t];
+    if (p == j) continue;
+    owner_j = (j/NB)%q;
+    owner_p = (p/NB)%q;
+    if (owner_j == owner_p) {
+      if (myrow == owner_j) {      /* Both rows are local */
+	lj = numroc(j, myrow);
+	lp = numroc(p, myrow);
+	for (c=c0; c<nloc; c++) {
+	  tmp = AL(lj,c);  AL(lj,c) = AL(lp,c);  AL(lp,c) = tmp;
+	}
+      }
+    } else if (myrow == owner_j || myrow == owner_p) {
+      /* Exchange the row with the other process in the grid column */
+      lj = numroc((myrow == owner_j) ? j : p, myrow);
+      other = (myrow == owner_j) ? owner_p : owner_j;
+      for (c=c0; c<nloc; c++) rowbuf[c-c0] = AL(lj,c);
+      MPI_Sendrecv_replace(rowbuf, nc, MPI_DOUBLE, other, tag, other, tag,
+			   col_comm, MPI_STATUS_IGNORE);
+      for (c=c0; c<nloc; c++) AL(lj,c) = rowbuf[c-c0];
+    }
+  }
+}
+
+/* Compute the block row U12 = inv(L11)*A12 of panel k for local columns
+   c0..nloc-1 and broadcast it along the grid columns into Ubuf */
+void compute_u(int k, int c0) {
+  const int j0 = k*NB, jb = (N-j0 < NB) ? N-j0 : NB, nc = nloc-c0;
+  const int lr0 = numroc(j0, myrow), mr = mloc-lr0, owner = k%q;
+  int t, s, c;
+
+  if (nc <= 0) return;
+  if (myrow == owner) {
+    /* L11 is unit lower triangular and in the first jb rows of Lbuf */
+    for (c=c0; c<nloc; c++) {
+      for (t=1; t<jb; t++) {
+	double sum = AL(lr0+t,c);
+	for (s=0; s<t; s++) sum -= Lbuf[(size_t)s*mr+t]*AL(lr0+s,c);
+	AL(lr0+t,c) = sum;
+      }
+      for (t=0; t<jb; t++) Ubuf[(size_t)(c-c0)*jb+t] = AL(lr0+t,c);
+    }
+  }
+  MPI_Bcast(Ubuf, jb*nc, MPI_DOUBLE, owner, col_comm);
+}
+
+/* Trailing update A22 = A22 - L21*U12 for local columns c1..c2-1.
+   Ubuf starts at local column c0 */
+void update(int k, int c0, int c1, int c2) {
+  const int j0 = k*NB, jb = (N-j0 < NB) ? N-j0 : NB;
+  const int lr0 = numroc(j0, myrow), mr = mloc-lr0;
+  const int r0 = numroc(j0+jb, myrow);   /* First row below the panel */
+  int i, i0, i1, t, c, done;
+
+  /* Process the rows in chunks so that the part of L21 that is used
+     stays in cache while it is applied to all columns. Between the
+     chunks the broadcast of the next panel is given a chance to
+     progress, if one has been started */
+  for (i0=r0; i0<mloc; i0+=ROWCHUNK) {
+    MPI_Testall(2, panel_req, &done, MPI_STATUSES_IGNORE);
+    i1 = (i0+ROWCHUNK < mloc) ? i0+ROWCHUNK : mloc;
+    for (c=c1; c<c2; c++) {
+      double *a = &AL(0,c);
+      for (t=0; t<jb; t++) {
+	const double u = Ubuf[(size_t)(c-c0)*jb+t];
+	const double *l = &Lbuf[(size_t)t*mr];
+	for (i=i0; i<i1; i++) a[i] -= l[i-lr0]*u;
+      }
+    }
+  }
+}
+
+/* Solve the remaining upper triangular system. The solution x is
+   replicated in all processes */
+void back_solve(double *x) {
+  const int nblocks = (N+NB-1)/NB;
+  double *y = rowbuf, *ysum = rowbuf+NB;
+  int K, kb, t, s, c, gc, lr, lc, owner;
+
+  for (K=nblocks-1; K>=0; K--) {
+    kb = (N-K*NB < NB) ? N-K*NB : NB;
+    owner = K%q;
+    if (myrow == owner) {
+      /* y = b - U(K,K+1:)*x(K+1:), summed over the grid row */
+      lr = numroc(K*NB, myrow);
+      for (t=0; t<kb; t++) {
+	y[t] = 0.0;
+	for (c=0; c<nloc; c++) {
+	  gc = global_index(c, mycol);
+	  if (gc == N) y[t] += AL(lr+t,c);
+	  else if (gc >= (K+1)*NB && gc < N) y[t] -= AL(lr+t,c)*x[gc];
+	}
+      }
+      MPI_Reduce(y, ysum, kb, MPI_DOUBLE, MPI_SUM, owner, row_comm);
+      /* The owner of the diagonal block solves U(K,K)*x(K) = y */
+      if (mycol == owner) {
+	lc = numroc(K*NB, mycol);
+	for (t=kb-1; t>=0; t--) {
+	  double sum = ysum[t];
+	  for (s=t+1; s<kb; s++) sum -= AL(lr+t,lc+s)*x[K*NB+s];
+	  x[K*NB+t] = sum/AL(lr+t,lc+t);
+	}
+      }
+    }
+    MPI_Bcast(&x[K*NB], kb, MPI_DOUBLE, owner*q+owner, MPI_COMM_WORLD);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int id, ntasks, lookahead=1, k, npanels, started, c0, c1, i, c, gi, gc, opt;
+  double *x, *r, *rowsum, t0, t1, t2, tloc[2], tmax[2];
+  double resid, normA, normx, normb, scaled, flops;
+
+  MPI_Init(&argc, &argv);                   /* Initialize MPI */
+  MPI_Comm_size(MPI_COMM_WORLD, &ntasks);   /* Get nr of tasks */
+  MPI_Comm_rank(MPI_COMM_WORLD, &id);       /* Get id of this process */
+
+  N = 1000;
+  NB = 64;
+  while ((opt=getopt(argc, argv, "hn:b:l:")) != EOF) {
+    switch (opt) {
+    case 'n':
+      N = atoi(optarg);
+      break;
+    case 'b':
+      NB = atoi(optarg);
+      break;
+    case 'l':
+      lookahead = atoi(optarg);
+      break;
+    default:
+      if (id == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+
+  /* The process grid will be of size q*q */
+  q = (int) sqrt((double) ntasks);
+
+  /* Check the sizes of the matrix and the blocks */
+  if (N < 1 || NB < 1) {
+    if (id == 0) {
+      printf("The matrix size and the block size must be positive\n");
+      printf("Quitting\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+
+  /* Check that we have a square number of processes */
+  if (q*q != ntasks) {
+    if (id == 0) {
+      printf("You have to use a square number of processes\n");
+      printf("Quitting\n");
+    }
+    MPI_Finalize();
+    exit(1);
+  }
+
+  /* Calculate on which row and column this process is */
+  myrow = id/q;
+  mycol = id%q;
+
+  /* Build communicators for the processes in the same row and column */
+  MPI_Comm_split(MPI_COMM_WORLD, myrow, id, &row_comm);
+  MPI_Comm_split(MPI_COMM_WORLD, mycol, id, &col_comm);
+
+  /* Allocate and generate the local part of [A b] */
+  mloc = numroc(N, myrow);
+  nloc = numroc(N+1, mycol);
+  A = (double *) malloc(((size_t)mloc*nloc+1)*sizeof(double));
+  Lbufs[0] = (double *) malloc(((size_t)mloc*NB+1)*sizeof(double));
+  Lbufs[1] = (double *) malloc(((size_t)mloc*NB+1)*sizeof(double));
+  Ubuf = (double *) malloc(((size_t)nloc*NB+1)*sizeof(double));
+  rowbuf = (double *) malloc((nloc+2*NB)*sizeof(double));
+  ipivs[0] = (int *) malloc(NB*sizeof(int));
+  ipivs[1] = (int *) malloc(NB*sizeof(int));
+  panel_req[0] = panel_req[1] = MPI_REQUEST_NULL;
+  for (c=0; c<nloc; c++)
+    for (i=0; i<mloc; i++)
+      AL(i,c) = matrix_value(global_index(i, myrow), global_index(c, mycol));
+
+  if (id == 0) {
+    printf("LU factorization of a %d*%d matrix on a %d*%d process grid\n",
+	   N, N, q, q);
+    printf("Block size %d, lookahead %s\n", NB, lookahead ? "on" : "off");
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t0 = MPI_Wtime();
+
+  npanels = (N+NB-1)/NB;
+  if (mycol == 0) factor_panel(0);
+  started = -1;
+  for (k=0; k<npanels; k++) {
+    const int j1 = (k+1)*NB < N ? (k+1)*NB : N;   /* End of the panel */
+    /* The owner of the panel may have started its broadcast already */
+    if (started != k) bcast_panel(k);
+    MPI_Waitall(2, panel_req, MPI_STATUSES_IGNORE);
+    Lbuf = Lbufs[k%2];
+    ipiv = ipivs[k%2];
+    c0 = numroc(j1, mycol);       /* First local column right of the panel */
+    apply_swaps(k, c0);
+    compute_u(k, c0);
+    if (k+1 < npanels && lookahead && mycol == (k+1)%q) {
+      /* Update and factorize the next panel first */
+      c1 = numroc((j1+NB < N) ? j1+NB : N, mycol);
+      update(k, c0, c0, c1);
+      factor_panel(k+1);
+      bcast_panel(k+1);
+      started = k+1;
+      update(k, c0, c1, nloc);
+    } else {
+      update(k, c0, c0, nloc);
+      if (k+1 < npanels && mycol == (k+1)%q) factor_panel(k+1);
+    }
+  }
+
+  t1 = MPI_Wtime();
+  x = (double *) calloc(N, sizeof(double));
+  back_solve(x);
+  t2 = MPI_Wtime();
+
+  /* Compute the residual Ax-b and the norms from the generated matrix */
+  r = (double *) calloc(N, sizeof(double));
+  rowsum = (double *) calloc(N, sizeof(double));
+  for (i=0; i<mloc; i++) {
+    gi = global_index(i, myrow);
+    for (c=0; c<nloc; c++) {
+      gc = global_index(c, mycol);
+      if (gc < N) {
+	r[gi] += matrix_value(gi, gc)*x[gc];
+	rowsum[gi] += fabs(matrix_value(gi, gc));
+      } else {
+	r[gi] -= matrix_value(gi, gc);
+      }
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, r, N, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, rowsum, N, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &singular, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+  tloc[0] = t1-t0;  tloc[1] = t2-t0;
+  MPI_Reduce(tloc, tmax, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  if (id == 0) {
+    resid = normA = normx = normb = 0.0;
+    for (i=0; i<N; i++) {
+      resid = fmax(resid, fabs(r[i]));
+      normA = fmax(normA, rowsum[i]);
+      normx = fmax(normx, fabs(x[i]));
+      normb = fmax(normb, fabs(matrix_value(i, N)));
+    }
+    scaled = resid/(DBL_EPSILON*(normA*normx + normb)*N);
+    flops = 2.0/3.0*N*(double)N*N + 1.5*N*(double)N;
+
+    printf("Factorization time: %f s\n", tmax[0]);
+    printf("Total time:         %f s\n", tmax[1]);
+    printf("Performance:        %f GFLOP/s\n", flops/tmax[1]*1e-9);
+    printf("||Ax-b||_oo = %e\n", resid);
+    printf("||Ax-b||_oo / (eps * (||A||_oo * ||x||_oo + ||b||_oo) * N) = %f ... %s\n",
+	   scaled, (scaled < 16.0 && !singular) ? "PASSED" : "FAILED");
+    if (singular) printf("The matrix is singular\n");
+  }
+
+  free(A); free(Lbufs[0]); free(Lbufs[1]); free(Ubuf); free(rowbuf);
+  free(ipivs[0]); free(ipivs[1]);
+  free(x); free(r); free(rowsum);
+  MPI_Comm_free(&row_comm);
+  MPI_Comm_free(&col_comm);
+
+  MPI_Finalize();	         /* Terminate MPI */
+  exit(0);
+}
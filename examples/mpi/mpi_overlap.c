@@ -0,0 +1,177 @@
+/*
+  MPI example program that measures how much computation and
+  communication overlap with non-blocking operations.
+
+  The processes are paired, and each pair exchanges a message of S
+  bytes with MPI_Isend and MPI_Irecv. While the messages are in
+  transfer, both processes compute for about as long as the exchange
+  takes on its own. This is done in three ways:
+
+    none     compute, then MPI_Waitall. Large messages often do not
+             move until MPI_Waitall is called.
+    test     the computation is split into pieces, and MPI_Testall is
+             called between them to let MPI make progress.
+    thread   the requests are handed to the progress engine in
+             mpi_progress.c, which tests them in a separate thread.
+             A callback counts the completed messages.
+
+  The overlap is the part of the shorter of the two activities that was
+  hidden, 100% meaning the total time was the time of the longer one,
+  and 0% that it was the sum of both.
+
+  Compile the program with 'mpicc -O3 mpi_overlap.c mpi_progress.c -o mpi_overlap -lpthread'
+  Run the program with 'mpiexec -n 2 ./mpi_overlap'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "mpi_progress.h"
+
+#define PIECES 100       /* Pieces of computation in the test mode */
+
+int me, np, partner;
+int repeat = 10;         /* Repetitions of each measurement */
+double work[64];
+double rate;             /* Compute iterations per second */
+volatile int received;   /* Messages counted by the callback */
+
+void print_usage(char *s) {
+  printf("Usage: %s -s <max message size> -r <repetitions>\n", s);
+}
+
+/* Some floating point work on data that stays in the cache */
+void compute(long n) {
+  long i;
+  int j;
+  for (i=0; i<n; i++)
+    for (j=0; j<64; j++) work[j] = work[j]*0.999999 + 0.000001;
+}
+
+/* Called by the progress engine when a message has arrived */
+void count_message(MPI_Status *status, void *arg) {
+  __sync_fetch_and_add(&received, 1);
+}
+
+/* Time one exchange with mode 0 (none), 1 (test) or 2 (thread) and
+   n iterations of computation. Returns the slowest process' time */
+double run(char *sendbuf, char *recvbuf, int size, long n, int mode) {
+  MPI_Request req[2];
+  double t, tmax;
+  int i, k, flag;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  for (k=0; k<repeat; k++) {
+    MPI_Irecv(recvbuf, size, MPI_BYTE, partner, 0, MPI_COMM_WORLD, &req[0]);
+    MPI_Isend(sendbuf, size, MPI_BYTE, partner, 0, MPI_COMM_WORLD, &req[1]);
+    if (mode == 0) {
+      compute(n);
+      MPI_Waitall(2, req, MPI_STATUSES_IGNORE);
+    }
+    else if (mode == 1) {
+      flag = 0;
+      for (i=0; i<PIECES; i++) {
+	compute(n/PIECES);
+	if (!flag) MPI_Testall(2, req, &flag, MPI_STATUSES_IGNORE);
+      }
+      if (!flag) MPI_Waitall(2, req, MPI_STATUSES_IGNORE);
+    }
+    else {
+      progress_add(req[0], count_message, NULL);
+      progress_add(req[1], NULL, NULL);
+      compute(n);
+      progress_wait_all();
+    }
+  }
+  t = (MPI_Wtime() - t)/repeat;
+  MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return tmax;
+}
+
+/* Overlap in percent from the times of communication, computation and
+   both together */
+double overlap(double tcomm, double tcomp, double total) {
+  double shorter = tcomm < tcomp ? tcomm : tcomp;
+  double o = 100.0*(tcomm + tcomp - total)/shorter;
+  return o < 0.0 ? 0.0 : o;
+}
+
+int main(int argc, char* argv[]) {
+  int c, size, maxsize = 16*1024*1024, provided, mode;
+  char *sendbuf, *recvbuf;
+  double t, tcomm, tcomp, total[3];
+  long n;
+
+  provided = progress_init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  while ((c = getopt(argc, argv, "s:r:h")) != -1) {
+    switch (c) {
+    case 's': maxsize = atoi(optarg); break;
+    case 'r': repeat = atoi(optarg); break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      progress_finalize();
+      exit(0);
+    }
+  }
+  if (np%2 != 0 || maxsize < 1 || repeat < 1) {
+    if (me == 0) {
+      if (np%2 != 0) printf("You have to use an even number of processes\n");
+      else print_usage(argv[0]);
+    }
+    progress_finalize();
+    exit(0);
+  }
+  partner = me^1;
+
+  sendbuf = (char *) calloc(maxsize, 1);
+  recvbuf = (char *) malloc(maxsize);
+
+  /* Calibrate the computation, all processes use the same rate */
+  n = 1000;
+  do {
+    n *= 2;
+    t = MPI_Wtime();
+    compute(n);
+    t = MPI_Wtime() - t;
+  } while (t < 0.1);
+  rate = n/t;
+  MPI_Bcast(&rate, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  if (me == 0) {
+    if (provided != MPI_THREAD_MULTIPLE)
+      printf("MPI_THREAD_MULTIPLE not supported, no progress thread\n");
+    printf("%10s %10s %10s   %-16s %-16s %-16s\n", "bytes", "comm (us)",
+	   "comp (us)", "none", "test", "thread");
+  }
+
+  for (size=1024; size<=maxsize; size*=4) {
+    tcomm = run(sendbuf, recvbuf, size, 0, 0);
+    n = (long)(tcomm*rate) + 1;
+    tcomp = n/rate;
+    received = 0;
+    for (mode=0; mode<3; mode++)
+      total[mode] = run(sendbuf, recvbuf, size, n, mode);
+    if (received != repeat) {
+      printf("Process %d: the callback counted %d messages, expected %d\n",
+	     me, received, repeat);
+    }
+    if (me == 0) {
+      printf("%10d %10.1f %10.1f", size, tcomm*1e6, tcomp*1e6);
+      for (mode=0; mode<3; mode++)
+	printf("   %8.1f (%3.0f%%)", total[mode]*1e6,
+	       overlap(tcomm, tcomp, total[mode]));
+      printf("\n");
+    }
+    if (size > maxsize/4) break;        /* size*4 could overflow */
+  }
+
+  free(sendbuf);
+  free(recvbuf);
+  progress_finalize();
+  exit(0);
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "mpi_progress.h"
+
+#define MAXREQ 1024      /* Maximum number of outstanding requests */
+
+/* Requests that are being tested, only used by the thread that polls */
+static MPI_Request active[MAXREQ];
+static progress_callback active_cb[MAXREQ];
+static void *active_arg[MAXREQ];
+static int nactive = 0;
+
+/* Requests that have been added but not yet moved to active */
+static MPI_Request incoming[MAXREQ];
+static progress_callback incoming_cb[MAXREQ];
+static void *incoming_arg[MAXREQ];
+static int nincoming = 0;
+
+static int outstanding = 0;     /* Requests that have not completed */
+static int threaded = 0;        /* Is there a progress thread */
+static int stop = 0;            /* Signal to the progress thread */
+
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER;   /* New requests or stop */
+static pthread_cond_t done = PTHREAD_COND_INITIALIZER;   /* Requests completed */
+
+/* Move new requests to the active set and test them all once */
+static void poll_once(void) {
+  int indices[MAXREQ], i, j, completed;
+  MPI_Status status[MAXREQ];
+
+  pthread_mutex_lock(&lock);
+  for (i=0; i<nincoming; i++) {
+    active[nactive] = incoming[i];
+    active_cb[nactive] = incoming_cb[i];
+    active_arg[nactive] = incoming_arg[i];
+    nactive++;
+  }
+  nincoming = 0;
+  pthread_mutex_unlock(&lock);
+
+  if (nactive == 0) return;
+  MPI_Testsome(nactive, active, &completed, indices, status);
+  if (completed == MPI_UNDEFINED || completed == 0) return;
+
+  for (i=0; i<completed; i++)
+    if (active_cb[indices[i]] != NULL)
+      active_cb[indices[i]](&status[i], active_arg[indices[i]]);
+
+  /* Completed requests have been set to MPI_REQUEST_NULL */
+  j = 0;
+  for (i=0; i<nactive; i++) {
+    if (active[i] != MPI_REQUEST_NULL) {
+      active[j] = active[i];
+      active_cb[j] = active_cb[i];
+      active_arg[j] = active_arg[i];
+      j++;
+    }
+  }
+  nactive = j;
+
+  pthread_mutex_lock(&lock);
+  outstanding -= completed;
+  pthread_cond_broadcast(&done);
+  pthread_mutex_unlock(&lock);
+}
+
+/* The progress thread sleeps when there is nothing to do */
+static void *progress_thread(void *arg) {
+  while (1) {
+    pthread_mutex_lock(&lock);
+    while (!stop && nactive == 0 && nincoming == 0)
+      pthread_cond_wait(&work, &lock);
+    if (stop && nactive == 0 && nincoming == 0) {
+      pthread_mutex_unlock(&lock);
+      break;
+    }
+    pthread_mutex_unlock(&lock);
+    poll_once();
+  }
+  return NULL;
+}
+
+int progress_init(int *argc, char ***argv) {
+  int provided;
+
+  MPI_Init_thread(argc, argv, MPI_THREAD_MULTIPLE, &provided);
+  if (provided == MPI_THREAD_MULTIPLE) {
+    threaded = 1;
+    stop = 0;
+    if (pthread_create(&thread, NULL, progress_thread, NULL) != 0) {
+      fprintf(stderr, "Could not create progress thread\n");
+      threaded = 0;
+    }
+  }
+  return provided;
+}
+
+void progress_finalize(void) {
+  if (threaded) {
+    pthread_mutex_lock(&lock);
+    stop = 1;
+    pthread_cond_signal(&work);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    threaded = 0;
+  }
+  MPI_Finalize();
+}
+
+void progress_add(MPI_Request req, progress_callback cb, void *arg) {
+  pthread_mutex_lock(&lock);
+  if (outstanding >= MAXREQ) {
+    fprintf(stderr, "Too many outstanding requests in the progress engine\n");
+    MPI_Abort(MPI_COMM_WORLD, 1);
+  }
+  incoming[nincoming] = req;
+  incoming_cb[nincoming] = cb;
+  incoming_arg[nincoming] = arg;
+  nincoming++;
+  outstanding++;
+  pthread_cond_signal(&work);
+  pthread_mutex_unlock(&lock);
+}
+
+void progress_poll(void) {
+  if (!threaded) poll_once();
+}
+
+int progress_pending(void) {
+  int n;
+  pthread_mutex_lock(&lock);
+  n = outstanding;
+  pthread_mutex_unlock(&lock);
+  return n;
+}
+
+void progress_wait_all(void) {
+  if (threaded) {
+    pthread_mutex_lock(&lock);
+    while (outstanding > 0)
+      pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+  }
+  else {
+    while (outstanding > 0) poll_once();
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef MPI_PROGRESS_H
+#define MPI_PROGRESS_H
+
+/*
+  Progress engine for MPI non-blocking operations.
+
+  Most MPI libraries only move a message forward while the program is
+  inside an MPI call. A large message sent with MPI_Isend uses a
+  rendezvous protocol, and the data is not transferred until the
+  sender and receiver call MPI_Wait, even if they did computations in
+  between. The progress engine runs a separate thread that calls
+  MPI_Testsome on all requests handed to it, so that they complete
+  while the main thread computes.
+
+  MPI is initialized with MPI_THREAD_MULTIPLE. If the library does not
+  provide it, no thread is started and the requests only make progress
+  in progress_poll and progress_wait_all.
+
+  The progress thread polls continuously while it has requests, so it
+  should have a core of its own. Callbacks are called in the progress
+  thread and should be short. They may call MPI and progress_add.
+
+  See mpi_overlap.c for an example.
+*/
+
+#include <mpi.h>
+
+typedef void (*progress_callback)(MPI_Status *status, void *arg);
+
+/* Initialize MPI and start the progress thread. Returns the thread
+   support level provided by MPI */
+int progress_init(int *argc, char ***argv);
+
+/* Stop the progress thread and finalize MPI. All requests must have
+   completed */
+void progress_finalize(void);
+
+/* Hand a non-blocking request over to the progress engine. The
+   callback, if not NULL, is called with arg when the request has
+   completed. The request must not be used by the caller afterwards */
+void progress_add(MPI_Request req, progress_callback cb, void *arg);
+
+/* Test the requests once in the calling thread. Only needed when there
+   is no progress thread */
+void progress_poll(void);
+
+/* Number of requests that have not completed yet */
+int progress_pending(void);
+
+/* Wait until all requests have completed */
+void progress_wait_all(void);
+
+#endif
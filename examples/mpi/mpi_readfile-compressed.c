@@ -0,0 +1,181 @@
+/*
+MPI-IO program that reads and decompresses a file written by
+mpi_writefile-compressed.c.
+
+The trailer at the end of the file gives the position of the block
+index, which all processes read. The blocks are then divided between
+the processes, which need not be as many as when the file was written.
+Each process reads the compressed data of its blocks with one
+MPI_File_read_at_all, in pieces if it is more than an int can count,
+decompresses them and compares the checksums with the ones in the
+index. The file layout is described in mpi_compressfile.h.
+
+Because every block is compressed on its own, a part of the data can be
+read without reading the rest. With -b k only block k is read and
+decompressed, by process 0.
+
+Compile the program with 'mpicc -O2 mpi_readfile-compressed.c mpi_compressfile.c mpi_compress.c -o mpi_readfile-compressed -lm'
+Run the program with 'mpiexec -n 3 ./mpi_readfile-compressed'
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "mpi.h"
+#include "mpi_compressfile.h"
+
+#define FILENAME "file2.dat"
+
+int np, me;
+
+void print_usage(char *s) {
+  printf("Usage: %s -f <file> -b <block to read>\n", s);
+}
+
+/* Decompress one block. Returns 1 if the checksum is correct */
+int decompress_block(long long *entry, unsigned char *in, unsigned char *out,
+		     unsigned char *tmp) {
+  int m, rsize = (int) entry[3];
+
+  if (entry[4] == CODEC_NONE) {
+    memcpy(out, in, rsize);
+    m = rsize;
+  }
+  else if (entry[4] == CODEC_LZ)
+    m = lz_decompress(in, (int) entry[1], out, rsize);
+  else
+    m = shuffle_decompress(in, (int) entry[1], sizeof(double), out, rsize, tmp);
+  return m == rsize && block_checksum(out, rsize) == entry[5];
+}
+
+int main(int argc, char* argv[]) {
+  char *filename = FILENAME, magic[9];
+  int c, i, b0, b1, block = -1, errors = 0, nread, blocksize;
+  long long trailer[4], *index, start, len, bytes = 0, header[2];
+  unsigned char *in, *out, *tmp;
+  MPI_Offset filesize;
+  MPI_File myfile;
+  double t, tread, tdecomp;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+  while ((c = getopt(argc, argv, "f:b:h")) != -1) {
+    switch (c) {
+    case 'f': filename = optarg; break;
+    case 'b': block = atoi(optarg); break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+
+  if (MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_RDONLY, MPI_INFO_NULL,
+		    &myfile) != MPI_SUCCESS) {
+    if (me == 0) printf("Could not open %s\n", filename);
+    MPI_Finalize();
+    exit(0);
+  }
+
+  /* Process 0 checks the header and trailer */
+  if (me == 0) {
+    MPI_File_get_size(myfile, &filesize);
+    MPI_File_read_at(myfile, 0, magic, 8, MPI_CHAR, MPI_STATUS_IGNORE);
+    MPI_File_read_at(myfile, 8, &header[1], 1, MPI_LONG_LONG, MPI_STATUS_IGNORE);
+    MPI_File_read_at(myfile, filesize - 4*sizeof(long long), trailer, 4,
+		     MPI_LONG_LONG, MPI_STATUS_IGNORE);
+    magic[8] = 0;
+    header[0] = strcmp(magic, MAGIC) == 0 && trailer[3] == TRAILER_MAGIC;
+  }
+  MPI_Bcast(header, 2, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+  MPI_Bcast(trailer, 4, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+  if (!header[0]) {
+    if (me == 0) printf("%s is not a compressed file\n", filename);
+    MPI_File_close(&myfile);
+    MPI_Finalize();
+    exit(0);
+  }
+  blocksize = (int) header[1];
+
+  /* All processes read the index */
+  index = (long long *) malloc((ENTRY*trailer[1] + 1)*sizeof(long long));
+  file_read_at_all(myfile, trailer[0], index,
+		   ENTRY*trailer[1]*(long long)sizeof(long long), MPI_COMM_WORLD);
+  tmp = (unsigned char *) malloc(blocksize);
+
+  if (block >= 0) {
+    /* Random access to one block */
+    if (me == 0) {
+      if (block >= trailer[1]) {
+	printf("The file has only %lld blocks\n", trailer[1]);
+      }
+      else {
+	in = (unsigned char *) malloc(index[ENTRY*block+1] + 1);
+	out = (unsigned char *) malloc(index[ENTRY*block+3] + 1);
+	MPI_File_read_at(myfile, index[ENTRY*block], in, (int) index[ENTRY*block+1],
+			 MPI_BYTE, MPI_STATUS_IGNORE);
+	printf("Block %d: %lld bytes at offset %lld, uncompressed %lld bytes at %lld, ",
+	       block, index[ENTRY*block+1], index[ENTRY*block],
+	       index[ENTRY*block+3], index[ENTRY*block+2]);
+	printf("checksum %s\n", decompress_block(&index[ENTRY*block], in, out, tmp) ?
+	       "correct" : "WRONG");
+	printf("First values: %f %f %f\n", ((double *)out)[0], ((double *)out)[1],
+	       ((double *)out)[2]);
+	free(in);
+	free(out);
+      }
+    }
+    MPI_File_close(&myfile);
+    free(index);
+    free(tmp);
+    MPI_Finalize();
+    exit(0);
+  }
+
+  /* Blocks b0..b1-1 are consecutive in the file */
+  b0 = (int) (trailer[1]*me/np);
+  b1 = (int) (trailer[1]*(me+1)/np);
+  start = b1 > b0 ? index[ENTRY*b0] : 0;
+  len = b1 > b0 ? index[ENTRY*(b1-1)] + index[ENTRY*(b1-1)+1] - start : 0;
+  in = (unsigned char *) malloc(len + 1);
+  out = (unsigned char *) malloc(blocksize);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  file_read_at_all(myfile, start, in, len, MPI_COMM_WORLD);
+  tread = MPI_Wtime() - t;
+
+  t = MPI_Wtime();
+  for (i=b0; i<b1; i++) {
+    if (!decompress_block(&index[ENTRY*i], &in[index[ENTRY*i] - start], out, tmp)) {
+      printf("Process %d: block %d is corrupt\n", me, i);
+      errors++;
+    }
+    bytes += index[ENTRY*i+3];
+  }
+  tdecomp = MPI_Wtime() - t;
+  MPI_File_close(&myfile);
+
+  nread = b1 - b0;
+  MPI_Allreduce(MPI_IN_PLACE, &errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &bytes, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &nread, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &tread, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &tdecomp, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  if (me == 0) {
+    printf("%d processes read %d blocks, %lld bytes uncompressed, %d errors\n",
+	   np, nread, bytes, errors);
+    printf("Reading %.3f s, decompression %.3f s (%.1f MB/s)\n", tread, tdecomp,
+	   bytes/tdecomp/1e6);
+  }
+
+  free(index);
+  free(in);
+  free(out);
+  free(tmp);
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,199 @@
+/*
+  MPI example program that shows how the order of the ranks affects the
+  amount of data sent between nodes in a program where each process
+  only talks to its neighbours.
+
+  The processes form a PX x PY grid, as in a 2D stencil code, and each
+  process exchanges the edges of its NX x NY local domain with its four
+  neighbours. The east and west messages contain NY doubles and the
+  north and south messages NX doubles, so a long and narrow local domain
+  gives very different weights to the edges of the communication graph.
+
+  Programs like mpi_wave.c assume that process id and id+1 are close to
+  each other, which depends on how mpiexec placed the processes. The
+  mapping layer in mpi_topo.c creates a new communicator in which the
+  ranks have been reordered from the communication graph, and the
+  program is then run with the rank in the new communicator. Four
+  mappings are compared:
+
+    world   the ranks in MPI_COMM_WORLD
+    cart    MPI_Cart_create with reorder=1
+    graph   MPI_Dist_graph_create_adjacent with reorder=1 and the
+            message sizes as edge weights
+    greedy  the heuristic in mpi_topo.c that fills one node at a time
+            with the processes that talk most to each other
+
+  For each mapping the number of bytes per iteration sent between nodes
+  and the time for the halo exchange is printed. Many MPI libraries
+  ignore the reorder flag, in which case cart and graph are the same as
+  world. On a single machine the nodes can be simulated with -p, and
+  with -c the simulated nodes are filled round-robin, like
+  'mpiexec --map-by node' does.
+
+  Compile the program with 'mpicc -O3 mpi_reorder.c mpi_topo.c -o mpi_reorder'
+  Run the program with 'mpiexec -n 16 ./mpi_reorder -p 4 -c'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "mpi_topo.h"
+
+int me, np;
+int px, py;          /* Size of the process grid */
+int nx = 1024;       /* Size of the local domain */
+int ny = 1024;
+
+void print_usage(char *s) {
+  printf("Usage: %s -x <local width> -y <local height> -i <iterations>\n", s);
+  printf("          -p <simulated processes per node> -c (round-robin nodes)\n");
+}
+
+/* The neighbours of a process in the grid and the number of bytes
+   sent to each of them. Returns the number of neighbours */
+int grid_neighbours(int rank, int *nb, int *bytes) {
+  int row = rank/px, col = rank%px, n = 0;
+
+  if (col > 0)    { nb[n] = rank-1;  bytes[n++] = ny*sizeof(double); }
+  if (col < px-1) { nb[n] = rank+1;  bytes[n++] = ny*sizeof(double); }
+  if (row > 0)    { nb[n] = rank-px; bytes[n++] = nx*sizeof(double); }
+  if (row < py-1) { nb[n] = rank+px; bytes[n++] = nx*sizeof(double); }
+  return n;
+}
+
+/* One halo exchange with all neighbours */
+void halo(MPI_Comm comm, int n, int *nb, int *bytes, char *sendbuf,
+	  char *recvbuf, int maxbytes) {
+  MPI_Request req[8];
+  int i;
+
+  for (i=0; i<n; i++)
+    MPI_Irecv(&recvbuf[i*maxbytes], bytes[i], MPI_BYTE, nb[i], 0, comm, &req[i]);
+  for (i=0; i<n; i++)
+    MPI_Isend(sendbuf, bytes[i], MPI_BYTE, nb[i], 0, comm, &req[n+i]);
+  MPI_Waitall(2*n, req, MPI_STATUSES_IGNORE);
+}
+
+/* Time iter halo exchanges with all neighbours. The first exchange is
+   not timed, so that the time to set up the connections between the
+   processes is not charged to whichever communicator comes first */
+double exchange(MPI_Comm comm, int n, int *nb, int *bytes, int iter) {
+  char *sendbuf, *recvbuf;
+  int i, j, maxbytes = 1;
+  double t;
+
+  for (i=0; i<n; i++) if (bytes[i] > maxbytes) maxbytes = bytes[i];
+  sendbuf = (char *) calloc(maxbytes, 1);
+  recvbuf = (char *) malloc(n*maxbytes+1);
+
+  halo(comm, n, nb, bytes, sendbuf, recvbuf, maxbytes);
+  MPI_Barrier(comm);
+  t = MPI_Wtime();
+  for (j=0; j<iter; j++)
+    halo(comm, n, nb, bytes, sendbuf, recvbuf, maxbytes);
+  t = MPI_Wtime() - t;
+
+  free(sendbuf);
+  free(recvbuf);
+  return t/iter;
+}
+
+/* Report the inter-node traffic and exchange time with one mapping */
+void report(char *name, MPI_Comm comm, int *node, int use_graph, int iter) {
+  int rank, i, n, nin, nout, weighted, *node_new;
+  int nb[4], bytes[4], innb[4], inbytes[4];
+  double internode, total, t, tmax;
+
+  MPI_Comm_rank(comm, &rank);
+  if (use_graph) {
+    /* Neighbours as given by the graph communicator */
+    MPI_Dist_graph_neighbors_count(comm, &nin, &nout, &weighted);
+    MPI_Dist_graph_neighbors(comm, nin, innb, inbytes, nout, nb, bytes);
+    n = nout;
+  }
+  else {
+    n = grid_neighbours(rank, nb, bytes);
+  }
+
+  node_new = (int *) malloc(np*sizeof(int));
+  topo_rank_nodes(MPI_COMM_WORLD, comm, node, node_new);
+  internode = topo_internode_bytes(comm, n, nb, bytes, node_new);
+  total = 0.0;
+  for (i=0; i<n; i++) total += bytes[i];
+  MPI_Allreduce(MPI_IN_PLACE, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+  t = exchange(comm, n, nb, bytes, iter);
+  MPI_Reduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+  if (rank == 0) {
+    printf("%-8s %14.0f %8.1f%% %14.1f\n", name, internode,
+	   100.0*internode/total, tmax*1e6);
+  }
+  free(node_new);
+}
+
+int main(int argc, char* argv[]) {
+  int c, i, n, ppn = 0, cyclic = 0, iter = 100, nnodes;
+  int dims[2] = {0, 0}, periods[2] = {0, 0}, nb[4], bytes[4];
+  int *node;
+  MPI_Comm comm;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  while ((c = getopt(argc, argv, "x:y:i:p:ch")) != -1) {
+    switch (c) {
+    case 'x': nx = atoi(optarg); break;
+    case 'y': ny = atoi(optarg); break;
+    case 'i': iter = atoi(optarg); break;
+    case 'p': ppn = atoi(optarg); break;
+    case 'c': cyclic = 1; break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+  if (nx < 1 || ny < 1 || iter < 1 || ppn < 0) {
+    if (me == 0) print_usage(argv[0]);
+    MPI_Finalize();
+    exit(0);
+  }
+
+  /* The process grid, row-major as in MPI_Cart_create */
+  MPI_Dims_create(np, 2, dims);
+  py = dims[0];
+  px = dims[1];
+
+  node = (int *) malloc(np*sizeof(int));
+  topo_nodes(MPI_COMM_WORLD, ppn, cyclic, node);
+  nnodes = 0;
+  for (i=0; i<np; i++) if (node[i]+1 > nnodes) nnodes = node[i]+1;
+
+  if (me == 0) {
+    printf("%d x %d processes on %d nodes%s, local domain %d x %d\n",
+	   px, py, nnodes, ppn > 0 ? " (simulated)" : "", nx, ny);
+    printf("mapping  inter-node B/it  of total  exchange (us)\n");
+  }
+
+  report("world", MPI_COMM_WORLD, node, 0, iter);
+
+  comm = topo_reorder_cart(MPI_COMM_WORLD, 2, dims, periods);
+  report("cart", comm, node, 0, iter);
+  MPI_Comm_free(&comm);
+
+  n = grid_neighbours(me, nb, bytes);
+  comm = topo_reorder_graph(MPI_COMM_WORLD, n, nb, bytes);
+  report("graph", comm, node, 1, iter);
+  MPI_Comm_free(&comm);
+
+  comm = topo_reorder_greedy(MPI_COMM_WORLD, n, nb, bytes, node);
+  report("greedy", comm, node, 0, iter);
+  MPI_Comm_free(&comm);
+
+  free(node);
+  MPI_Finalize();
+  exit(0);
+}
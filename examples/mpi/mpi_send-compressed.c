@@ -0,0 +1,179 @@
+/*
+An MPI example program that sends large messages with transparent
+compression.
+
+The program consists of two processes. Process 0 sends a large message
+to process 1, which sends it back, as in mpi_send-standard-large.c.
+This is done both with MPI_Send and MPI_Recv, and with compress_send
+and compress_recv from mpi_compress.c, which compress messages above a
+threshold if that is estimated to make them faster. Several kinds of
+data are sent:
+
+  int ramp       the integers 0, 1, 2, ... as in mpi_send-standard-large.c
+  float field    a smooth 2D field in single precision
+  double field   the same field in double precision
+  random bytes   data that does not compress
+  random double  uniformly distributed doubles, where only the sign and
+                 exponent compress
+
+For each kind the program prints the codec that was chosen, the
+compression ratio, the bandwidth with plain MPI_Send and the effective
+bandwidth with compression, that is message size divided by the time
+for compression, transfer and decompression.
+
+Whether compression pays off depends on the network. On a single
+machine messages are copied at memory speed, and the codec is usually
+not used. With -b the estimate of the network bandwidth can be set to
+see which codec would be chosen on a slower network.
+
+Compile the program with 'mpicc -O3 mpi_send-compressed.c mpi_compress.c -o mpi_send-compressed -lm'
+Run the program with 'mpiexec -n 2 ./mpi_send-compressed'
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "mpi.h"
+#include "mpi_compress.h"
+
+#define KINDS 5
+
+int np, me;
+int repeat = 10;
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <elements> -r <repetitions> -b <assumed bandwidth MB/s>\n", s);
+  printf("          -t <compression threshold in bytes>\n");
+}
+
+/* Fill buf with n elements of the given kind. Returns the datatype */
+MPI_Datatype fill(void *buf, int n, int kind) {
+  unsigned long long state = 12345;
+  int i, w = (int) sqrt((double) n) + 1;
+  double x;
+
+  for (i=0; i<n; i++) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    x = sin(0.01*(i%w)) * cos(0.013*(i/w)) + 0.001*(i/w);
+    switch (kind) {
+    case 0: ((int *) buf)[i] = i; break;
+    case 1: ((float *) buf)[i] = (float) x; break;
+    case 2: ((double *) buf)[i] = x; break;
+    case 3: ((unsigned char *) buf)[i] = (unsigned char) (state >> 56); break;
+    case 4: ((double *) buf)[i] = (double)(state >> 11) * (1.0/9007199254740992.0); break;
+    }
+  }
+  if (kind == 0) return MPI_INT;
+  if (kind == 1) return MPI_FLOAT;
+  if (kind == 3) return MPI_BYTE;
+  return MPI_DOUBLE;
+}
+
+/* Time of a round trip, with or without compression */
+double pingpong(void *buf, int n, MPI_Datatype type, int compressed) {
+  int k, tag = 42;
+  double t;
+  MPI_Status status;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  for (k=0; k<repeat; k++) {
+    if (me == 0) {
+      if (compressed) {
+	compress_send(buf, n, type, 1, tag, MPI_COMM_WORLD);
+	compress_recv(buf, n, type, 1, tag, MPI_COMM_WORLD, &status);
+      }
+      else {
+	MPI_Send(buf, n, type, 1, tag, MPI_COMM_WORLD);
+	MPI_Recv(buf, n, type, 1, tag, MPI_COMM_WORLD, &status);
+      }
+    }
+    else if (me == 1) {
+      if (compressed) {
+	compress_recv(buf, n, type, 0, tag, MPI_COMM_WORLD, &status);
+	compress_send(buf, n, type, 0, tag, MPI_COMM_WORLD);
+      }
+      else {
+	MPI_Recv(buf, n, type, 0, tag, MPI_COMM_WORLD, &status);
+	MPI_Send(buf, n, type, 0, tag, MPI_COMM_WORLD);
+      }
+    }
+  }
+  return (MPI_Wtime() - t)/repeat;
+}
+
+int main(int argc, char* argv[]) {
+  char *names[KINDS] = {"int ramp", "float field", "double field",
+			"random bytes", "random double"};
+  char *codecs[3] = {"none", "lz", "shuffle"};
+  int n = 1024*1024, c, kind, size, codec;
+  double mbs = 0.0, traw, tcomp;
+  void *buf, *orig;
+  MPI_Datatype type;
+  compress_stats s;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  while ((c = getopt(argc, argv, "n:r:b:t:h")) != -1) {
+    switch (c) {
+    case 'n': n = atoi(optarg); break;
+    case 'r': repeat = atoi(optarg); break;
+    case 'b': mbs = atof(optarg); break;
+    case 't': compress_set_threshold(atoi(optarg)); break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+
+  /* Check that we run on exactly two processors */
+  if (np != 2 || n < 1 || repeat < 1) {
+    if (me == 0) {
+      if (np != 2) printf("You have to use exactly 2 processors to run this program\n");
+      else print_usage(argv[0]);
+    }
+    MPI_Finalize();
+    exit(0);
+  }
+  compress_set_bandwidth(mbs*1e6);
+
+  buf = malloc(n*sizeof(double));
+  orig = malloc(n*sizeof(double));
+
+  if (me == 0) {
+    printf("%-14s %10s %-8s %7s %12s %12s %6s\n", "data", "bytes", "codec",
+	   "ratio", "raw MB/s", "eff. MB/s", "gain");
+  }
+  for (kind=0; kind<KINDS; kind++) {
+    type = fill(orig, n, kind);
+    MPI_Type_size(type, &size);
+
+    memcpy(buf, orig, (size_t)n*size);
+    traw = pingpong(buf, n, type, 0);
+
+    memcpy(buf, orig, (size_t)n*size);
+    compress_reset_stats();
+    tcomp = pingpong(buf, n, type, 1);
+    compress_get_stats(&s);
+
+    if (me == 0) {
+      if (memcmp(buf, orig, (size_t)n*size) != 0)
+	printf("%s: data changed in the round trip\n", names[kind]);
+      codec = CODEC_NONE;
+      for (c=1; c<3; c++) if (s.messages[c] > s.messages[codec]) codec = c;
+      printf("%-14s %10d %-8s %7.2f %12.1f %12.1f %6.2f\n", names[kind],
+	     n*size, codecs[codec], s.raw_bytes/s.wire_bytes,
+	     2.0*n*size/traw/1e6, 2.0*n*size/tcomp/1e6, traw/tcomp);
+    }
+  }
+
+  free(buf);
+  free(orig);
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,191 @@
+/*
+An MPI example program that compares persistent requests with
+non-blocking send and receive in a halo exchange.
+
+The processes form a ring, and in every iteration each process sends a
+message to both its neighbours and receives one from each, as in the
+boundary exchange of mpi_wave.c. This is done in three ways:
+
+  isend        MPI_Irecv and MPI_Isend are called for the four messages
+               in every iteration, followed by MPI_Waitall.
+  persistent   the four messages are set up once with MPI_Recv_init and
+               MPI_Send_init. In every iteration they are started with
+               MPI_Startall and completed with MPI_Waitall. MPI can do
+               the checking of arguments and the setting up of the
+               internal data structures once, instead of every time.
+  partitioned  partitioned communication from MPI 4.0 with
+               MPI_Psend_init and MPI_Precv_init. The send buffer is
+               divided into P partitions that are marked ready with
+               MPI_Pready one at a time, as the threads of a hybrid
+               program could do when they have computed their part.
+               This is only available if the MPI library supports MPI 4.0.
+
+The time per iteration is measured for a range of message sizes. For
+small messages the difference is the overhead of setting up the
+operations, which persistent requests save.
+
+Compile the program with 'mpicc -O2 mpi_send-persistent.c -o mpi_send-persistent'
+Run the program with 'mpiexec -n 4 ./mpi_send-persistent'
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "mpi.h"
+
+#define PARTITIONS 4
+
+int np, me, left, right;
+char *sendl, *sendr, *recvl, *recvr;
+
+void print_usage(char *s) {
+  printf("Usage: %s -s <max message size> -t <time per measurement in s>\n", s);
+}
+
+/* Time per iteration with new requests in every iteration */
+double run_isend(int size, int iter) {
+  MPI_Request req[4];
+  double t;
+  int k;
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  for (k=0; k<iter; k++) {
+    MPI_Irecv(recvr, size, MPI_BYTE, right, 0, MPI_COMM_WORLD, &req[0]);
+    MPI_Irecv(recvl, size, MPI_BYTE, left, 1, MPI_COMM_WORLD, &req[1]);
+    MPI_Isend(sendl, size, MPI_BYTE, left, 0, MPI_COMM_WORLD, &req[2]);
+    MPI_Isend(sendr, size, MPI_BYTE, right, 1, MPI_COMM_WORLD, &req[3]);
+    MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+  }
+  return (MPI_Wtime() - t)/iter;
+}
+
+/* Time per iteration with persistent requests */
+double run_persistent(int size, int iter) {
+  MPI_Request req[4];
+  double t;
+  int k;
+
+  MPI_Recv_init(recvr, size, MPI_BYTE, right, 0, MPI_COMM_WORLD, &req[0]);
+  MPI_Recv_init(recvl, size, MPI_BYTE, left, 1, MPI_COMM_WORLD, &req[1]);
+  MPI_Send_init(sendl, size, MPI_BYTE, left, 0, MPI_COMM_WORLD, &req[2]);
+  MPI_Send_init(sendr, size, MPI_BYTE, right, 1, MPI_COMM_WORLD, &req[3]);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  for (k=0; k<iter; k++) {
+    MPI_Startall(4, req);
+    MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+  }
+  t = (MPI_Wtime() - t)/iter;
+
+  for (k=0; k<4; k++) MPI_Request_free(&req[k]);
+  return t;
+}
+
+#if MPI_VERSION >= 4
+/* Time per iteration with partitioned communication */
+double run_partitioned(int size, int iter) {
+  MPI_Request req[4];
+  double t;
+  int k, p, parts = size >= PARTITIONS ? PARTITIONS : 1;
+  MPI_Count n = size/parts;
+
+  MPI_Precv_init(recvr, parts, n, MPI_BYTE, right, 0, MPI_COMM_WORLD, MPI_INFO_NULL, &req[0]);
+  MPI_Precv_init(recvl, parts, n, MPI_BYTE, left, 1, MPI_COMM_WORLD, MPI_INFO_NULL, &req[1]);
+  MPI_Psend_init(sendl, parts, n, MPI_BYTE, left, 0, MPI_COMM_WORLD, MPI_INFO_NULL, &req[2]);
+  MPI_Psend_init(sendr, parts, n, MPI_BYTE, right, 1, MPI_COMM_WORLD, MPI_INFO_NULL, &req[3]);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  for (k=0; k<iter; k++) {
+    MPI_Startall(4, req);
+    for (p=0; p<parts; p++) {
+      MPI_Pready(p, req[2]);
+      MPI_Pready(p, req[3]);
+    }
+    MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+  }
+  t = (MPI_Wtime() - t)/iter;
+
+  for (k=0; k<4; k++) MPI_Request_free(&req[k]);
+  return t;
+}
+#endif
+
+/* Number of iterations that take about the given time */
+int iterations(int size, double seconds) {
+  double t, tmax;
+  int iter = 10;
+
+  t = run_isend(size, iter);
+  MPI_Allreduce(&t, &tmax, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  iter = (int) (seconds/tmax);
+  return iter < 10 ? 10 : iter;
+}
+
+int main(int argc, char* argv[]) {
+  int c, size, maxsize = 4*1024*1024, iter;
+  double seconds = 0.2, t[3], tmax[3];
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  while ((c = getopt(argc, argv, "s:t:h")) != -1) {
+    switch (c) {
+    case 's': maxsize = atoi(optarg); break;
+    case 't': seconds = atof(optarg); break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+  if (maxsize < 1 || seconds <= 0.0) {
+    if (me == 0) print_usage(argv[0]);
+    MPI_Finalize();
+    exit(0);
+  }
+
+  /* Neighbours in a ring */
+  left = (me + np - 1) % np;
+  right = (me + 1) % np;
+  sendl = (char *) calloc(maxsize, 1);
+  sendr = (char *) calloc(maxsize, 1);
+  recvl = (char *) malloc(maxsize);
+  recvr = (char *) malloc(maxsize);
+
+  if (me == 0) {
+    printf("%d processes in a ring, time per iteration in microseconds\n", np);
+    printf("%10s %12s %12s %8s", "bytes", "isend", "persistent", "saved");
+#if MPI_VERSION >= 4
+    printf(" %12s", "partitioned");
+#endif
+    printf("\n");
+  }
+
+  for (size=1; size<=maxsize; size*=4) {
+    iter = iterations(size, seconds);
+    t[0] = run_isend(size, iter);
+    t[1] = run_persistent(size, iter);
+#if MPI_VERSION >= 4
+    t[2] = run_partitioned(size, iter);
+#else
+    t[2] = 0.0;
+#endif
+    MPI_Reduce(t, tmax, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (me == 0) {
+      printf("%10d %12.2f %12.2f %7.1f%%", size, tmax[0]*1e6, tmax[1]*1e6,
+	     100.0*(tmax[0]-tmax[1])/tmax[0]);
+#if MPI_VERSION >= 4
+      printf(" %12.2f", tmax[2]*1e6);
+#endif
+      printf("\n");
+    }
+  }
+
+  free(sendl); free(sendr); free(recvl); free(recvr);
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,224 @@
+/*
+  MPI example program that writes snapshots of a simulation to files in
+  the chunked array format of dataset.h.
+
+  The simulation solves the 2D heat equation on an N x N grid with an
+  explicit method. The grid is divided into blocks over a 2D grid of
+  processes, and each process has a layer of ghost cells around its
+  block that is exchanged with the neighbours every time step, as in
+  mpi_wave.c but in two dimensions.
+
+  Every K steps all processes write the grid to one file, snap_NNNN.dat,
+  with dset_write from mpi_dataset.c. The ghost cells are left out by
+  the memory datatype, so the local arrays are written as they are. At
+  the end the last snapshot is read back into the blocks and compared
+  with the grid in memory, and read with a different decomposition, in
+  horizontal slabs.
+
+  With -r an existing file is read with the current number of processes
+  instead, which can be different from the number that wrote it. The
+  files can also be inspected with the serial tool dataset_dump.c.
+
+  Compile the program with 'mpicc -O2 mpi_snapshot.c mpi_dataset.c dataset.c -o mpi_snapshot -lm'
+  Run the program with 'mpiexec -n 4 ./mpi_snapshot'
+  and read a snapshot with 'mpiexec -n 3 ./mpi_snapshot -r snap_0100.dat'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <mpi.h>
+#include "mpi_dataset.h"
+
+int me, np;
+int N = 512;              /* Size of the grid */
+int chunk = 64;           /* Size of the chunks in the file */
+int start[2], count[2];   /* The block of this process */
+int lsize[2];             /* Size of the local array, with ghost cells */
+int lstart[2] = {1, 1};
+MPI_Comm grid;
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <grid size> -s <steps> -k <steps between snapshots>\n", s);
+  printf("          -c <chunk size> | -r <file to read>\n");
+}
+
+/* Exchange ghost cells with the four neighbours */
+void exchange(double *u, MPI_Datatype column) {
+  int up, down, left, right, w = lsize[1];
+
+  MPI_Cart_shift(grid, 0, 1, &up, &down);
+  MPI_Cart_shift(grid, 1, 1, &left, &right);
+  MPI_Sendrecv(&u[1*w+1], count[1], MPI_DOUBLE, up, 0,
+	       &u[(count[0]+1)*w+1], count[1], MPI_DOUBLE, down, 0, grid, MPI_STATUS_IGNORE);
+  MPI_Sendrecv(&u[count[0]*w+1], count[1], MPI_DOUBLE, down, 1,
+	       &u[0*w+1], count[1], MPI_DOUBLE, up, 1, grid, MPI_STATUS_IGNORE);
+  MPI_Sendrecv(&u[1*w+1], 1, column, left, 2,
+	       &u[1*w+count[1]+1], 1, column, right, 2, grid, MPI_STATUS_IGNORE);
+  MPI_Sendrecv(&u[1*w+count[1]], 1, column, right, 3,
+	       &u[1*w+0], 1, column, left, 3, grid, MPI_STATUS_IGNORE);
+}
+
+/* Sum, minimum and maximum of an array of n doubles over all processes */
+void statistics(double *x, long long n, double *s) {
+  double loc[3] = {0.0, 1e300, -1e300};
+  long long i;
+
+  for (i=0; i<n; i++) {
+    loc[0] += x[i];
+    if (x[i] < loc[1]) loc[1] = x[i];
+    if (x[i] > loc[2]) loc[2] = x[i];
+  }
+  MPI_Allreduce(&loc[0], &s[0], 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(&loc[1], &s[1], 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&loc[2], &s[2], 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+}
+
+/* Read a whole 2D file in horizontal slabs, one per process */
+double *read_slabs(char *filename, dset_header *h, int *slab) {
+  double *x;
+  int rows;
+
+  if (dset_read_header(MPI_COMM_WORLD, filename, h) != 0 || h->ndims != 2 ||
+      h->type != DSET_DOUBLE) {
+    if (me == 0) printf("%s is not a 2D array of doubles\n", filename);
+    return NULL;
+  }
+  rows = (int) h->dims[0];
+  slab[0] = (int) ((long long)rows*me/np);
+  slab[1] = 0;
+  slab[2] = (int) ((long long)rows*(me+1)/np) - slab[0];
+  slab[3] = (int) h->dims[1];
+  x = (double *) malloc(((long long)slab[2]*slab[3] + 1)*sizeof(double));
+  dset_read(MPI_COMM_WORLD, filename, &slab[0], &slab[2], x, NULL, NULL);
+  return x;
+}
+
+int main(int argc, char* argv[]) {
+  int c, i, j, step, steps = 100, every = 25, w, errors;
+  int dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2], slab[4];
+  int gdims[2], cdims[2];
+  char *readfile = NULL, filename[64], attrs[256];
+  double *u, *unew, *tmp, *x, r = 0.2, s[3], t, twrite = 0.0;
+  dset_header h;
+  MPI_Datatype column;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  while ((c = getopt(argc, argv, "n:s:k:c:r:h")) != -1) {
+    switch (c) {
+    case 'n': N = atoi(optarg); break;
+    case 's': steps = atoi(optarg); break;
+    case 'k': every = atoi(optarg); break;
+    case 'c': chunk = atoi(optarg); break;
+    case 'r': readfile = optarg; break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+  if (N < 2 || steps < 1 || every < 1 || chunk < 1) {
+    if (me == 0) print_usage(argv[0]);
+    MPI_Finalize();
+    exit(0);
+  }
+
+  if (readfile != NULL) {
+    /* Only read a file, with any number of processes */
+    x = read_slabs(readfile, &h, slab);
+    if (x != NULL) {
+      statistics(x, (long long)slab[2]*slab[3], s);
+      if (me == 0) {
+	printf("%s: %s %lld x %lld in %lld x %lld chunks, %s\n", readfile, h.name,
+	       h.dims[0], h.dims[1], h.chunk[0], h.chunk[1], h.attrs);
+	printf("Read by %d processes: sum %g, min %g, max %g\n", np, s[0], s[1], s[2]);
+      }
+      free(x);
+    }
+    MPI_Finalize();
+    exit(0);
+  }
+
+  /* The blocks of the 2D process grid */
+  MPI_Dims_create(np, 2, dims);
+  MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid);
+  MPI_Cart_coords(grid, me, 2, coords);
+  for (i=0; i<2; i++) {
+    start[i] = (int) ((long long)N*coords[i]/dims[i]);
+    count[i] = (int) ((long long)N*(coords[i]+1)/dims[i]) - start[i];
+    lsize[i] = count[i] + 2;
+  }
+  w = lsize[1];
+  gdims[0] = gdims[1] = N;
+  cdims[0] = cdims[1] = chunk;
+  MPI_Type_vector(count[0], 1, w, MPI_DOUBLE, &column);
+  MPI_Type_commit(&column);
+
+  /* A hot square in the middle, the boundary is kept at zero */
+  u = (double *) calloc(lsize[0]*lsize[1], sizeof(double));
+  unew = (double *) calloc(lsize[0]*lsize[1], sizeof(double));
+  for (i=0; i<count[0]; i++)
+    for (j=0; j<count[1]; j++)
+      if (abs(start[0]+i - N/2) < N/8 && abs(start[1]+j - N/2) < N/8)
+	u[(i+1)*w+j+1] = 1.0;
+
+  for (step=1; step<=steps; step++) {
+    exchange(u, column);
+    for (i=1; i<=count[0]; i++) {
+      for (j=1; j<=count[1]; j++) {
+	if (start[0]+i-1 == 0 || start[0]+i-1 == N-1 || start[1]+j-1 == 0 || start[1]+j-1 == N-1)
+	  unew[i*w+j] = 0.0;
+	else
+	  unew[i*w+j] = u[i*w+j] + r*(u[(i-1)*w+j] + u[(i+1)*w+j] + u[i*w+j-1]
+				      + u[i*w+j+1] - 4.0*u[i*w+j]);
+      }
+    }
+    tmp = u; u = unew; unew = tmp;
+
+    if (step % every == 0 || step == steps) {
+      sprintf(filename, "snap_%04d.dat", step);
+      sprintf(attrs, "step=%d r=%g", step, r);
+      dset_init_header(&h, "temperature", attrs, DSET_DOUBLE, 2, gdims, cdims);
+      MPI_Barrier(MPI_COMM_WORLD);
+      t = MPI_Wtime();
+      dset_write(MPI_COMM_WORLD, filename, &h, start, count, u, lsize, lstart);
+      twrite += MPI_Wtime() - t;
+      if (me == 0) printf("Wrote %s\n", filename);
+    }
+  }
+
+  /* Read the last snapshot back into the blocks, with ghost cells, and
+     compare with the grid in memory */
+  for (i=0; i<lsize[0]*lsize[1]; i++) unew[i] = 0.0;
+  dset_read(MPI_COMM_WORLD, filename, start, count, unew, lsize, lstart);
+  errors = 0;
+  for (i=1; i<=count[0]; i++)
+    for (j=1; j<=count[1]; j++)
+      if (unew[i*w+j] != u[i*w+j]) errors++;
+  MPI_Allreduce(MPI_IN_PLACE, &errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+  /* Read it in slabs. The sum over the slabs must match the sum over
+     the blocks, apart from rounding */
+  x = read_slabs(filename, &h, slab);
+  for (i=0; i<count[0]; i++)
+    memmove(&unew[i*count[1]], &u[(i+1)*w+1], count[1]*sizeof(double));
+  statistics(unew, (long long)count[0]*count[1], s);
+  t = s[0];
+  statistics(x, (long long)slab[2]*slab[3], s);
+  if (me == 0) {
+    printf("%d x %d processes, %d x %d grid, %d steps\n", dims[0], dims[1], N, N, steps);
+    printf("Sum of the grid %.12g, of the file read in slabs %.12g\n", t, s[0]);
+    printf("Writing took %.3f s, %d elements read back wrong\n", twrite, errors);
+    if (fabs(t - s[0]) > 1e-9*fabs(t)) printf("The sums differ\n");
+  }
+
+  free(u); free(unew); free(x);
+  MPI_Type_free(&column);
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi_topo.h"
+
+void topo_nodes(MPI_Comm comm, int ppn, int cyclic, int *node) {
+  char name[MPI_MAX_PROCESSOR_NAME], *names;
+  int np, me, len, i, j, nnodes;
+
+  MPI_Comm_size(comm, &np);
+  MPI_Comm_rank(comm, &me);
+
+  if (ppn > 0) {
+    nnodes = (np+ppn-1)/ppn;
+    for (i=0; i<np; i++) node[i] = cyclic ? i%nnodes : i/ppn;
+    return;
+  }
+
+  /* Number the distinct processor names in order of first appearance */
+  memset(name, 0, sizeof(name));
+  MPI_Get_processor_name(name, &len);
+  names = (char *) malloc(np*MPI_MAX_PROCESSOR_NAME);
+  MPI_Allgather(name, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, names,
+		MPI_MAX_PROCESSOR_NAME, MPI_CHAR, comm);
+  nnodes = 0;
+  for (i=0; i<np; i++) {
+    node[i] = -1;
+    for (j=0; j<i; j++) {
+      if (strcmp(&names[i*MPI_MAX_PROCESSOR_NAME], &names[j*MPI_MAX_PROCESSOR_NAME]) == 0) {
+	node[i] = node[j];
+	break;
+      }
+    }
+    if (node[i] < 0) node[i] = nnodes++;
+  }
+  free(names);
+}
+
+void topo_rank_nodes(MPI_Comm oldcomm, MPI_Comm newcomm, const int *node_old,
+		     int *node_new) {
+  int me;
+  MPI_Comm_rank(oldcomm, &me);
+  MPI_Allgather((void *)&node_old[me], 1, MPI_INT, node_new, 1, MPI_INT, newcomm);
+}
+
+double topo_internode_bytes(MPI_Comm comm, int n, const int *neighbours,
+			    const int *bytes, const int *node) {
+  double sum = 0.0, total;
+  int me, i;
+
+  MPI_Comm_rank(comm, &me);
+  for (i=0; i<n; i++)
+    if (node[neighbours[i]] != node[me]) sum += bytes[i];
+  MPI_Allreduce(&sum, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+  return total;
+}
+
+MPI_Comm topo_reorder_cart(MPI_Comm comm, int ndims, int *dims, int *periods) {
+  MPI_Comm newcomm;
+  MPI_Cart_create(comm, ndims, dims, periods, 1, &newcomm);
+  return newcomm;
+}
+
+MPI_Comm topo_reorder_graph(MPI_Comm comm, int n, const int *neighbours,
+			    const int *bytes) {
+  MPI_Comm newcomm;
+  /* The graph is symmetric, so the sources are the destinations */
+  MPI_Dist_graph_create_adjacent(comm, n, (int *)neighbours, (int *)bytes,
+				 n, (int *)neighbours, (int *)bytes,
+				 MPI_INFO_NULL, 1, &newcomm);
+  return newcomm;
+}
+
+MPI_Comm topo_reorder_greedy(MPI_Comm comm, int n, const int *neighbours,
+			     const int *bytes, const int *node) {
+  int np, me, i, j, k, t, u, nedges, best, slot, cap, nnodes, nd;
+  int *counts, *displs, *edges, *start, *fill, *adj, *wgt, *slot_of, *assigned;
+  int *local, *nodes, newrank = 0;
+  double *conn, *ext;
+  MPI_Comm newcomm;
+
+  MPI_Comm_size(comm, &np);
+  MPI_Comm_rank(comm, &me);
+
+  /* Gather the whole graph as (from, to, bytes) triples */
+  counts = (int *) malloc(np*sizeof(int));
+  displs = (int *) malloc(np*sizeof(int));
+  k = 3*n;
+  MPI_Allgather(&k, 1, MPI_INT, counts, 1, MPI_INT, comm);
+  displs[0] = 0;
+  for (i=1; i<np; i++) displs[i] = displs[i-1] + counts[i-1];
+  nedges = (displs[np-1] + counts[np-1])/3;
+  local = (int *) malloc((3*n+1)*sizeof(int));
+  for (i=0; i<n; i++) {
+    local[3*i] = me;
+    local[3*i+1] = neighbours[i];
+    local[3*i+2] = bytes[i];
+  }
+  edges = (int *) malloc((3*nedges+1)*sizeof(int));
+  MPI_Gatherv(local, 3*n, MPI_INT, edges, counts, displs, MPI_INT, 0, comm);
+
+  slot_of = (int *) malloc(np*sizeof(int));
+  if (me == 0) {
+    /* Undirected adjacency lists, every edge in both directions */
+    start = (int *) calloc(np+1, sizeof(int));
+    for (i=0; i<nedges; i++) {
+      start[edges[3*i]+1]++;
+      start[edges[3*i+1]+1]++;
+    }
+    for (i=0; i<np; i++) start[i+1] += start[i];
+    fill = (int *) malloc((np+1)*sizeof(int));
+    memcpy(fill, start, (np+1)*sizeof(int));
+    adj = (int *) malloc((2*nedges+1)*sizeof(int));
+    wgt = (int *) malloc((2*nedges+1)*sizeof(int));
+    for (i=0; i<nedges; i++) {
+      t = edges[3*i];  u = edges[3*i+1];
+      adj[fill[t]] = u;  wgt[fill[t]++] = edges[3*i+2];
+      adj[fill[u]] = t;  wgt[fill[u]++] = edges[3*i+2];
+    }
+
+    /* conn[t] is the traffic between t and the processes on the node
+       that is being filled, ext[t] the traffic to all placed processes */
+    conn = (double *) calloc(np, sizeof(double));
+    ext = (double *) calloc(np, sizeof(double));
+    assigned = (int *) calloc(np, sizeof(int));
+    nodes = (int *) malloc(np*sizeof(int));
+    nnodes = 0;
+    for (i=0; i<np; i++) if (node[i]+1 > nnodes) nnodes = node[i]+1;
+
+    for (nd=0; nd<nnodes; nd++) {
+      cap = 0;
+      for (i=0; i<np; i++) if (node[i] == nd) nodes[cap++] = i;
+      for (i=0; i<np; i++) conn[i] = 0.0;
+      for (slot=0; slot<cap; slot++) {
+	/* The first process on a node is the one with most traffic to the
+	   processes already placed, later ones the one with most traffic
+	   to this node. Ties are broken by the lowest rank */
+	best = -1;
+	for (t=0; t<np; t++) {
+	  if (assigned[t]) continue;
+	  if (best < 0 || (slot == 0 ? ext[t] > ext[best] : conn[t] > conn[best]))
+	    best = t;
+	}
+	assigned[best] = 1;
+	slot_of[best] = nodes[slot];
+	for (j=start[best]; j<start[best+1]; j++) {
+	  conn[adj[j]] += wgt[j];
+	  ext[adj[j]] += wgt[j];
+	}
+      }
+    }
+    free(start); free(fill); free(adj); free(wgt);
+    free(conn); free(ext); free(assigned); free(nodes);
+  }
+  MPI_Bcast(slot_of, np, MPI_INT, 0, comm);
+
+  /* The process in slot me takes the rank of the task placed there */
+  for (t=0; t<np; t++) if (slot_of[t] == me) newrank = t;
+  MPI_Comm_split(comm, 0, newrank, &newcomm);
+
+  free(counts); free(displs); free(local); free(edges); free(slot_of);
+  return newcomm;
+}
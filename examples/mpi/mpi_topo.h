@@ -0,0 +1,54 @@
+#ifndef MPI_TOPO_H
+#define MPI_TOPO_H
+
+/*
+  Mapping of processes to nodes for codes that mostly talk to a few
+  neighbours.
+
+  The communication graph of an application is given by each process as
+  a list of neighbour ranks and the number of bytes it sends to each of
+  them per iteration. The functions below create a new communicator in
+  which the ranks are ordered so that heavily communicating processes end
+  up on the same node. The application then uses the rank in the new
+  communicator to decide which part of the problem it works on, and
+  computes its neighbours again from that rank.
+
+  See mpi_reorder.c for an example.
+*/
+
+#include <mpi.h>
+
+/* Find the node of each process in comm. Processes with the same
+   processor name are on the same node. If ppn > 0, nodes with ppn
+   processes each are simulated instead, filled in rank order or, if
+   cyclic is set, round-robin like 'mpiexec --map-by node' */
+void topo_nodes(MPI_Comm comm, int ppn, int cyclic, int *node);
+
+/* The node of every rank in newcomm, which has been created from
+   oldcomm. node_old is the result of topo_nodes for oldcomm */
+void topo_rank_nodes(MPI_Comm oldcomm, MPI_Comm newcomm, const int *node_old,
+		     int *node_new);
+
+/* Total number of bytes per iteration sent between processes on
+   different nodes. node holds the node of every rank in comm */
+double topo_internode_bytes(MPI_Comm comm, int n, const int *neighbours,
+			    const int *bytes, const int *node);
+
+/* Cartesian communicator created with reorder=1 */
+MPI_Comm topo_reorder_cart(MPI_Comm comm, int ndims, int *dims, int *periods);
+
+/* Distributed graph communicator created from the communication graph
+   with MPI_Dist_graph_create_adjacent and reorder=1. The neighbours in
+   the new communicator are found with MPI_Dist_graph_neighbors */
+MPI_Comm topo_reorder_graph(MPI_Comm comm, int n, const int *neighbours,
+			    const int *bytes);
+
+/* Fallback that does not depend on the MPI library: the whole graph is
+   gathered, and the nodes are filled one at a time with a greedy graph
+   growing heuristic, always adding the process that sends the most data
+   to the processes already placed on the node. node is the result of
+   topo_nodes for comm */
+MPI_Comm topo_reorder_greedy(MPI_Comm comm, int n, const int *neighbours,
+			     const int *bytes, const int *node);
+
+#endif
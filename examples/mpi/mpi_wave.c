@@ -15,6 +15,9 @@
    added.
 
    Compile with 'mpicc -mpe=graphics MPI_wave.c -o MPI_wave -lm'
+   Add -DPERSISTENT to exchange the boundary points with persistent
+   requests (MPI_Send_init, MPI_Recv_init and MPI_Startall) instead of
+   MPI_Sendrecv.
 */
 
 #include <mpi.h>
@@ -194,6 +197,17 @@ void update(int left, int right) {
   double tau, sqtau;              /* Tau and tau to the square  */
   int i;
   
+#ifdef PERSISTENT
+  MPI_Request req[4];
+  /* The boundary points are always at the same addresses, so the four
+     messages of a time step can be set up once as persistent requests
+     and started again in every step */
+  MPI_Recv_init(&X[M-1], 1, MPI_DOUBLE, right, datatag, MPI_COMM_WORLD, &req[0]);
+  MPI_Recv_init(&X[0], 1, MPI_DOUBLE, left, datatag+1, MPI_COMM_WORLD, &req[1]);
+  MPI_Send_init(&X[1], 1, MPI_DOUBLE, left, datatag, MPI_COMM_WORLD, &req[2]);
+  MPI_Send_init(&X[M-2], 1, MPI_DOUBLE, right, datatag+1, MPI_COMM_WORLD, &req[3]);
+#endif
+  
   /* Calculate tau and tau to the power of 2 */
   tau = (c * deltat / deltax);
   sqtau = tau * tau;
@@ -203,6 +217,11 @@ void update(int left, int right) {
   while (!pressed) {
     
     steps++;         /* Count number of steps */
+#ifdef PERSISTENT
+    /* Exchange boundary points with both neighbours */
+    MPI_Startall(4, req);
+    MPI_Waitall(4, req, MPI_STATUSES_IGNORE);
+#else
     /* Send to the left and receive from the right */
     MPI_Sendrecv(&X[1], 1, MPI_DOUBLE, left, datatag, &X[M-1],
 		 1, MPI_DOUBLE, right, datatag, MPI_COMM_WORLD, &status);
@@ -214,6 +233,7 @@ void update(int left, int right) {
 		 1, MPI_DOUBLE, left, datatag, MPI_COMM_WORLD, &status);
     /* MPI_Send(&X[M-2], 1, MPI_DOUBLE, right, datatag, MPI_COMM_WORLD); */
     /* MPI_Recv(&X[0], 1, MPI_DOUBLE, left, datatag, MPI_COMM_WORLD, &status); */
+#endif
 
     
     /* Calculate new values using the wave equation */
@@ -228,6 +248,9 @@ void update(int left, int right) {
     }
     update_graphics(&pressed);
   }
+#ifdef PERSISTENT
+  for (i=0; i<4; i++) MPI_Request_free(&req[i]);
+#endif
 }
 
 
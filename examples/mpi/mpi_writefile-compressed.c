@@ -0,0 +1,184 @@
+/*
+MPI-IO program that writes compressed data of different size from each
+process to one file.
+
+In mpi_writefile.c every process writes BUFSIZE characters at offset
+me*BUFSIZE, so all processes must write the same amount of data. Here
+each process produces a different number of doubles, compresses them
+and finds its own offset in the file with MPI_Exscan of the compressed
+sizes. All processes then write at the same time with
+MPI_File_write_at_all.
+
+The data is compressed in blocks of B bytes with the codecs in
+mpi_compress.c, so that any block can be decompressed on its own. An
+index with one entry per block is written after the data, each process
+again finding the position of its entries with MPI_Exscan, and a
+trailer at the end of the file tells where the index is. The file
+layout is described in mpi_compressfile.h. Writes larger than an int
+can count are done in pieces.
+
+The file can be read by mpi_readfile-compressed.c with any number of
+processes. With -u the data is also written without compression to
+<file>.raw to compare the time.
+
+Compile the program with 'mpicc -O2 mpi_writefile-compressed.c mpi_compressfile.c mpi_compress.c -o mpi_writefile-compressed -lm'
+Run the program with 'mpiexec -n 4 ./mpi_writefile-compressed'
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "mpi.h"
+#include "mpi_compressfile.h"
+
+#define FILENAME "file2.dat"
+
+int np, me;
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <doubles per process> -b <block size> -f <file> -u\n", s);
+}
+
+int main(int argc, char* argv[]) {
+  char *filename = FILENAME, rawname[256];
+  int c, nblocks, rsize, csize, uncompressed = 0, blocksize = 1024*1024;
+  long long i, n = 1000000, nmine, bytes, offset, total;
+  long long mine[3], before[3], trailer[4];
+  long long *index;
+  unsigned char *out, *tmp, *data;
+  double *x, t, tcomp, twrite, traw = 0.0;
+  MPI_File myfile;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+  while ((c = getopt(argc, argv, "n:b:f:uh")) != -1) {
+    switch (c) {
+    case 'n': n = atoll(optarg); break;
+    case 'b': blocksize = atoi(optarg); break;
+    case 'f': filename = optarg; break;
+    case 'u': uncompressed = 1; break;
+    default:
+      if (me == 0) print_usage(argv[0]);
+      MPI_Finalize();
+      exit(0);
+    }
+  }
+  blocksize -= blocksize % sizeof(double);
+  if (n < 0 || blocksize < 1024) {
+    if (me == 0) print_usage(argv[0]);
+    MPI_Finalize();
+    exit(0);
+  }
+
+  /* A different amount of data in each process: a smooth field in
+     single precision, stored as doubles */
+  nmine = n + n*(me%4)/4;
+  bytes = nmine*sizeof(double);
+  x = (double *) malloc(bytes + sizeof(double));
+  for (i=0; i<nmine; i++)
+    x[i] = (float) (sin(0.0001*i + me) * exp(-1e-7*i) + 0.5*cos(0.003*i));
+  data = (unsigned char *) x;
+
+  /* Compress the blocks one after the other into out */
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  nblocks = (int) ((bytes + blocksize - 1)/blocksize);
+  out = (unsigned char *) malloc(bytes + 1);
+  tmp = (unsigned char *) malloc(blocksize);
+  index = (long long *) malloc((ENTRY*nblocks + 1)*sizeof(long long));
+  csize = 0;
+  offset = 0;
+  for (i=0; i<nblocks; i++) {
+    rsize = (int) (bytes - i*blocksize < blocksize ? bytes - i*blocksize : blocksize);
+    index[ENTRY*i+4] = CODEC_SHUFFLE;
+    csize = shuffle_compress(&data[i*blocksize], rsize, sizeof(double),
+			     &out[offset], rsize - rsize/16, tmp);
+    if (csize < 0) {
+      /* Store blocks that do not compress as they are */
+      index[ENTRY*i+4] = CODEC_NONE;
+      csize = rsize;
+      memcpy(&out[offset], &data[i*blocksize], rsize);
+    }
+    index[ENTRY*i] = offset;              /* Made absolute below */
+    index[ENTRY*i+1] = csize;
+    index[ENTRY*i+2] = i*blocksize;
+    index[ENTRY*i+3] = rsize;
+    index[ENTRY*i+5] = block_checksum(&data[i*blocksize], rsize);
+    offset += csize;
+  }
+  tcomp = MPI_Wtime() - t;
+
+  /* The offsets of this process: compressed bytes, blocks and
+     uncompressed bytes in the processes before it */
+  mine[0] = offset;
+  mine[1] = nblocks;
+  mine[2] = bytes;
+  MPI_Exscan(mine, before, 3, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  if (me == 0) before[0] = before[1] = before[2] = 0;   /* Undefined in rank 0 */
+  for (i=0; i<nblocks; i++) {
+    index[ENTRY*i] += HEADERSIZE + before[0];
+    index[ENTRY*i+2] += before[2];
+  }
+  /* The last process knows the totals */
+  trailer[0] = HEADERSIZE + before[0] + mine[0];
+  trailer[1] = before[1] + mine[1];
+  trailer[2] = before[2] + mine[2];
+  trailer[3] = TRAILER_MAGIC;
+  MPI_Bcast(trailer, 4, MPI_LONG_LONG, np-1, MPI_COMM_WORLD);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  t = MPI_Wtime();
+  if (me == 0) MPI_File_delete(filename, MPI_INFO_NULL);
+  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+		MPI_INFO_NULL, &myfile);
+  if (me == 0) {
+    MPI_File_write_at(myfile, 0, MAGIC, 8, MPI_CHAR, MPI_STATUS_IGNORE);
+    offset = blocksize;
+    MPI_File_write_at(myfile, 8, &offset, 1, MPI_LONG_LONG, MPI_STATUS_IGNORE);
+  }
+  file_write_at_all(myfile, HEADERSIZE + before[0], out, mine[0], MPI_COMM_WORLD);
+  file_write_at_all(myfile, trailer[0] + before[1]*ENTRY*sizeof(long long), index,
+		    ENTRY*nblocks*(long long)sizeof(long long), MPI_COMM_WORLD);
+  if (me == np-1) {
+    MPI_File_write_at(myfile, trailer[0] + trailer[1]*ENTRY*sizeof(long long),
+		      trailer, 4, MPI_LONG_LONG, MPI_STATUS_IGNORE);
+  }
+  MPI_File_close(&myfile);
+  twrite = MPI_Wtime() - t;
+
+  if (uncompressed) {
+    /* The same data without compression, also at offsets from MPI_Exscan */
+    MPI_Barrier(MPI_COMM_WORLD);
+    t = MPI_Wtime();
+    snprintf(rawname, sizeof(rawname), "%s.raw", filename);
+    if (me == 0) MPI_File_delete(rawname, MPI_INFO_NULL);
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_File_open(MPI_COMM_WORLD, rawname, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+		  MPI_INFO_NULL, &myfile);
+    file_write_at_all(myfile, before[2], data, bytes, MPI_COMM_WORLD);
+    MPI_File_close(&myfile);
+    traw = MPI_Wtime() - t;
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, &tcomp, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  if (me == 0) {
+    total = trailer[0] + trailer[1]*ENTRY*sizeof(long long) + 4*sizeof(long long);
+    printf("%d processes wrote %lld bytes as %lld bytes in %lld blocks (ratio %.2f)\n",
+	   np, trailer[2], total, trailer[1], (double)trailer[2]/total);
+    printf("Compression %.3f s, writing %.3f s", tcomp, twrite);
+    if (uncompressed) printf(", writing uncompressed %.3f s", traw);
+    printf("\n");
+  }
+
+  free(x);
+  free(out);
+  free(tmp);
+  free(index);
+  MPI_Finalize();
+  exit(0);
+}
@@ -0,0 +1,191 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "affinity.h"
+
+#define MAXNODES 256
+#define MAXTHREADS 1024
+#define SAMPLES 4096        /* Pages asked about in the page report */
+
+/* The node of each thread, from the last call to aff_pin_threads or
+   aff_report_threads, or -1 */
+static int thread_node[MAXTHREADS];
+static int known_threads = 0;
+
+int aff_cpu_node(int cpu) {
+#ifdef __linux__
+  char path[128];
+  int node;
+
+  for (node=0; node<MAXNODES; node++) {
+    sprintf(path, "/sys/devices/system/node/node%d/cpu%d", node, cpu);
+    if (access(path, F_OK) == 0) return node;
+  }
+#endif
+  return 0;
+}
+
+int aff_num_nodes(void) {
+  int n = 1;
+#ifdef __linux__
+  char path[128];
+  int node;
+
+  for (node=0; node<MAXNODES; node++) {
+    sprintf(path, "/sys/devices/system/node/node%d", node);
+    if (access(path, F_OK) == 0) n = node+1;
+  }
+#endif
+  return n;
+}
+
+int aff_bound_by_env(void) {
+  char *s = getenv("OMP_PROC_BIND");
+
+  if (s != NULL && strcmp(s, "false") != 0 && strcmp(s, "FALSE") != 0) return 1;
+  return getenv("OMP_PLACES") != NULL || getenv("GOMP_CPU_AFFINITY") != NULL;
+}
+
+int aff_pin_threads(int policy) {
+#ifdef __linux__
+  static int cpus[MAXTHREADS], ncpus = 0;
+  int order[MAXTHREADS], n = 0, node, nodes, i;
+  cpu_set_t set;
+
+  if (aff_bound_by_env()) return 0;
+
+  /* The CPUs the program may use, saved at the first call since the
+     master thread is bound to one of them after that */
+  if (ncpus == 0) {
+    sched_getaffinity(0, sizeof(set), &set);
+    for (i=0; i<CPU_SETSIZE && ncpus<MAXTHREADS; i++)
+      if (CPU_ISSET(i, &set)) cpus[ncpus++] = i;
+  }
+
+  /* Compact takes the CPUs in order. Spread takes one CPU from each
+     node in turn */
+  if (policy == AFF_SPREAD) {
+    nodes = aff_num_nodes();
+    while (n < ncpus)
+      for (node=0; node<nodes; node++)
+	for (i=0; i<ncpus; i++)
+	  if (cpus[i] >= 0 && aff_cpu_node(cpus[i]) == node) {
+	    order[n++] = cpus[i];
+	    cpus[i] = -cpus[i] - 1;     /* Taken */
+	    break;
+	  }
+    for (i=0; i<ncpus; i++) cpus[i] = -cpus[i] - 1;
+  }
+  else
+    for (n=0; n<ncpus; n++) order[n] = cpus[n];
+
+#pragma omp parallel private(set)
+  {
+    int t = omp_get_thread_num(), cpu = order[t % ncpus];
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+    if (t < MAXTHREADS) thread_node[t] = aff_cpu_node(cpu);
+#pragma omp single
+    known_threads = omp_get_num_threads();
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void aff_report_threads(FILE *f) {
+  int cpu[MAXTHREADS], n = 0, t;
+
+#pragma omp parallel
+  {
+    int tid = omp_get_thread_num();
+
+    if (tid < MAXTHREADS) {
+#ifdef __linux__
+      cpu[tid] = sched_getcpu();
+#else
+      cpu[tid] = -1;
+#endif
+      thread_node[tid] = cpu[tid] >= 0 ? aff_cpu_node(cpu[tid]) : 0;
+    }
+#pragma omp single
+    n = omp_get_num_threads();
+  }
+  known_threads = n;
+
+  fprintf(f, "%d threads, %d NUMA nodes:", n, aff_num_nodes());
+  for (t=0; t<n && t<MAXTHREADS; t++) {
+    if (t % 8 == 0) fprintf(f, "\n ");
+    fprintf(f, " %3d: cpu %3d node %d", t, cpu[t], thread_node[t]);
+  }
+  fprintf(f, "\n");
+}
+
+void aff_first_touch(double *x, long n) {
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++) x[i] = 0.0;
+}
+
+double *aff_alloc(long n) {
+  double *x = (double *) malloc(n*sizeof(double));
+
+  if (x != NULL) aff_first_touch(x, n);
+  return x;
+}
+
+void aff_page_report(FILE *f, const char *name, const void *p, long bytes) {
+#if defined(__linux__) && defined(SYS_move_pages)
+  long pagesize = sysconf(_SC_PAGESIZE), npages, k, page;
+  void *pages[SAMPLES];
+  int status[SAMPLES], count[MAXNODES], n, i, local = 0, known = 0, absent = 0, t;
+  char *first = (char *) ((size_t) p & ~(size_t) (pagesize-1));
+
+  npages = ((char *) p + bytes - first + pagesize - 1)/pagesize;
+  n = npages < SAMPLES ? (int) npages : SAMPLES;
+  for (i=0; i<n; i++)
+    pages[i] = first + (npages*i/n)*pagesize;
+
+  /* With no target nodes, move_pages only tells where the pages are */
+  if (syscall(SYS_move_pages, 0, (unsigned long) n, pages, NULL, status, 0) != 0) {
+    fprintf(f, "%s: move_pages failed\n", name);
+    return;
+  }
+
+  memset(count, 0, sizeof(count));
+  for (i=0; i<n; i++) {
+    if (status[i] < 0 || status[i] >= MAXNODES) {
+      absent++;
+      continue;
+    }
+    count[status[i]]++;
+    /* The thread that has this page in a static schedule */
+    if (known_threads > 0) {
+      page = npages*i/n;
+      t = (int) (page*known_threads/npages);
+      known++;
+      if (thread_node[t] == status[i]) local++;
+    }
+  }
+
+  fprintf(f, "%s: %ld pages,", name, npages);
+  for (k=0; k<MAXNODES; k++)
+    if (count[k] > 0) fprintf(f, " node %ld %.1f%%", k, 100.0*count[k]/n);
+  if (absent > 0) fprintf(f, " not in memory %.1f%%", 100.0*absent/n);
+  if (known > 0) fprintf(f, ", %.1f%% local to the thread using it", 100.0*local/known);
+  fprintf(f, "\n");
+#else
+  fprintf(f, "%s: the page report needs Linux\n", name);
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/*
+  Helpers for running OpenMP programs well on machines with several
+  NUMA nodes, for example two sockets that each have their own memory.
+
+  Linux puts a page of memory on the node of the thread that first
+  writes to it (first touch), not where malloc was called. If one thread
+  initializes an array that all threads later work on, the whole array
+  is on one node, and the threads on the other nodes read it over the
+  slower link between the sockets. So an array should be initialized in
+  parallel with the same schedule as the loops that use it, usually
+  schedule(static), and each thread then finds its part in local memory.
+  This only helps if the threads stay on the same cores, so they should
+  also be bound to them.
+
+  Threads can be bound with the environment variables OMP_PROC_BIND and
+  OMP_PLACES (OpenMP 4.0), for example OMP_PROC_BIND=spread
+  OMP_PLACES=cores. If they are not set, aff_pin_threads binds thread t
+  of the parallel regions to one CPU with sched_setaffinity. The runtime
+  keeps the same threads between parallel regions, so the binding lasts
+  as long as the number of threads is not changed.
+
+  aff_page_report asks the kernel with move_pages where the pages of an
+  array are, and how many of them are on the node of the thread that
+  uses them in a static schedule.
+
+  Binding and the page report only work on Linux. On other systems the
+  functions do nothing, and the report says so.
+*/
+
+#include <stdio.h>
+
+#define AFF_COMPACT 0       /* Threads on neighbouring CPUs */
+#define AFF_SPREAD 1        /* Threads spread over the NUMA nodes */
+
+/* Number of NUMA nodes, and the node of a CPU */
+int aff_num_nodes(void);
+int aff_cpu_node(int cpu);
+
+/* Is the binding set with OMP_PROC_BIND, OMP_PLACES or GOMP_CPU_AFFINITY? */
+int aff_bound_by_env(void);
+
+/* Bind the threads of the next parallel regions, unless the environment
+   does it. Returns 1 if the threads were bound here */
+int aff_pin_threads(int policy);
+
+/* Print the CPU and node of every thread */
+void aff_report_threads(FILE *f);
+
+/* Allocate n doubles and write zeros to them in parallel with
+   schedule(static), so that the pages are placed where the threads of
+   static loops over the array run */
+double *aff_alloc(long n);
+void aff_first_touch(double *x, long n);
+
+/* Print on which nodes the pages of the array are */
+void aff_page_report(FILE *f, const char *name, const void *p, long bytes);
+
+#endif
@@ -0,0 +1,250 @@
+#include <omp.h>
+#include <stdlib.h>
+#include "arena.h"
+
+struct arena_block {
+  arena_block *next;            /* Older block in the chain, or next free block */
+  arena_block *prev;            /* Newer block in the chain */
+  arena *owner;
+  char *data;                   /* Start of the memory, aligned to 16 bytes */
+  size_t size, used;            /* Bytes of memory, and bytes handed out */
+  long allocs;                  /* Objects handed out, changed by the owner */
+  long freed;                   /* Objects freed, changed atomically */
+};
+
+struct arena {
+  arena_block *chain;           /* Blocks in use, newest first */
+  arena_block *cur;             /* Block that small objects come from */
+  arena_block *free;            /* Blocks that can be used again */
+  arena_block *floor_block;     /* Below floor in this block is the open region */
+  size_t floor;
+  int depth;                    /* Open regions */
+  size_t footprint;
+  size_t large;                 /* Bytes of large objects since the last reclaim */
+};
+
+/* In front of every object. size is the bytes of the object with the
+   header, so the objects of a block can be walked through */
+typedef union {
+  struct {
+    arena_block *block;
+    unsigned int size;
+    int freed;
+  } h;
+  double align[2];
+} header;
+
+static arena *my_arena = NULL;
+#pragma omp threadprivate(my_arena)
+
+static arena *get_arena(void) {
+  if (my_arena == NULL)
+    my_arena = (arena *) calloc(1, sizeof(arena));
+  return my_arena;
+}
+
+static arena_block *new_block(arena *a, size_t size) {
+  arena_block *b = (arena_block *) malloc(sizeof(arena_block) + 15 + size);
+
+  if (b == NULL) return NULL;
+  b->owner = a;
+  b->data = (char *) (((size_t) (b+1) + 15) & ~(size_t) 15);
+  b->size = size;
+  b->used = 0;
+  b->allocs = 0;
+  b->freed = 0;
+  a->footprint += size;
+  return b;
+}
+
+static void push_chain(arena *a, arena_block *b) {
+  b->next = a->chain;
+  b->prev = NULL;
+  if (a->chain != NULL) a->chain->prev = b;
+  a->chain = b;
+}
+
+static void unlink_chain(arena *a, arena_block *b) {
+  if (b->prev != NULL) b->prev->next = b->next;
+  else a->chain = b->next;
+  if (b->next != NULL) b->next->prev = b->prev;
+}
+
+/* Blocks of ARENA_BLOCK bytes go to the free list, larger ones back to
+   malloc */
+static void recycle(arena *a, arena_block *b) {
+  if (b->size != ARENA_BLOCK) {
+    a->footprint -= b->size;
+    free(b);
+    return;
+  }
+  b->used = 0;
+  b->allocs = 0;
+  b->freed = 0;
+  b->next = a->free;
+  a->free = b;
+}
+
+/* Take the blocks whose objects are all freed out of the chain. The
+   counter is read atomically since other threads may be adding to it,
+   but once it is equal to allocs no more frees can come */
+static void reclaim(arena *a) {
+  arena_block *b = a->chain, *next;
+
+  for (; b != NULL; b = next) {
+    next = b->next;
+    if (__sync_fetch_and_add(&b->freed, 0) == b->allocs) {
+      unlink_chain(a, b);
+      if (b == a->cur) a->cur = NULL;
+      recycle(a, b);
+    }
+  }
+  a->large = 0;
+}
+
+void *arena_alloc(size_t size) {
+  arena *a = get_arena();
+  size_t need = sizeof(header) + ((size + 15) & ~(size_t) 15);
+  arena_block *b;
+  header *hdr;
+
+  if (a == NULL) return NULL;
+  if (size > ARENA_BLOCK/4) {
+    /* A block of its own. Large objects freed by other threads are found
+       when they add up to half of the arena */
+    a->large += need;
+    if (a->depth == 0 && a->large > a->footprint/2) reclaim(a);
+    if ((b = new_block(a, need)) == NULL) return NULL;
+    push_chain(a, b);
+  }
+  else {
+    b = a->cur;
+    if (b == NULL || b->used + need > b->size) {
+      if (a->depth == 0) reclaim(a);
+      if (a->free != NULL) {
+	b = a->free;
+	a->free = b->next;
+      }
+      else if ((b = new_block(a, ARENA_BLOCK)) == NULL)
+	return NULL;
+      push_chain(a, b);
+      a->cur = b;
+    }
+  }
+
+  hdr = (header *) (b->data + b->used);
+  hdr->h.block = b;
+  hdr->h.size = (unsigned int) (b == a->cur ? need : 0);
+  hdr->h.freed = 0;
+  b->used += need;
+  b->allocs++;
+  return hdr+1;
+}
+
+void arena_free(void *p) {
+  header *hdr = (header *) p - 1;
+  arena_block *b;
+  arena *a = my_arena;
+
+  if (p == NULL) return;
+  b = hdr->h.block;
+  if (b->owner == a) {
+    /* The latest object in the current block, if it is not in a region
+       that is open */
+    if (b == a->cur && (char *) hdr + hdr->h.size == b->data + b->used &&
+	(b != a->floor_block || (size_t) ((char *) hdr - b->data) >= a->floor)) {
+      b->used -= hdr->h.size;
+      b->allocs--;
+      return;
+    }
+    /* A large object goes back to malloc at once */
+    if (b->size != ARENA_BLOCK && a->depth == 0) {
+      unlink_chain(a, b);
+      recycle(a, b);
+      return;
+    }
+  }
+  hdr->h.freed = 1;
+  __sync_fetch_and_add(&b->freed, 1);
+}
+
+arena_mark_t arena_mark(void) {
+  arena *a = get_arena();
+  arena_mark_t m;
+
+  m.head = a->chain;
+  m.block = a->cur;
+  m.used = a->cur != NULL ? a->cur->used : 0;
+  m.allocs = a->cur != NULL ? a->cur->allocs : 0;
+  m.floor_block = a->floor_block;
+  m.floor = a->floor;
+  a->floor_block = a->cur;
+  a->floor = m.used;
+  a->depth++;
+  return m;
+}
+
+void arena_release(arena_mark_t *m) {
+  arena *a = get_arena();
+  arena_block *b;
+  header *hdr;
+  long n = 0;
+  size_t pos;
+
+  /* The blocks that were started in the region */
+  while (a->chain != m->head) {
+    b = a->chain;
+    unlink_chain(a, b);
+    recycle(a, b);
+  }
+
+  /* The rest of the block that was current at the mark. Objects in it
+     that were freed one by one must not be counted twice */
+  if ((b = m->block) != NULL) {
+    for (pos=m->used; pos<b->used; pos+=hdr->h.size) {
+      hdr = (header *) (b->data + pos);
+      if (hdr->h.freed) n++;
+    }
+    if (n > 0) __sync_fetch_and_sub(&b->freed, n);
+    b->used = m->used;
+    b->allocs = m->allocs;
+  }
+  a->cur = m->block;
+  a->floor_block = m->floor_block;
+  a->floor = m->floor;
+  a->depth--;
+}
+
+size_t arena_trim(void) {
+  arena *a = my_arena;
+  arena_block *b;
+
+  if (a == NULL) return 0;
+  if (a->depth == 0) reclaim(a);
+  while ((b = a->free) != NULL) {
+    a->free = b->next;
+    a->footprint -= b->size;
+    free(b);
+  }
+  return a->footprint;
+}
+
+size_t arena_footprint(void) {
+  return my_arena != NULL ? my_arena->footprint : 0;
+}
+
+void arena_destroy(void) {
+  arena_block *b;
+
+  if (my_arena == NULL) return;
+  while ((b = my_arena->chain) != NULL) {
+    my_arena->chain = b->next;
+    free(b);
+  }
+  while ((b = my_arena->free) != NULL) {
+    my_arena->free = b->next;
+    free(b);
+  }
+  free(my_arena);
+  my_arena = NULL;
+}
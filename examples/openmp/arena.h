@@ -0,0 +1,72 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+  A memory allocator with one arena per thread, for the small temporary
+  buffers that the iterations of parallel loops need.
+
+  malloc has to be safe when many threads call it at the same time, and
+  its bookkeeping is shared between the threads, so a loop where all
+  threads allocate and free a lot can spend its time waiting for the
+  allocator. Here every thread has its own arena in a threadprivate
+  variable. An arena hands out memory from blocks of ARENA_BLOCK bytes
+  by moving a pointer forward (bump allocation), without locks, and
+  objects larger than ARENA_BLOCK/4 get a block of their own.
+
+  The memory can be given back in two ways:
+
+    regions   arena_mark saves the position of the arena, and
+              arena_release gives back everything allocated after it at
+              once. Regions can be nested, and objects allocated in a
+              region must not be used after it
+    free      arena_free gives back one object, from any thread. A block
+              is used again when all its objects are freed. The latest
+              object of the thread that owns the arena is freed at once,
+              so a buffer freed right after use costs nothing
+
+  A free from another thread is one atomic addition to a counter in the
+  block, and the owner checks the counters when it needs a new block,
+  or when arena_trim is called. Blocks are only checked outside of
+  regions, and freed blocks are kept for later use until arena_trim.
+
+  The arena of a thread stays as long as the thread, so OpenMP must
+  keep the same threads between parallel regions, which it does when
+  the number of threads is not changed and omp_set_dynamic is off.
+*/
+
+#include <stddef.h>
+
+#define ARENA_BLOCK (256*1024)  /* Bytes in a block */
+
+typedef struct arena_block arena_block;
+typedef struct arena arena;
+
+typedef struct {
+  arena_block *head, *block, *floor_block;
+  size_t used, floor;
+  long allocs;
+} arena_mark_t;
+
+/* Allocate size bytes, aligned to 16 bytes, in the arena of the calling
+   thread. Returns NULL if there is no memory */
+void *arena_alloc(size_t size);
+
+/* Give back an object, from any thread */
+void arena_free(void *p);
+
+/* Start and end a region in the arena of the calling thread */
+arena_mark_t arena_mark(void);
+void arena_release(arena_mark_t *m);
+
+/* Bytes in the blocks of the calling thread */
+size_t arena_footprint(void);
+
+/* Give the blocks of the calling thread whose objects are all freed back
+   to malloc. Returns the bytes that are left */
+size_t arena_trim(void);
+
+/* Free all the blocks of the calling thread. No objects of the arena may
+   be used after this */
+void arena_destroy(void);
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+/*
+  Data parallel primitives for C++ with OpenMP, the inner loops of
+  queries on columns of data:
+
+    par_filter        copy the elements for which a predicate is true,
+                      in their order (stream compaction)
+    par_filter_index  the indices of those elements (a selection vector)
+    par_partition     copy the elements for which the predicate is true,
+                      followed by the others, both in their order (a
+                      stable partition)
+    par_gather        out[i] = in[idx[i]]
+    par_scatter       out[idx[i]] = in[i]
+
+  A filter does not know where an element goes before the elements in
+  front of it have been counted, so it is done in two passes over the
+  array. Every thread first counts the true elements in its slice of the
+  array. A scan of the counts of the threads gives each thread the place
+  in the output where its elements go, and in the second pass the
+  threads copy them there. The slices are the same in both passes.
+
+  The predicate is a function object that is inlined, so the compiler
+  can evaluate it with vector instructions. In the second pass it is
+  evaluated for a chunk of COMPACT_CHUNK elements at a time into an
+  array of flags, and the elements are then copied without branches to
+  a buffer on the stack, which is copied to the output. Writing directly
+  to the output without branches could write past the end of the
+  thread's part of it.
+
+  The elements must be plain data that can be copied with =.
+*/
+
+#include <omp.h>
+#include <vector>
+#include <algorithm>
+
+#define COMPACT_CHUNK 1024
+
+/* Slice of thread t of p */
+inline void compact_slice(long n, int t, int p, long *lo, long *hi) {
+  *lo = n*t/p;
+  *hi = n*(t+1)/p;
+}
+
+template <class T, class Pred>
+inline long compact_count(const T *in, long lo, long hi, Pred pred) {
+  long i, k = 0;
+
+#if _OPENMP >= 201307
+#pragma omp simd reduction(+:k)
+#endif
+  for (i=lo; i<hi; i++)
+    k += pred(in[i]) ? 1 : 0;
+  return k;
+}
+
+template <class T, class Pred>
+inline void compact_flags(const T *in, long m, Pred pred, unsigned char *flag) {
+  long i;
+
+#if _OPENMP >= 201307
+#pragma omp simd
+#endif
+  for (i=0; i<m; i++)
+    flag[i] = pred(in[i]) ? 1 : 0;
+}
+
+/* Exclusive scan of the counts of p threads in count[1..p], done by one
+   thread. Returns the total */
+inline long compact_scan(long *count, int p) {
+  int t;
+
+  count[0] = 0;
+  for (t=1; t<=p; t++) count[t] += count[t-1];
+  return count[p];
+}
+
+template <class T, class Pred>
+long par_filter(const T *in, long n, T *out, Pred pred) {
+  std::vector<long> count(omp_get_max_threads()+1);
+  long total = 0;
+
+#pragma omp parallel
+  {
+    int t = omp_get_thread_num(), p = omp_get_num_threads();
+    unsigned char flag[COMPACT_CHUNK];
+    T buf[COMPACT_CHUNK];
+    long lo, hi, i, j, m, k, pos;
+
+    compact_slice(n, t, p, &lo, &hi);
+    count[t+1] = compact_count(in, lo, hi, pred);
+#pragma omp barrier
+#pragma omp single
+    total = compact_scan(&count[0], p);
+
+    pos = count[t];
+    for (i=lo; i<hi; i+=COMPACT_CHUNK) {
+      m = std::min((long) COMPACT_CHUNK, hi-i);
+      compact_flags(in+i, m, pred, flag);
+      for (j=0, k=0; j<m; j++) {
+	buf[k] = in[i+j];
+	k += flag[j];
+      }
+      std::copy(buf, buf+k, out+pos);
+      pos += k;
+    }
+  }
+  return total;
+}
+
+template <class T, class Pred>
+long par_filter_index(const T *in, long n, long *idx, Pred pred) {
+  std::vector<long> count(omp_get_max_threads()+1);
+  long total = 0;
+
+#pragma omp parallel
+  {
+    int t = omp_get_thread_num(), p = omp_get_num_threads();
+    unsigned char flag[COMPACT_CHUNK];
+    long buf[COMPACT_CHUNK];
+    long lo, hi, i, j, m, k, pos;
+
+    compact_slice(n, t, p, &lo, &hi);
+    count[t+1] = compact_count(in, lo, hi, pred);
+#pragma omp barrier
+#pragma omp single
+    total = compact_scan(&count[0], p);
+
+    pos = count[t];
+    for (i=lo; i<hi; i+=COMPACT_CHUNK) {
+      m = std::min((long) COMPACT_CHUNK, hi-i);
+      compact_flags(in+i, m, pred, flag);
+      for (j=0, k=0; j<m; j++) {
+	buf[k] = i+j;
+	k += flag[j];
+      }
+      std::copy(buf, buf+k, idx+pos);
+      pos += k;
+    }
+  }
+  return total;
+}
+
+/* Returns the number of elements for which pred is true */
+template <class T, class Pred>
+long par_partition(const T *in, long n, T *out, Pred pred) {
+  std::vector<long> count(omp_get_max_threads()+1);
+  long total = 0;
+
+#pragma omp parallel
+  {
+    int t = omp_get_thread_num(), p = omp_get_num_threads();
+    unsigned char flag[COMPACT_CHUNK];
+    T yes[COMPACT_CHUNK], no[COMPACT_CHUNK];
+    long lo, hi, i, j, m, ky, kn, pos, neg;
+
+    compact_slice(n, t, p, &lo, &hi);
+    count[t+1] = compact_count(in, lo, hi, pred);
+#pragma omp barrier
+#pragma omp single
+    total = compact_scan(&count[0], p);
+
+    /* The false elements of thread t go after all the true ones and the
+       false ones of the threads before t */
+    pos = count[t];
+    neg = total + lo - count[t];
+    for (i=lo; i<hi; i+=COMPACT_CHUNK) {
+      m = std::min((long) COMPACT_CHUNK, hi-i);
+      compact_flags(in+i, m, pred, flag);
+      for (j=0, ky=0, kn=0; j<m; j++) {
+	yes[ky] = in[i+j];
+	no[kn] = in[i+j];
+	ky += flag[j];
+	kn += 1 - flag[j];
+      }
+      std::copy(yes, yes+ky, out+pos);
+      std::copy(no, no+kn, out+neg);
+      pos += ky;
+      neg += kn;
+    }
+  }
+  return total;
+}
+
+template <class T>
+void par_gather(const T *in, const long *idx, long n, T *out) {
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++)
+    out[i] = in[idx[i]];
+}
+
+/* The indices must all be different, or several threads may write the
+   same element */
+template <class T>
+void par_scatter(const T *in, const long *idx, long n, T *out) {
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++)
+    out[idx[i]] = in[i];
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include <omp.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dataflow.h"
+
+#define TOKEN(p, s, c) (&(p)->tokens[(long)(c)*(p)->nstages + (s)])
+#define IDX(p, s, c) ((long)(s)*(p)->nchunks + (c))
+
+df_pipeline *df_create(int nchunks, int nbuffers) {
+  df_pipeline *p;
+
+  if (nchunks < 1 || nbuffers < 0) return NULL;
+  p = (df_pipeline *) calloc(1, sizeof(df_pipeline));
+  p->nchunks = nchunks;
+  p->nbuffers = nbuffers;
+  return p;
+}
+
+int df_stage(df_pipeline *p, const char *name, df_func func, void *arg,
+	     int serial, int nin, const int *in) {
+  df_stage_t *st;
+  int k;
+
+  if (p->nstages >= DF_MAXSTAGES || nin < 0 || nin > DF_MAXIN) return -1;
+  for (k=0; k<nin; k++)
+    if (in[k] < 0 || in[k] >= p->nstages) return -1;
+
+  st = &p->stages[p->nstages];
+  strncpy(st->name, name, sizeof(st->name)-1);
+  st->func = func;
+  st->arg = arg;
+  st->serial = serial;
+  st->nin = nin;
+  for (k=0; k<nin; k++) st->in[k] = in[k];
+  return p->nstages++;
+}
+
+/* The tasks that task (s, c) waits for, as (stage, chunk) pairs. Returns
+   the number of them */
+static int predecessors(df_pipeline *p, int s, int c, int *ps, int *pc) {
+  df_stage_t *st = &p->stages[s];
+  int k, n = 0;
+
+  for (k=0; k<st->nin; k++) {
+    ps[n] = st->in[k];
+    pc[n++] = c;
+  }
+  if (st->serial && c > 0) {
+    ps[n] = s;
+    pc[n++] = c-1;
+  }
+  if (st->nin == 0 && p->nbuffers > 0 && c >= p->nbuffers) {
+    ps[n] = p->nstages-1;
+    pc[n++] = c - p->nbuffers;
+  }
+  return n;
+}
+
+static void run_task(df_pipeline *p, int s, int c) {
+  long i = IDX(p, s, c);
+
+  p->start[i] = omp_get_wtime() - p->t0;
+  p->stages[s].func(c, p->stages[s].arg);
+  p->end[i] = omp_get_wtime() - p->t0;
+  p->thread[i] = omp_get_thread_num();
+}
+
+#if _OPENMP >= 201307
+/* Create the task for stage s of chunk c. The inputs that are not used
+   point to p->none, which no task writes */
+static void submit(df_pipeline *p, int s, int c) {
+  int ps[DF_MAXIN+2], pc[DF_MAXIN+2], n, k;
+  char *in[DF_MAXIN+2], *i0, *i1, *i2, *i3, *i4, *i5, *out;
+
+  n = predecessors(p, s, c, ps, pc);
+  for (k=0; k<DF_MAXIN+2; k++)
+    in[k] = k < n ? TOKEN(p, ps[k], pc[k]) : &p->none;
+  i0 = in[0]; i1 = in[1]; i2 = in[2]; i3 = in[3]; i4 = in[4]; i5 = in[5];
+  out = TOKEN(p, s, c);
+
+#pragma omp task firstprivate(p, s, c) depend(in: *i0, *i1, *i2, *i3, *i4, *i5) depend(out: *out)
+  run_task(p, s, c);
+}
+#endif
+
+/* Does stage s reach the last stage through the stages that read it? */
+static int reaches_last(df_pipeline *p, int s) {
+  int t, k;
+
+  if (s == p->nstages-1) return 1;
+  for (t=s+1; t<p->nstages; t++)
+    for (k=0; k<p->stages[t].nin; k++)
+      if (p->stages[t].in[k] == s && reaches_last(p, t)) return 1;
+  return 0;
+}
+
+int df_run(df_pipeline *p) {
+  long n = (long)p->nstages*p->nchunks;
+  int s, c;
+
+  if (p->nstages == 0) return 0;
+  if (p->nbuffers > 0)
+    for (s=0; s<p->nstages; s++)
+      if (!reaches_last(p, s)) return -1;
+
+  free(p->tokens); free(p->start); free(p->end); free(p->thread);
+  p->tokens = (char *) calloc(n, 1);
+  p->start = (double *) calloc(n, sizeof(double));
+  p->end = (double *) calloc(n, sizeof(double));
+  p->thread = (int *) calloc(n, sizeof(int));
+
+  p->t0 = omp_get_wtime();
+#pragma omp parallel private(s, c)
+  {
+#pragma omp single
+    {
+      p->nthreads = omp_get_num_threads();
+#if _OPENMP >= 201307
+      /* One thread creates the tasks chunk by chunk, the others start
+	 running them at once */
+      for (c=0; c<p->nchunks; c++)
+	for (s=0; s<p->nstages; s++)
+	  submit(p, s, c);
+#else
+      for (c=0; c<p->nchunks; c++)
+	for (s=0; s<p->nstages; s++)
+	  run_task(p, s, c);
+#endif
+    }
+  }
+  p->wall = omp_get_wtime() - p->t0;
+  return 0;
+}
+
+void df_report(df_pipeline *p, FILE *f) {
+  int ps[DF_MAXIN+2], pc[DF_MAXIN+2], n, k, s, c, bs = 0, bc = 0, *from;
+  double *cp, busy, total = 0.0, d, longest = 0.0, *onpath;
+  long i;
+
+  /* Longest path ending at each task. The tasks only depend on tasks of
+     earlier chunks or earlier stages, so this order works */
+  cp = (double *) malloc((long)p->nstages*p->nchunks*sizeof(double));
+  from = (int *) malloc((long)p->nstages*p->nchunks*sizeof(int));
+  for (c=0; c<p->nchunks; c++)
+    for (s=0; s<p->nstages; s++) {
+      i = IDX(p, s, c);
+      d = 0.0;
+      from[i] = -1;
+      n = predecessors(p, s, c, ps, pc);
+      for (k=0; k<n; k++)
+	if (cp[IDX(p, ps[k], pc[k])] > d) {
+	  d = cp[IDX(p, ps[k], pc[k])];
+	  from[i] = (int) IDX(p, ps[k], pc[k]);
+	}
+      cp[i] = d + p->end[i] - p->start[i];
+      if (cp[i] > longest) {
+	longest = cp[i];
+	bs = s;
+	bc = c;
+      }
+    }
+
+  /* Time of each stage on the critical path */
+  onpath = (double *) calloc(p->nstages, sizeof(double));
+  for (i=IDX(p, bs, bc); i>=0; i=from[i])
+    onpath[i/p->nchunks] += p->end[i] - p->start[i];
+
+  fprintf(f, "%d chunks, %d threads, %.3f s\n", p->nchunks, p->nthreads, p->wall);
+  fprintf(f, "%-12s %6s %10s %10s %8s %14s\n", "stage", "tasks", "busy s",
+	  "ms/task", "of wall", "critical path");
+  for (s=0; s<p->nstages; s++) {
+    busy = 0.0;
+    for (c=0; c<p->nchunks; c++)
+      busy += p->end[IDX(p, s, c)] - p->start[IDX(p, s, c)];
+    total += busy;
+    fprintf(f, "%-12s %6d %10.3f %10.3f %7.1f%% %12.3f s\n", p->stages[s].name,
+	    p->nchunks, busy, busy/p->nchunks*1e3, 100.0*busy/p->wall, onpath[s]);
+  }
+  fprintf(f, "Threads busy %.1f%% of the time\n", 100.0*total/(p->wall*p->nthreads));
+  fprintf(f, "Critical path %.3f s, total work %.3f s, so at most %.1f threads can be used\n",
+	  longest, total, total/longest);
+
+  free(cp); free(from); free(onpath);
+}
+
+void df_free(df_pipeline *p) {
+  if (p == NULL) return;
+  free(p->tokens); free(p->start); free(p->end); free(p->thread);
+  free(p);
+}
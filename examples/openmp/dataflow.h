@@ -0,0 +1,84 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+/*
+  A small dataflow engine on top of OpenMP tasks with depend clauses.
+
+  A pipeline processes a stream of chunks of data in stages. Each stage
+  is a function that is called once for every chunk, and can read the
+  results of earlier stages for the same chunk. For example
+
+    read       reads chunk c from a file
+    transform  computes something for every element of chunk c
+    reduce     adds the results of chunk c to a total
+
+  A stage is declared with the earlier stages it reads from. A serial
+  stage also waits for itself on the previous chunk, so it is called for
+  the chunks in order, one at a time, for example for reading a file or
+  for adding to a total in a fixed order. Every call becomes a task, and
+  OpenMP starts it as soon as the tasks it depends on are done. So while
+  chunk c is transformed, chunk c+1 can be read and chunk c-1 reduced,
+  and transforms of different chunks run at the same time. The sections
+  construct in omp_sections.c cannot do this, since each section is one
+  piece of code from start to end.
+
+  With nbuffers > 0 the chunks use that many buffers in turn: chunk c
+  uses buffer c % nbuffers, and no stage that reads from no other stage
+  is started on chunk c before the last stage of chunk c - nbuffers is
+  done. The other stages of chunk c come after one of those. The last
+  stage must then depend on all the others, directly or through other
+  stages, which df_run checks.
+
+  df_run records when each task ran and on which thread. df_report prints
+  for each stage the busy time and its share of the elapsed time, and the
+  critical path: the longest chain of dependent tasks, which is the
+  shortest time the pipeline could take with any number of threads.
+
+  Without OpenMP 4.0 there is no depend clause, and df_run calls the
+  stages one chunk at a time.
+*/
+
+#include <stdio.h>
+
+#define DF_MAXSTAGES 16
+#define DF_MAXIN 4              /* Stages a stage can read from */
+
+typedef void (*df_func)(int chunk, void *arg);
+
+typedef struct {
+  char name[32];
+  df_func func;
+  void *arg;
+  int serial;
+  int nin;
+  int in[DF_MAXIN];
+} df_stage_t;
+
+typedef struct {
+  int nchunks, nbuffers, nstages, nthreads;
+  df_stage_t stages[DF_MAXSTAGES];
+  char *tokens;                 /* One per stage and chunk, for depend */
+  char none;                    /* For the unused inputs of a task */
+  double t0, wall;
+  double *start, *end;          /* Times of the tasks, stage*nchunks+chunk */
+  int *thread;
+} df_pipeline;
+
+/* A pipeline for nchunks chunks, using nbuffers buffers in turn, or 0
+   if every chunk has its own memory */
+df_pipeline *df_create(int nchunks, int nbuffers);
+
+/* Add a stage that reads the results of the nin stages in[]. Returns the
+   number of the stage, or -1 if the arguments are wrong */
+int df_stage(df_pipeline *p, const char *name, df_func func, void *arg,
+	     int serial, int nin, const int *in);
+
+/* Run the pipeline with the threads of a new parallel region. Returns 0,
+   or -1 if the last stage does not depend on all the others when the
+   buffers are reused */
+int df_run(df_pipeline *p);
+
+void df_report(df_pipeline *p, FILE *f);
+void df_free(df_pipeline *p);
+
+#endif
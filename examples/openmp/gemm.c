@@ -0,0 +1,326 @@
+#include <omp.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "gemm.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define MR 8
+#define NR 16
+#define KERNEL "AVX-512 FMA 8x16"
+#define FLOPS 32
+#elif defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define MR 6
+#define NR 8
+#define KERNEL "AVX2 FMA 6x8"
+#define FLOPS 16
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define MR 4
+#define NR 8
+#define KERNEL "AVX 4x8"
+#define FLOPS 8
+#else
+#define MR 4
+#define NR 4
+#define KERNEL "C 4x4"
+#define FLOPS 4
+#endif
+
+static gemm_params params;
+static int params_set = 0;
+
+/* Size in bytes of the data cache at the given level, or 0 */
+static long cache_size(int level) {
+  long s = 0;
+
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+  if (level == 1) s = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  else if (level == 2) s = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  else s = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  return s > 0 ? s : 0;
+}
+
+static int round_to(int x, int m, int lo, int hi) {
+  x -= x % m;
+  if (x < lo) x = lo;
+  if (x > hi) x = hi;
+  return x;
+}
+
+void gemm_default_params(gemm_params *p) {
+  gemm_cache_params(p, cache_size(1), cache_size(2), cache_size(3));
+}
+
+void gemm_cache_params(gemm_params *p, long l1, long l2, long l3) {
+  if (l1 == 0) l1 = 32*1024;
+  if (l2 == 0) l2 = 256*1024;
+  if (l3 == 0) l3 = 8*1024*1024;
+
+  /* A strip of B in 3/4 of L1, leaving room for a strip of A, a block
+     of A in half of L2 and a panel of B in half of L3 */
+  p->kc = round_to((int) (l1*3/4/(NR*sizeof(double))), 8, 128, 512);
+  p->mc = round_to((int) (l2/2/(p->kc*sizeof(double))), MR, MR, 4096);
+  p->nc = round_to((int) (l3/2/(p->kc*sizeof(double))), NR, NR, 8192);
+}
+
+void gemm_set_params(const gemm_params *p) {
+  params.mc = round_to(p->mc, MR, MR, 1<<20);
+  params.kc = p->kc < 1 ? 1 : p->kc;
+  params.nc = round_to(p->nc, NR, NR, 1<<20);
+  params_set = 1;
+}
+
+void gemm_get_params(gemm_params *p) {
+  if (!params_set) {
+    gemm_default_params(&params);
+    params_set = 1;
+  }
+  *p = params;
+}
+
+const char *gemm_kernel_name(void) { return KERNEL; }
+int gemm_mr(void) { return MR; }
+int gemm_nr(void) { return NR; }
+int gemm_flops_per_cycle(void) { return FLOPS; }
+
+/* Memory aligned to 64 bytes, the cache line size. The pointer to free
+   is returned in base */
+static double *alloc_aligned(size_t n, void **base) {
+  *base = malloc(n*sizeof(double) + 64);
+  return (double *) (((size_t) *base + 63) & ~(size_t) 63);
+}
+
+/* Copy an mc x kc block of A into strips of MR rows. In a strip the MR
+   elements of a column are next to each other. Rows below the matrix
+   are filled with zeros */
+static void pack_a(int mc, int kc, const double *a, int lda, double *buf) {
+  int i, ii, p, rows;
+
+  for (ii=0; ii<mc; ii+=MR) {
+    rows = mc - ii < MR ? mc - ii : MR;
+    for (i=0; i<rows; i++)
+      for (p=0; p<kc; p++)
+	buf[p*MR+i] = a[(long)(ii+i)*lda+p];
+    for (; i<MR; i++)
+      for (p=0; p<kc; p++)
+	buf[p*MR+i] = 0.0;
+    buf += MR*kc;
+  }
+}
+
+/* Copy a kc x nr strip of B, nr <= NR, so that the NR elements of a row
+   are next to each other */
+static void pack_b(int kc, int nr, const double *b, int ldb, double *buf) {
+  int j, p;
+
+  for (p=0; p<kc; p++) {
+    for (j=0; j<nr; j++) buf[j] = b[(long)p*ldb+j];
+    for (; j<NR; j++) buf[j] = 0.0;
+    buf += NR;
+  }
+}
+
+/* The micro-kernel: C += alpha*A*B for an MR x NR tile of C, where A is
+   a packed MR x kc strip and B a packed kc x NR strip */
+#if defined(__AVX512F__)
+
+#define ROW(i) ai = _mm512_set1_pd(a[i]);		\
+  c##i##0 = _mm512_fmadd_pd(ai, b0, c##i##0);		\
+  c##i##1 = _mm512_fmadd_pd(ai, b1, c##i##1)
+#define STORE(i)							\
+  _mm512_storeu_pd(c+i*ldc, _mm512_fmadd_pd(al, c##i##0, _mm512_loadu_pd(c+i*ldc))); \
+  _mm512_storeu_pd(c+i*ldc+8, _mm512_fmadd_pd(al, c##i##1, _mm512_loadu_pd(c+i*ldc+8)))
+
+static void kernel(int kc, const double *a, const double *b, double *c,
+		   long ldc, double alpha) {
+  __m512d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51,
+    c60, c61, c70, c71, b0, b1, ai, al;
+  int p;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = c30 = c31 = _mm512_setzero_pd();
+  c40 = c41 = c50 = c51 = c60 = c61 = c70 = c71 = _mm512_setzero_pd();
+  for (p=0; p<kc; p++) {
+    b0 = _mm512_loadu_pd(b);
+    b1 = _mm512_loadu_pd(b+8);
+    ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5); ROW(6); ROW(7);
+    a += MR;
+    b += NR;
+  }
+  al = _mm512_set1_pd(alpha);
+  STORE(0); STORE(1); STORE(2); STORE(3); STORE(4); STORE(5); STORE(6); STORE(7);
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+#define ROW(i) ai = _mm256_broadcast_sd(&a[i]);		\
+  c##i##0 = _mm256_fmadd_pd(ai, b0, c##i##0);		\
+  c##i##1 = _mm256_fmadd_pd(ai, b1, c##i##1)
+#define STORE(i)							\
+  _mm256_storeu_pd(c+i*ldc, _mm256_fmadd_pd(al, c##i##0, _mm256_loadu_pd(c+i*ldc))); \
+  _mm256_storeu_pd(c+i*ldc+4, _mm256_fmadd_pd(al, c##i##1, _mm256_loadu_pd(c+i*ldc+4)))
+
+static void kernel(int kc, const double *a, const double *b, double *c,
+		   long ldc, double alpha) {
+  __m256d c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51,
+    b0, b1, ai, al;
+  int p;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = _mm256_setzero_pd();
+  c30 = c31 = c40 = c41 = c50 = c51 = _mm256_setzero_pd();
+  for (p=0; p<kc; p++) {
+    b0 = _mm256_loadu_pd(b);
+    b1 = _mm256_loadu_pd(b+4);
+    ROW(0); ROW(1); ROW(2); ROW(3); ROW(4); ROW(5);
+    a += MR;
+    b += NR;
+  }
+  al = _mm256_set1_pd(alpha);
+  STORE(0); STORE(1); STORE(2); STORE(3); STORE(4); STORE(5);
+}
+
+#elif defined(__AVX__)
+
+#define ROW(i) ai = _mm256_broadcast_sd(&a[i]);				\
+  c##i##0 = _mm256_add_pd(c##i##0, _mm256_mul_pd(ai, b0));		\
+  c##i##1 = _mm256_add_pd(c##i##1, _mm256_mul_pd(ai, b1))
+#define STORE(i)							\
+  _mm256_storeu_pd(c+i*ldc, _mm256_add_pd(_mm256_loadu_pd(c+i*ldc), _mm256_mul_pd(al, c##i##0))); \
+  _mm256_storeu_pd(c+i*ldc+4, _mm256_add_pd(_mm256_loadu_pd(c+i*ldc+4), _mm256_mul_pd(al, c##i##1)))
+
+static void kernel(int kc, const double *a, const double *b, double *c,
+		   long ldc, double alpha) {
+  __m256d c00, c01, c10, c11, c20, c21, c30, c31, b0, b1, ai, al;
+  int p;
+
+  c00 = c01 = c10 = c11 = c20 = c21 = c30 = c31 = _mm256_setzero_pd();
+  for (p=0; p<kc; p++) {
+    b0 = _mm256_loadu_pd(b);
+    b1 = _mm256_loadu_pd(b+4);
+    ROW(0); ROW(1); ROW(2); ROW(3);
+    a += MR;
+    b += NR;
+  }
+  al = _mm256_set1_pd(alpha);
+  STORE(0); STORE(1); STORE(2); STORE(3);
+}
+
+#else
+
+static void kernel(int kc, const double *a, const double *b, double *c,
+		   long ldc, double alpha) {
+  double t[MR*NR];
+  int i, j, p;
+
+  for (i=0; i<MR*NR; i++) t[i] = 0.0;
+  for (p=0; p<kc; p++) {
+    for (i=0; i<MR; i++)
+      for (j=0; j<NR; j++)
+	t[i*NR+j] += a[i]*b[j];
+    a += MR;
+    b += NR;
+  }
+  for (i=0; i<MR; i++)
+    for (j=0; j<NR; j++)
+      c[i*ldc+j] += alpha*t[i*NR+j];
+}
+
+#endif
+
+/* A tile at the edge of C, with mr <= MR rows and nr <= NR columns */
+static void edge_tile(int kc, const double *a, const double *b, double *c,
+		      long ldc, double alpha, int mr, int nr) {
+  double t[MR*NR];
+  int i, j;
+
+  for (i=0; i<MR*NR; i++) t[i] = 0.0;
+  kernel(kc, a, b, t, NR, alpha);
+  for (i=0; i<mr; i++)
+    for (j=0; j<nr; j++)
+      c[i*ldc+j] += t[i*NR+j];
+}
+
+void gemm(int m, int n, int k, double alpha, const double *a, int lda,
+	  const double *b, int ldb, double beta, double *c, int ldc) {
+  gemm_params p;
+  double *bbuf;
+  void *bbase;
+  int i, j;
+
+  if (m <= 0 || n <= 0) return;
+
+  /* C = beta*C first, then the products are added */
+  if (beta != 1.0) {
+#pragma omp parallel for private(j)
+    for (i=0; i<m; i++)
+      for (j=0; j<n; j++)
+	c[(long)i*ldc+j] = beta == 0.0 ? 0.0 : beta*c[(long)i*ldc+j];
+  }
+  if (k <= 0 || alpha == 0.0) return;
+
+  gemm_get_params(&p);
+  bbuf = alloc_aligned((size_t) p.kc*p.nc, &bbase);
+
+#pragma omp parallel
+  {
+    int jc, pc, ic, nc, kc, mc, jr, ir, t, ib, js, jp, jp0, jp1, packed;
+    int nthreads = omp_get_num_threads(), mblocks, nsplit, npanels, per;
+    double *abuf;
+    void *abase;
+
+    abuf = alloc_aligned((size_t) p.mc*p.kc, &abase);
+    for (jc=0; jc<n; jc+=p.nc) {
+      nc = n - jc < p.nc ? n - jc : p.nc;
+      npanels = (nc + NR - 1)/NR;
+      for (pc=0; pc<k; pc+=p.kc) {
+	kc = k - pc < p.kc ? k - pc : p.kc;
+
+	/* The threads pack the panel of B together */
+#pragma omp for schedule(static)
+	for (jp=0; jp<npanels; jp++) {
+	  jr = jp*NR;
+	  pack_b(kc, nc - jr < NR ? nc - jr : NR, &b[(long)pc*ldb+jc+jr], ldb,
+		 &bbuf[(long)jr*kc]);
+	}
+
+	/* Macro-tiles: a block of A times a part of the panel of B. The
+	   panel is split if there are fewer blocks than threads */
+	mblocks = (m + p.mc - 1)/p.mc;
+	nsplit = (nthreads + mblocks - 1)/mblocks;
+	per = (npanels + nsplit - 1)/nsplit;
+	packed = -1;
+#pragma omp for schedule(static)
+	for (t=0; t<mblocks*nsplit; t++) {
+	  ib = t/nsplit;
+	  js = t%nsplit;
+	  ic = ib*p.mc;
+	  mc = m - ic < p.mc ? m - ic : p.mc;
+	  jp0 = js*per;
+	  jp1 = jp0 + per < npanels ? jp0 + per : npanels;
+	  if (jp0 >= jp1) continue;
+	  if (packed != ib) {
+	    pack_a(mc, kc, &a[(long)ic*lda+pc], lda, abuf);
+	    packed = ib;
+	  }
+	  for (jp=jp0; jp<jp1; jp++) {
+	    jr = jp*NR;
+	    for (ir=0; ir<mc; ir+=MR) {
+	      if (mc - ir >= MR && nc - jr >= NR)
+		kernel(kc, &abuf[(long)ir*kc], &bbuf[(long)jr*kc],
+		       &c[(long)(ic+ir)*ldc+jc+jr], ldc, alpha);
+	      else
+		edge_tile(kc, &abuf[(long)ir*kc], &bbuf[(long)jr*kc],
+			  &c[(long)(ic+ir)*ldc+jc+jr], ldc, alpha,
+			  mc - ir < MR ? mc - ir : MR, nc - jr < NR ? nc - jr : NR);
+	    }
+	  }
+	}
+      }
+    }
+    free(abase);
+  }
+
+  free(bbase);
+}
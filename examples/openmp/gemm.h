@@ -0,0 +1,64 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+/*
+  Cache-blocked matrix multiplication C = alpha*A*B + beta*C for
+  matrices of doubles in row-major order, parallelized with OpenMP.
+
+  The multiplication is done in the same way as in BLIS and GotoBLAS.
+  B is divided into panels of KC x NC elements that are copied (packed)
+  into a buffer shared by the threads, so that the panel stays in the
+  L3 cache. A is divided into blocks of MC x KC elements that each
+  thread packs into its own buffer, which stays in the L2 cache. The
+  packed buffers are stored as narrow strips of MR rows of A and NR
+  columns of B, in the order the micro-kernel reads them, so that a
+  strip of B stays in the L1 cache while it is multiplied with all the
+  strips of the block of A.
+
+  The micro-kernel computes an MR x NR tile of C in vector registers.
+  Which kernel is used is decided when the program is compiled:
+
+    AVX-512        8 x 16 tile, FMA         (-mavx512f -mfma)
+    AVX2 + FMA     6 x 8 tile               (-mavx2 -mfma)
+    AVX            4 x 8 tile, mul and add  (-mavx)
+    other          4 x 4 tile in plain C
+
+  '-march=native' picks the best one for the machine.
+
+  The threads share the work of the blocks of A and, if there are fewer
+  blocks than threads, parts of the panel of B. The matrices can have
+  any size; the tiles at the edges are computed into a temporary tile.
+*/
+
+typedef struct {
+  int mc;               /* Rows of a block of A, multiple of MR */
+  int kc;               /* Columns of A and rows of B in a panel */
+  int nc;               /* Columns of a panel of B, multiple of NR */
+} gemm_params;
+
+/* Block sizes computed from the cache sizes of the machine, or fixed
+   defaults if they are not known */
+void gemm_default_params(gemm_params *p);
+
+/* Block sizes for caches of the given sizes in bytes, for example from
+   the machine profile of profile.h. A size of 0 is not known */
+void gemm_cache_params(gemm_params *p, long l1, long l2, long l3);
+
+/* Use other block sizes. They are rounded to the tile size */
+void gemm_set_params(const gemm_params *p);
+void gemm_get_params(gemm_params *p);
+
+/* The micro-kernel compiled in: its name, tile size and the number of
+   double precision operations per cycle and core it can do at most */
+const char *gemm_kernel_name(void);
+int gemm_mr(void);
+int gemm_nr(void);
+int gemm_flops_per_cycle(void);
+
+/* C = alpha*A*B + beta*C, where A is m x k, B is k x n and C is m x n.
+   lda, ldb and ldc are the lengths of the rows. Must be called outside
+   of a parallel region, the threads are started in the function */
+void gemm(int m, int n, int k, double alpha, const double *a, int lda,
+	  const double *b, int ldb, double beta, double *c, int ldc);
+
+#endif
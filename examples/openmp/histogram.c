@@ -0,0 +1,187 @@
+#include <omp.h>
+#include <stdlib.h>
+#include "histogram.h"
+
+#define TABLE (4*HIST_HOT)      /* Size of the hash table of hot bins */
+#define EMPTY 0xffffffffu
+
+static const char *names[HIST_NSTRATEGIES] = { "auto", "critical", "atomic", "private", "hybrid" };
+
+const char *hist_name(int strategy) {
+  return strategy >= 0 && strategy < HIST_NSTRATEGIES ? names[strategy] : "?";
+}
+
+static int compare_keys(const void *a, const void *b) {
+  unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* The hot bins in a sample of the keys, the largest first. The sample is
+   taken at steps of about 0.618 n, so that it does not follow a pattern
+   in the keys. Returns the number of hot bins, and the part of the
+   sample that falls in them in share */
+static int find_hot(const unsigned int *key, long n, unsigned int *hot, double *share) {
+  unsigned int sample[HIST_SAMPLE];
+  unsigned long step = (unsigned long) (n*0.6180339887) | 1, pos = 0;
+  long m = n < HIST_SAMPLE ? n : HIST_SAMPLE, i, j, run, sum = 0;
+  long count[HIST_HOT];
+  int nhot = 0, h;
+
+  for (i=0; i<m; i++) {
+    sample[i] = key[pos];
+    pos = (pos + step) % n;
+  }
+  qsort(sample, m, sizeof(unsigned int), compare_keys);
+
+  /* Keep the HIST_HOT longest runs, sorted by insertion */
+  for (i=0; i<m; i=j) {
+    for (j=i+1; j<m && sample[j] == sample[i]; j++);
+    run = j - i;
+    if (run < HIST_HOTMIN || (nhot == HIST_HOT && run <= count[nhot-1])) continue;
+    if (nhot < HIST_HOT) nhot++;
+    for (h=nhot-1; h>0 && count[h-1] < run; h--) {
+      count[h] = count[h-1];
+      hot[h] = hot[h-1];
+    }
+    count[h] = run;
+    hot[h] = sample[i];
+  }
+
+  for (h=0; h<nhot; h++) sum += count[h];
+  *share = m > 0 ? (double) sum/m : 0.0;
+  return nhot;
+}
+
+static int choose(const unsigned int *key, long n, long nbins, int nthreads,
+		  unsigned int *hot, int *nhot) {
+  double share;
+
+  *nhot = 0;
+  if (nthreads == 1 || (nbins <= HIST_PRIVATE_MAX && nbins*(nthreads-1) <= n))
+    return HIST_PRIVATE;
+  *nhot = find_hot(key, n, hot, &share);
+  return share >= HIST_SKEW ? HIST_HYBRID : HIST_ATOMIC;
+}
+
+int hist_choose(const unsigned int *key, long n, long nbins, int nthreads) {
+  unsigned int hot[HIST_HOT];
+  int nhot;
+
+  return choose(key, n, nbins, nthreads, hot, &nhot);
+}
+
+static void hist_critical(const unsigned int *key, long n, long *bin) {
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++) {
+#pragma omp critical(histogram)
+    bin[key[i]]++;
+  }
+}
+
+static void hist_atomic(const unsigned int *key, long n, long *bin) {
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++) {
+#pragma omp atomic
+    bin[key[i]]++;
+  }
+}
+
+/* Thread 0 counts in bin itself, so one thread needs no copies. The
+   copies of the others are cleared by their own thread, so that their
+   pages are placed near it. Returns 0 if there is no memory for them */
+static int hist_private(const unsigned int *key, long n, long *bin, long nbins) {
+  int p = omp_get_max_threads();
+  long *copy = NULL;
+
+  if (p > 1 && (copy = (long *) malloc((size_t) (p-1)*nbins*sizeof(long))) == NULL)
+    return 0;
+
+#pragma omp parallel
+  {
+    int t = omp_get_thread_num(), nt = omp_get_num_threads(), s;
+    long *c = t == 0 ? bin : copy + (t-1)*nbins;
+    long i, b;
+
+    if (t > 0)
+      for (b=0; b<nbins; b++) c[b] = 0;
+#pragma omp barrier
+
+#pragma omp for schedule(static)
+    for (i=0; i<n; i++)
+      c[key[i]]++;
+
+#pragma omp for schedule(static)
+    for (b=0; b<nbins; b++)
+      for (s=1; s<nt; s++)
+	bin[b] += copy[(s-1)*nbins + b];
+  }
+  free(copy);
+  return 1;
+}
+
+/* The hot bins are found with a small hash table with linear probing,
+   which is at least three quarters empty, so that a key that is not hot
+   is seen to be so after a probe or two */
+static void hist_hybrid(const unsigned int *key, long n, long *bin, const unsigned int *hot, int nhot) {
+  unsigned int table[TABLE];
+  int slot[TABLE], h, j;
+
+  for (h=0; h<TABLE; h++) table[h] = EMPTY;
+  for (j=0; j<nhot; j++) {
+    for (h=(hot[j]*2654435761u) % TABLE; table[h] != EMPTY; h=(h+1) % TABLE);
+    table[h] = hot[j];
+    slot[h] = j;
+  }
+
+#pragma omp parallel private(h, j)
+  {
+    long count[HIST_HOT], i;
+    unsigned int k;
+
+    for (j=0; j<nhot; j++) count[j] = 0;
+#pragma omp for schedule(static)
+    for (i=0; i<n; i++) {
+      k = key[i];
+      for (h=(k*2654435761u) % TABLE; table[h] != k && table[h] != EMPTY; h=(h+1) % TABLE);
+      if (table[h] == k)
+	count[slot[h]]++;
+      else {
+#pragma omp atomic
+	bin[k]++;
+      }
+    }
+    for (j=0; j<nhot; j++)
+      if (count[j] > 0) {
+#pragma omp atomic
+	bin[hot[j]] += count[j];
+      }
+  }
+}
+
+int histogram(const unsigned int *key, long n, long *bin, long nbins, int strategy) {
+  unsigned int hot[HIST_HOT];
+  double share;
+  int nhot = 0;
+
+  if (n <= 0) return strategy;
+  if (strategy == HIST_AUTO)
+    strategy = choose(key, n, nbins, omp_get_max_threads(), hot, &nhot);
+  else if (strategy == HIST_HYBRID)
+    nhot = find_hot(key, n, hot, &share);
+
+  switch (strategy) {
+  case HIST_CRITICAL: hist_critical(key, n, bin); break;
+  case HIST_PRIVATE:
+    if (hist_private(key, n, bin, nbins)) break;
+    strategy = HIST_ATOMIC;
+    /* No memory for the copies */
+  case HIST_ATOMIC: hist_atomic(key, n, bin); break;
+  case HIST_HYBRID: hist_hybrid(key, n, bin, hot, nhot); break;
+  }
+  return strategy;
+}
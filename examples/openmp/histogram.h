@@ -0,0 +1,58 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/*
+  A parallel histogram: counts how many of n keys fall in each of nbins
+  bins, with the key being the number of its bin.
+
+  When all threads add to the same bins they have to be careful not to
+  lose increments. A critical section around every increment, as the
+  sum in omp_critical.c, makes the threads wait for each other all the
+  time. The strategies here avoid that in different ways:
+
+    private   every thread counts in its own copy of the bins, and the
+              copies are added together at the end by all threads, each
+              for a part of the bins. This is the fastest as long as the
+              copies are small, since the adding takes nbins * threads
+              additions however many keys there are
+    atomic    every increment is an atomic operation on the shared bins.
+              Atomics are slower than plain increments, but cost little
+              more when the keys are spread over many bins, because two
+              threads then seldom hit the same cache line
+    hybrid    the bins that many keys fall in (the hot bins) are counted
+              privately and all others with atomics, for a very large
+              number of bins where a few of them get a large part of the
+              keys and would be fought over by the threads
+    critical  a critical section around every increment, for comparison
+
+  With HIST_AUTO the strategy is chosen from the number of bins and the
+  number of threads, and from a sample of HIST_SAMPLE keys that shows
+  which bins are hot. private is chosen when the copies are at most
+  HIST_PRIVATE_MAX bins and adding them takes fewer operations than
+  counting the keys, otherwise hybrid when the hot bins hold at least
+  HIST_SKEW of the sample, and atomic when they do not. A bin is hot when
+  it is one of the HIST_HOT largest in the sample and at least
+  HIST_HOTMIN keys of the sample fall in it.
+
+  The functions must be called outside of parallel regions.
+*/
+
+#define HIST_PRIVATE_MAX (1L<<20)
+#define HIST_SAMPLE 4096
+#define HIST_HOT 64
+#define HIST_HOTMIN 4
+#define HIST_SKEW 0.1
+
+enum { HIST_AUTO, HIST_CRITICAL, HIST_ATOMIC, HIST_PRIVATE, HIST_HYBRID, HIST_NSTRATEGIES };
+
+/* Add the n keys to bin[0..nbins-1]. Every key must be less than nbins.
+   Returns the strategy that was used */
+int histogram(const unsigned int *key, long n, long *bin, long nbins, int strategy);
+
+/* The strategy that HIST_AUTO would use with nthreads threads */
+int hist_choose(const unsigned int *key, long n, long nbins, int nthreads);
+
+/* The name of a strategy, such as "private" */
+const char *hist_name(int strategy);
+
+#endif
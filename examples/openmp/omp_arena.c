@@ -0,0 +1,198 @@
+/*
+  OpenMP example program that compares malloc with the per-thread arenas
+  of arena.c, which keep their state in a threadprivate variable as in
+  omp_threadprivate.c.
+
+  Two kinds of loops are measured:
+
+    temporary  every iteration allocates some small buffers of random
+               sizes, writes to them, and frees them again. This is
+               done with malloc and free, with arena_alloc and
+               arena_free, and with arena_alloc in a region that
+               arena_release ends
+    handoff    one loop allocates an object for every element of an
+               array, and the next loop frees them in reverse order, so
+               most objects are freed by another thread than the one
+               that allocated them
+
+  Every object is filled with a value that is checked before it is
+  freed, so that two objects that overlap would be noticed. The program
+  prints millions of allocations (with the free) per second for
+  different numbers of threads, and the memory that the arenas use at
+  the end, before and after arena_trim gives the free blocks back.
+
+  Compile the program with 'gcc -O3 -fopenmp omp_arena.c arena.c -o omp_arena'
+  Run the program with './omp_arena -t 4 -n 1000000 -k 8 -s 512'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "arena.h"
+
+#define MAXOBJ 64
+#define TRIALS 3
+
+enum { MALLOC, ARENA, REGION };
+
+long n = 1000000;               /* Iterations */
+int nobj = 8;                   /* Objects per iteration */
+int maxsize = 512;              /* Largest object in bytes */
+long errors = 0;
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <iterations> -k <objects per iteration> -s <largest object> -t <threads>\n", s);
+  exit(0);
+}
+
+/* Size of object k of iteration i, from 16 to maxsize bytes */
+size_t object_size(long i, int k) {
+  unsigned int r = (unsigned int) (i*MAXOBJ + k)*2654435761u;
+
+  return 16 + (r >> 8) % (maxsize - 15);
+}
+
+void fill(long *p, size_t size, long v) {
+  size_t j;
+
+  for (j=0; j<size/sizeof(long); j++) p[j] = v;
+}
+
+long check(long *p, size_t size, long v) {
+  size_t j;
+  long bad = 0;
+
+  for (j=0; j<size/sizeof(long); j++)
+    if (p[j] != v) bad++;
+  return bad != 0;
+}
+
+/* The temporary loop with one method. Returns the time */
+double temporary(int method) {
+  long *obj[MAXOBJ];
+  double t;
+  long i, bad = 0;
+  size_t size[MAXOBJ];
+  int k, j, order[MAXOBJ];
+  arena_mark_t m;
+
+  /* The objects are freed in another order than they were allocated,
+     first the even ones, then the odd ones backwards */
+  for (k=0, j=0; k<nobj; k+=2) order[j++] = k;
+  for (k=nobj-1-nobj%2; k>0; k-=2) order[j++] = k;
+
+  t = omp_get_wtime();
+#pragma omp parallel for schedule(dynamic, 256) private(obj, size, k, j, m) reduction(+:bad)
+  for (i=0; i<n; i++) {
+    if (method == REGION) m = arena_mark();
+    for (k=0; k<nobj; k++) {
+      size[k] = object_size(i, k);
+      obj[k] = (long *) (method == MALLOC ? malloc(size[k]) : arena_alloc(size[k]));
+      fill(obj[k], size[k], i*MAXOBJ + k);
+    }
+    for (j=0; j<nobj; j++) {
+      k = order[j];
+      bad += check(obj[k], size[k], i*MAXOBJ + k);
+      if (method == MALLOC) free(obj[k]);
+      else if (method == ARENA) arena_free(obj[k]);
+    }
+    if (method == REGION) arena_release(&m);
+  }
+  t = omp_get_wtime() - t;
+  errors += bad;
+  return t;
+}
+
+/* The handoff loops. Returns the time */
+double handoff(int method, long **obj) {
+  double t;
+  long i, j, bad = 0;
+
+  t = omp_get_wtime();
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++) {
+    obj[i] = (long *) (method == MALLOC ? malloc(object_size(i, 0)) : arena_alloc(object_size(i, 0)));
+    fill(obj[i], object_size(i, 0), i);
+  }
+#pragma omp parallel for schedule(static) private(j) reduction(+:bad)
+  for (i=0; i<n; i++) {
+    j = n-1-i;
+    bad += check(obj[j], object_size(j, 0), j);
+    if (method == MALLOC) free(obj[j]);
+    else arena_free(obj[j]);
+  }
+  t = omp_get_wtime() - t;
+  errors += bad;
+  return t;
+}
+
+/* Bytes in the arenas of all threads, before or after arena_trim */
+size_t footprint(int trim) {
+  size_t total = 0;
+
+#pragma omp parallel reduction(+:total)
+  total += trim ? arena_trim() : arena_footprint();
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  int nthreads = omp_get_max_threads(), p, method, r, opt;
+  double t, best;
+  long **obj;
+
+  while ((opt = getopt(argc, argv, "n:k:s:t:h")) != -1) {
+    switch (opt) {
+    case 'n': n = atol(optarg); break;
+    case 'k': nobj = atoi(optarg); break;
+    case 's': maxsize = atoi(optarg); break;
+    case 't': nthreads = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (n < 1 || nobj < 1 || nobj > MAXOBJ || maxsize < 16 || nthreads < 1) print_usage(argv[0]);
+
+  /* The arenas must stay with their threads */
+  omp_set_dynamic(0);
+  obj = (long **) malloc(n*sizeof(long *));
+
+  printf("Temporary buffers: %ld iterations, %d objects of 16 to %d bytes\n", n, nobj, maxsize);
+  printf("Handoff: %ld objects\n", n);
+  printf("Millions of allocations per second, best of %d\n\n", TRIALS);
+  printf("%8s %30s %20s\n", "", "temporary", "handoff");
+  printf("%8s %10s %10s %10s %10s %10s %10s %10s\n", "threads", "malloc", "arena", "region",
+	 "malloc", "arena", "arena MB", "trimmed");
+  for (p=1; p<=nthreads; p = p*2 <= nthreads || p == nthreads ? p*2 : nthreads) {
+    omp_set_num_threads(p);
+    printf("%8d", p);
+    for (method=MALLOC; method<=REGION; method++) {
+      best = 1e300;
+      for (r=0; r<TRIALS; r++) {
+	t = temporary(method);
+	if (t < best) best = t;
+      }
+      printf(" %10.1f", (double) n*nobj/best*1e-6);
+    }
+    for (method=MALLOC; method<=ARENA; method++) {
+      best = 1e300;
+      for (r=0; r<TRIALS; r++) {
+	t = handoff(method, obj);
+	if (t < best) best = t;
+      }
+      printf(" %10.1f", (double) n/best*1e-6);
+    }
+    printf(" %10.1f", footprint(0)/1048576.0);
+    printf(" %10.1f\n", footprint(1)/1048576.0);
+
+    /* A new number of threads may give new threads, so the memory of
+       the arenas is given back */
+#pragma omp parallel
+    arena_destroy();
+  }
+
+  if (errors > 0) printf("%ld objects were overwritten\n", errors);
+  else printf("All objects were intact\n");
+  free(obj);
+  exit(0);
+}
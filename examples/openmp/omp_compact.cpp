@@ -0,0 +1,186 @@
+/*
+  OpenMP example program in C++ that measures the data parallel
+  primitives of compact.h on a column of random integers, and compares
+  them with the C++ library:
+
+    filter     std::copy_if, par_filter, and par_filter_index which
+               gives the indices instead of the elements
+    partition  std::stable_partition and __gnu_parallel::partition,
+               which work in place and where the parallel one is not
+               stable, and par_partition which is stable but writes to
+               another array
+    gather     out[i] = in[idx[i]] with the indices that par_filter_index
+               gives, which are in order, and with random indices
+    scatter    out[idx[i]] = in[i] with a random permutation
+
+  The predicate is x < limit, and the limit is chosen so that a given
+  fraction (the selectivity) of the elements is true. The program prints
+  millions of elements per second, counting the elements that are read,
+  and checks every result against a sequential one.
+
+  std::copy_if is new in C++11, so older versions of g++ such as 4.5 need
+  the option -std=c++0x.
+
+  Compile the program with 'g++ -O3 -march=native -fopenmp omp_compact.cpp -o omp_compact'
+  Run the program with './omp_compact -n 33554432 -t 4'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <parallel/algorithm>
+#include "compact.h"
+
+#define TRIALS 3
+#define NSEL 5
+
+double selectivity[NSEL] = { 0.01, 0.1, 0.5, 0.9, 0.99 };
+
+struct less_than {
+  int limit;
+  less_than(int l) : limit(l) { }
+  bool operator()(int x) const { return x < limit; }
+};
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <elements> -t <threads>\n", s);
+  exit(0);
+}
+
+/* A random number for every index */
+unsigned int hash(unsigned long i) {
+  unsigned long long x = i*0x9e3779b97f4a7c15ULL;
+
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return (unsigned int) x;
+}
+
+/* Keep the shortest time since t */
+void timer(double *best, double t) {
+  t = omp_get_wtime() - t;
+  if (t < *best) *best = t;
+}
+
+int main(int argc, char *argv[]) {
+  long n = 1L<<25, i, j, k, nref, m;
+  int nthreads = omp_get_max_threads(), opt, s, r;
+  int *in, *out, *ref, *work;
+  long *idx, *perm;
+  double t, best[4];
+  bool wrong;
+
+  while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+    switch (opt) {
+    case 'n': n = atol(optarg); break;
+    case 't': nthreads = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (n < 1 || nthreads < 1) print_usage(argv[0]);
+  omp_set_num_threads(nthreads);
+
+  in = new int[n];
+  out = new int[n];
+  ref = new int[n];
+  work = new int[n];
+  idx = new long[n];
+  perm = new long[n];
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++) in[i] = (int) (hash(i) >> 2);
+
+  printf("%ld elements, %d threads, million elements per second\n\n", n, nthreads);
+  printf("%-12s %12s %12s %12s\n", "selectivity", "copy_if", "par_filter", "filter_index");
+  for (s=0; s<NSEL; s++) {
+    less_than pred((int) (selectivity[s]*1073741824.0));
+
+    for (r=0; r<4; r++) best[r] = 1e300;
+    wrong = false;
+    for (r=0; r<TRIALS; r++) {
+      t = omp_get_wtime();
+      nref = std::copy_if(in, in+n, ref, pred) - ref;
+      timer(&best[0], t);
+      t = omp_get_wtime();
+      m = par_filter(in, n, out, pred);
+      timer(&best[1], t);
+      if (m != nref || !std::equal(out, out+m, ref)) wrong = true;
+      t = omp_get_wtime();
+      m = par_filter_index(in, n, idx, pred);
+      timer(&best[2], t);
+      for (j=0; j<m; j++)
+	if (in[idx[j]] != ref[j] || (j > 0 && idx[j] <= idx[j-1])) wrong = true;
+      if (m != nref) wrong = true;
+    }
+    printf("%11.0f%% %12.1f %12.1f %12.1f%s\n", selectivity[s]*100, n/best[0]*1e-6,
+	   n/best[1]*1e-6, n/best[2]*1e-6, wrong ? "  wrong result" : "");
+  }
+
+  printf("\n%-12s %12s %12s %12s\n", "selectivity", "stable_part", "gnu_part", "par_part");
+  for (s=0; s<NSEL; s++) {
+    less_than pred((int) (selectivity[s]*1073741824.0));
+
+    for (r=0; r<4; r++) best[r] = 1e300;
+    wrong = false;
+    for (r=0; r<TRIALS; r++) {
+      std::copy(in, in+n, ref);
+      t = omp_get_wtime();
+      nref = std::stable_partition(ref, ref+n, pred) - ref;
+      timer(&best[0], t);
+      std::copy(in, in+n, work);
+      t = omp_get_wtime();
+      m = __gnu_parallel::partition(work, work+n, pred) - work;
+      timer(&best[1], t);
+      for (j=0; j<n; j++)
+	if (pred(work[j]) != (j < m)) wrong = true;
+      t = omp_get_wtime();
+      m = par_partition(in, n, out, pred);
+      timer(&best[2], t);
+      if (m != nref || !std::equal(out, out+n, ref)) wrong = true;
+    }
+    printf("%11.0f%% %12.1f %12.1f %12.1f%s\n", selectivity[s]*100, n/best[0]*1e-6,
+	   n/best[1]*1e-6, n/best[2]*1e-6, wrong ? "  wrong result" : "");
+  }
+
+  /* A selection vector from a filter, random indices and a random
+     permutation (Fisher-Yates) */
+  less_than tenth((int) (0.1*1073741824.0));
+  m = par_filter_index(in, n, idx, tenth);
+  for (i=0; i<n; i++) perm[i] = i;
+  for (i=n-1; i>0; i--) std::swap(perm[i], perm[hash(i+n) % (i+1)]);
+
+  printf("\n%-24s %12s %12s\n", "", "sequential", "parallel");
+  for (k=0; k<3; k++) {
+    long len = k == 0 ? m : n, *ix = k == 0 ? idx : perm;
+
+    for (r=0; r<4; r++) best[r] = 1e300;
+    wrong = false;
+    for (r=0; r<TRIALS; r++) {
+      t = omp_get_wtime();
+      if (k < 2)
+	for (i=0; i<len; i++) ref[i] = in[ix[i]];
+      else
+	for (i=0; i<len; i++) ref[ix[i]] = in[i];
+      timer(&best[0], t);
+      t = omp_get_wtime();
+      if (k < 2) par_gather(in, ix, len, out);
+      else par_scatter(in, ix, len, out);
+      timer(&best[1], t);
+      if (!std::equal(out, out+len, ref)) wrong = true;
+    }
+    printf("%-24s %12.1f %12.1f%s\n",
+	   k == 0 ? "gather, 10% selection" : k == 1 ? "gather, random" : "scatter, random",
+	   len/best[0]*1e-6, len/best[1]*1e-6, wrong ? "  wrong result" : "");
+  }
+
+  delete [] in;
+  delete [] out;
+  delete [] ref;
+  delete [] work;
+  delete [] idx;
+  delete [] perm;
+  exit(0);
+}
@@ -17,12 +17,6 @@ int main (int argc, char *argv[]) {
   C = (double *) malloc(n*sizeof(double));
   D = (double *) malloc(n*sizeof(double));
 
-  /* Initialize the arrays A and C */
-  for (i=0; i<n; i++) {
-    A[i] = (double)(i+1);
-    C[i] = (double)(i+1);
-  }
-
   /* Fork a team of threads */
 #pragma omp parallel private(tid, i) shared(n,A,B,C,D)
   {
@@ -34,12 +28,23 @@ int main (int argc, char *argv[]) {
 	printf("Number of threads = %d\n", nthreads);
       }
 
-#pragma omp for nowait
+    /* Initialize the arrays A and C with the same schedule as the loops
+       that use them. A page of memory is placed on the NUMA node of the
+       thread that first writes to it, so with large arrays each thread
+       then finds its part in local memory. The barrier at the end of the
+       loop makes sure that A and C are ready */
+#pragma omp for schedule(static)
+    for (i=0; i<n; i++) {
+      A[i] = (double)(i+1);
+      C[i] = (double)(i+1);
+    }
+
+#pragma omp for schedule(static) nowait
     for (i=0; i<n; i++) {
       B[i] = 2.0*A[i];
     }
 
-#pragma omp for nowait
+#pragma omp for schedule(static) nowait
     for (i=0; i<n; i++) {
       D[i] = 1.0/C[i];
       printf("Thread %d does iteration %d\n", tid, i);
@@ -0,0 +1,175 @@
+/*
+  OpenMP example program that multiplies two matrices with the
+  cache-blocked matrix multiplication in gemm.c and reports the speed in
+  GFLOP/s, compared with the theoretical peak of the processor.
+
+  The matrices are C = A*B, where A is M x K and B is K x N, and all
+  sizes can be given. The multiplication is repeated and the fastest
+  time is used. The result is checked at random elements against a dot
+  product, and with -c the whole matrix is also computed with the simple
+  loops of omp_matrixmult.c, to show the difference in speed.
+
+  The theoretical peak is threads x clock frequency x the operations per
+  cycle of the micro-kernel that was compiled in, see gemm.h. The clock
+  frequency is read from the system, or can be given with -f. Turbo
+  frequencies make the real peak higher when only a few cores are used.
+
+  The block sizes come from the cache sizes in the machine profile that
+  omp_get_env_info saves (see profile.h), or from probing the machine if
+  there is none, and can be given with -b. One thread per core is used,
+  unless OMP_NUM_THREADS is set.
+
+  Compile the program with 'gcc -O3 -march=native -fopenmp omp_gemm.c gemm.c profile.c -o omp_gemm'
+  Run the program with './omp_gemm -m 2000 -n 2000 -k 2000'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "gemm.h"
+#include "profile.h"
+
+void print_usage(char *s) {
+  printf("Usage: %s -m <rows of A> -n <columns of B> -k <columns of A>\n", s);
+  printf("          -r <repetitions> -f <clock frequency in GHz> -c\n");
+  printf("          -b <mc,kc,nc block sizes>\n");
+  exit(0);
+}
+
+/* Maximum clock frequency in GHz, or 0 if it is not known */
+double clock_ghz(void) {
+  FILE *f;
+  char line[256];
+  double mhz = 0.0;
+  long khz;
+
+  f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+  if (f != NULL) {
+    if (fscanf(f, "%ld", &khz) == 1) mhz = khz/1000.0;
+    fclose(f);
+  }
+  if (mhz == 0.0 && (f = fopen("/proc/cpuinfo", "r")) != NULL) {
+    while (fgets(line, sizeof(line), f) != NULL)
+      if (strncmp(line, "cpu MHz", 7) == 0 && sscanf(strchr(line, ':')+1, "%lf", &mhz) == 1)
+	break;
+    fclose(f);
+  }
+  return mhz/1000.0;
+}
+
+int main(int argc, char *argv[]) {
+  int M = 2000, N = 2000, K = 2000, reps = 3, check = 0, nthreads, i, j, l, r, errors, opt;
+  double *a, *b, *c, *d, ghz = 0.0, t, best = 1e300, flops, peak, s, err, maxerr = 0.0;
+  gemm_params p;
+  machine_profile prof;
+  int from_file;
+
+  from_file = profile_get(&prof);
+  gemm_cache_params(&p, prof.cache[1], prof.cache[2], prof.cache[3]);
+  gemm_set_params(&p);
+  gemm_get_params(&p);
+  omp_set_num_threads(profile_threads(&prof));
+  while ((opt = getopt(argc, argv, "m:n:k:r:f:b:ch")) != -1) {
+    switch (opt) {
+    case 'm': M = atoi(optarg); break;
+    case 'n': N = atoi(optarg); break;
+    case 'k': K = atoi(optarg); break;
+    case 'r': reps = atoi(optarg); break;
+    case 'f': ghz = atof(optarg); break;
+    case 'c': check = 1; break;
+    case 'b':
+      if (sscanf(optarg, "%d,%d,%d", &p.mc, &p.kc, &p.nc) != 3) print_usage(argv[0]);
+      gemm_set_params(&p);
+      gemm_get_params(&p);
+      break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (M < 1 || N < 1 || K < 1 || reps < 1) print_usage(argv[0]);
+  if (ghz <= 0.0) ghz = clock_ghz();
+
+  a = (double *) malloc((long)M*K*sizeof(double));
+  b = (double *) malloc((long)K*N*sizeof(double));
+  c = (double *) malloc((long)M*N*sizeof(double));
+  nthreads = omp_get_max_threads();
+
+  /* The threads initialize the parts they use */
+#pragma omp parallel private(j)
+  {
+#pragma omp for nowait
+    for (i=0; i<M; i++)
+      for (j=0; j<K; j++)
+	a[(long)i*K+j] = (double) ((i+2*j) % 13) - 6.0;
+#pragma omp for nowait
+    for (i=0; i<K; i++)
+      for (j=0; j<N; j++)
+	b[(long)i*N+j] = (double) ((3*i+j) % 11) - 5.0;
+  }
+
+  printf("C = A*B with M = %d, N = %d, K = %d, %d threads\n", M, N, K, nthreads);
+  printf("Caches L1 %ld KB, L2 %ld KB, L3 %ld KB, %s\n", prof.cache[1]/1024, prof.cache[2]/1024,
+	 prof.cache[3]/1024, from_file ? profile_file() : "probed");
+  printf("Micro-kernel %s, blocks mc = %d, kc = %d, nc = %d\n",
+	 gemm_kernel_name(), p.mc, p.kc, p.nc);
+
+  flops = 2.0*M*N*K;
+  for (r=0; r<reps; r++) {
+    t = omp_get_wtime();
+    gemm(M, N, K, 1.0, a, K, b, N, 0.0, c, N);
+    t = omp_get_wtime() - t;
+    if (t < best) best = t;
+    printf("Run %d: %.3f s, %.2f GFLOP/s\n", r+1, t, flops/t*1e-9);
+  }
+
+  printf("Best time %.3f s, %.2f GFLOP/s", best, flops/best*1e-9);
+  if (ghz > 0.0) {
+    peak = nthreads*ghz*gemm_flops_per_cycle();
+    printf(", peak %d x %.2f GHz x %d = %.1f GFLOP/s, %.1f%% of peak",
+	   nthreads, ghz, gemm_flops_per_cycle(), peak, 100.0*flops/best*1e-9/peak);
+  }
+  printf("\n");
+
+  /* Random elements computed as dot products. All the values are small
+     integers, so the results are exact */
+  errors = 0;
+  srand(1);
+  for (r=0; r<1000; r++) {
+    i = rand() % M;
+    j = rand() % N;
+    s = 0.0;
+    for (l=0; l<K; l++) s += a[(long)i*K+l]*b[(long)l*N+j];
+    err = fabs(s - c[(long)i*N+j]);
+    if (err > maxerr) maxerr = err;
+    if (err != 0.0) errors++;
+  }
+  printf("Checked 1000 elements, %d wrong, largest error %g\n", errors, maxerr);
+
+  if (check) {
+    /* The simple i-j-k loops, for comparison */
+    d = (double *) malloc((long)M*N*sizeof(double));
+    t = omp_get_wtime();
+#pragma omp parallel for private(j, l, s)
+    for (i=0; i<M; i++) {
+      for (j=0; j<N; j++) {
+	s = 0.0;
+	for (l=0; l<K; l++) s += a[(long)i*K+l]*b[(long)l*N+j];
+	d[(long)i*N+j] = s;
+      }
+    }
+    t = omp_get_wtime() - t;
+    errors = 0;
+    for (i=0; i<M; i++)
+      for (j=0; j<N; j++)
+	if (d[(long)i*N+j] != c[(long)i*N+j]) errors++;
+    printf("Simple loops: %.3f s, %.2f GFLOP/s, %.1f times slower, %d elements differ\n",
+	   t, flops/t*1e-9, t/best, errors);
+    free(d);
+  }
+
+  free(a); free(b); free(c);
+  exit(0);
+}
@@ -1,16 +1,46 @@
 /*
   OpenMP example program that reads and prints out some environment variables
-  that control OpenMP execution.
+  that control OpenMP execution, and the hardware that the threads run on.
+
+  The hardware is found with profile.c: the sockets, cores and hardware
+  threads, the caches and their line size, and the distances between the
+  NUMA nodes. The latency and bandwidth of the memory are measured,
+  unless -q is given. The results are saved in a profile file, which
+  omp_gemm, omp_matrixmult and omp_stencil read to choose their block
+  sizes and number of threads. The file is machine.profile, or the one
+  given with -o or in the environment variable MACHINE_PROFILE.
+
+  Compile the program with 'gcc -O3 -fopenmp omp_get_env_info.c profile.c -o omp_get_env_info'
+  Run the program with './omp_get_env_info' or './omp_get_env_info -q -o other.profile'
 */
 
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include "profile.h"
+
+void print_usage(char *s) {
+  printf("Usage: %s -o <profile file> -q (do not measure the memory)\n", s);
+  exit(0);
+}
 
 int main (int argc, char *argv[]) 
 {
   int nthreads, tid, procs, maxt, inpar, dynamic, nested;
+  int quick = 0, opt;
+  const char *file = profile_file();
+  machine_profile p;
   
+  while ((opt = getopt(argc, argv, "o:qh")) != -1) {
+    switch (opt) {
+    case 'o': file = optarg; break;
+    case 'q': quick = 1; break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+
   /* Start parallel region */
 #pragma omp parallel private(nthreads, tid)
   {
@@ -42,6 +72,19 @@ int main (int argc, char *argv[])
       }
     
   }  /* Done */
+
+  /* The hardware */
+  profile_probe(&p);
+  if (!quick) {
+    printf("\nMeasuring the memory...\n");
+    profile_measure(&p);
+  }
+  printf("\n");
+  profile_print(stdout, &p);
+  printf("Threads for the other programs = %d\n", profile_threads(&p));
+
+  if (profile_save(&p, file)) printf("\nProfile saved in %s\n", file);
+  else printf("\nCould not write the profile to %s\n", file);
   exit(0);
 }
 
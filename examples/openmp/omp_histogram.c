@@ -0,0 +1,165 @@
+/*
+  OpenMP example program that measures the strategies of histogram.c for
+  counting keys in bins, for different numbers of bins and threads.
+
+  The keys are uniformly random, or skewed: a key is e^(u ln(nbins)) - 1
+  for a uniformly random u, so that small keys are much more common than
+  large ones, about as in a Zipf distribution. Skewed keys make the
+  threads hit the same few bins, which is where atomics and critical
+  sections are slow and the hybrid strategy helps.
+
+  For every number of bins, from 16 up to -b by factors of 16, the
+  program prints millions of keys per second of a sequential loop, of
+  each strategy, and of HIST_AUTO, with the strategy that it chose.
+  critical is so slow that it only counts the first 1/16 of the keys.
+  private is left out (-) when its copies of the bins would need more
+  than 1 GB. Every result is compared with the sequential one.
+
+  Compile the program with 'gcc -O3 -fopenmp omp_histogram.c histogram.c -o omp_histogram -lm'
+  Run the program with './omp_histogram -n 16777216 -b 16777216 -t 8'. The
+  number of threads goes from 1 up to -t by factors of two.
+*/
+
+#include <omp.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "histogram.h"
+
+#define TRIALS 3
+
+enum { UNIFORM, SKEWED };
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <keys> -b <largest number of bins> -t <threads>\n", s);
+  exit(0);
+}
+
+/* A random number for every index */
+unsigned int hash(unsigned long i) {
+  unsigned long long x = i*0x9e3779b97f4a7c15ULL;
+
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return (unsigned int) x;
+}
+
+void make_keys(unsigned int *key, long n, long nbins, int dist) {
+  double lnb = log((double) nbins);
+  unsigned int k;
+  long i;
+
+#pragma omp parallel for schedule(static) private(k)
+  for (i=0; i<n; i++) {
+    if (dist == UNIFORM)
+      k = hash(i) % nbins;
+    else {
+      k = (unsigned int) (exp(hash(i)*(1.0/4294967296.0)*lnb) - 1.0);
+      if (k >= nbins) k = nbins-1;
+    }
+    key[i] = k;
+  }
+}
+
+/* Run a strategy TRIALS times on the first n keys and compare the
+   result with ref. Returns millions of keys per second, or -1 if the
+   result is wrong, and the strategy that was used in used */
+double measure(const unsigned int *key, long n, long *bin, long nbins, int strategy,
+	       const long *ref, int *used) {
+  double t, best = 1e300;
+  int r;
+
+  for (r=0; r<TRIALS; r++) {
+    memset(bin, 0, nbins*sizeof(long));
+    t = omp_get_wtime();
+    *used = histogram(key, n, bin, nbins, strategy);
+    t = omp_get_wtime() - t;
+    if (t < best) best = t;
+    if (memcmp(bin, ref, nbins*sizeof(long)) != 0) return -1.0;
+  }
+  return n/best*1e-6;
+}
+
+void print_rate(double rate) {
+  if (rate < 0.0) printf(" %9s", "wrong");
+  else if (rate == 0.0) printf(" %9s", "-");
+  else printf(" %9.1f", rate);
+}
+
+int main(int argc, char *argv[]) {
+  long n = 1L<<24, maxbins = 1L<<24, nbins, i;
+  int maxthreads = omp_get_max_threads(), nthreads, opt, dist, s, used, r;
+  unsigned int *key;
+  long *bin, *ref, *ref16;
+  double t, best, rate;
+
+  while ((opt = getopt(argc, argv, "n:b:t:h")) != -1) {
+    switch (opt) {
+    case 'n': n = atol(optarg); break;
+    case 'b': maxbins = atol(optarg); break;
+    case 't': maxthreads = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (n < 16 || maxbins < 16 || maxbins > 4294967295L || maxthreads < 1) print_usage(argv[0]);
+
+  key = (unsigned int *) malloc(n*sizeof(unsigned int));
+  bin = (long *) malloc(maxbins*sizeof(long));
+  ref = (long *) malloc(maxbins*sizeof(long));
+  ref16 = (long *) malloc(maxbins*sizeof(long));
+  if (key == NULL || bin == NULL || ref == NULL || ref16 == NULL) {
+    printf("Not enough memory\n");
+    exit(1);
+  }
+
+  for (dist=UNIFORM; dist<=SKEWED; dist++)
+    for (nthreads=1; nthreads<=maxthreads; nthreads = nthreads*2 <= maxthreads || nthreads == maxthreads ? nthreads*2 : maxthreads) {
+      omp_set_num_threads(nthreads);
+      printf("%s keys, %ld keys, %d threads, million keys per second\n",
+	     dist == UNIFORM ? "Uniform" : "Skewed", n, nthreads);
+      printf("%-10s %9s", "bins", "serial");
+      for (s=HIST_CRITICAL; s<HIST_NSTRATEGIES; s++) printf(" %9s", hist_name(s));
+      printf(" %9s\n", "auto");
+
+      for (nbins=16; nbins<=maxbins; nbins = nbins*16 <= maxbins || nbins == maxbins ? nbins*16 : maxbins) {
+	make_keys(key, n, nbins, dist);
+
+	/* The sequential loop, which also gives the reference results */
+	best = 1e300;
+	for (r=0; r<TRIALS; r++) {
+	  memset(ref, 0, nbins*sizeof(long));
+	  t = omp_get_wtime();
+	  for (i=0; i<n; i++) ref[key[i]]++;
+	  t = omp_get_wtime() - t;
+	  if (t < best) best = t;
+	}
+	memset(ref16, 0, nbins*sizeof(long));
+	for (i=0; i<n/16; i++) ref16[key[i]]++;
+	printf("%-10ld", nbins);
+	print_rate(n/best*1e-6);
+
+	for (s=HIST_CRITICAL; s<HIST_NSTRATEGIES; s++) {
+	  if (s == HIST_CRITICAL)
+	    rate = measure(key, n/16, bin, nbins, s, ref16, &used);
+	  else if (s == HIST_PRIVATE && (double) (nthreads-1)*nbins*sizeof(long) > 1e9)
+	    rate = 0.0;
+	  else
+	    rate = measure(key, n, bin, nbins, s, ref, &used);
+	  print_rate(rate);
+	}
+	print_rate(measure(key, n, bin, nbins, HIST_AUTO, ref, &used));
+	printf(" %s\n", hist_name(used));
+      }
+      printf("\n");
+    }
+
+  free(key);
+  free(bin);
+  free(ref);
+  free(ref16);
+  exit(0);
+}
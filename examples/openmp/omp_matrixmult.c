@@ -1,17 +1,38 @@
 /*
   OpenMP implementation of matrix multiplication. Each thread takes care
   a chunk of rows. 
+
+  The result is compared with a sequential multiplication and with the
+  cache-blocked multiplication in gemm.c, which is much faster because
+  it reads B along the rows and keeps the data it uses in the caches.
+
+  The threads are bound to the CPUs with aff_pin_threads from
+  affinity.c, unless OMP_PROC_BIND or OMP_PLACES is set, and the matrices
+  are initialized in parallel with the same static schedule as the
+  multiplication. On a machine with several NUMA nodes each thread then
+  has its rows of A and C in local memory. The program prints where the
+  pages ended up.
+
+  The number of threads and the block sizes of the blocked
+  multiplication are taken from the machine profile of profile.h, which
+  omp_get_env_info saves: one thread per core unless OMP_NUM_THREADS is
+  set, and blocks that fit the caches.
+
+  Compile the program with 'gcc -O3 -march=native -fopenmp omp_matrixmult.c gemm.c affinity.c profile.c -o omp_matrixmult'
 */
 
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "gemm.h"
+#include "affinity.h"
+#include "profile.h"
 
 #define DEBUG 0
 
 #define NRA 1400                 /* number of rows in matrix A */
-#define NCA 1400                 /* number of columns in matrix A */
-#define NCB 1400                 /* number of columns in matrix B */
+#define NCA 1200                 /* number of columns in matrix A */
+#define NCB 1000                 /* number of columns in matrix B */
 
 int main (int argc, char *argv[]) {
   int	tid, nthreads, i, j, k;
@@ -20,6 +41,8 @@ int main (int argc, char *argv[]) {
   double **res;
   double *res_block;
   double starttime, stoptime;
+  machine_profile prof;
+  gemm_params params;
 
   a = (double **) malloc(NRA*sizeof(double *)); /* matrix a to be multiplied */
   b = (double **) malloc(NCA*sizeof(double *)); /* matrix b to be multiplied */
@@ -33,20 +56,27 @@ int main (int argc, char *argv[]) {
   res_block = (double *) malloc(NRA*NCB*sizeof(double));
 
   for (i=0; i<NRA; i++)   /* Initialize pointers to a */
-    a[i] = a_block+i*NRA;
+    a[i] = a_block+i*NCA;
 
   for (i=0; i<NCA; i++)   /* Initialize pointers to b */
-    b[i] = b_block+i*NCA;
+    b[i] = b_block+i*NCB;
   
   for (i=0; i<NRA; i++)   /* Initialize pointers to c */
-    c[i] = c_block+i*NRA;
+    c[i] = c_block+i*NCB;
 
-  for (i=0; i<NRA; i++)   /* Initialize pointers to c */
-    res[i] = res_block+i*NRA;
+  for (i=0; i<NRA; i++)   /* Initialize pointers to res */
+    res[i] = res_block+i*NCB;
 
   /* A static allocation of the matrices would be done like this */
   /* double a[NRA][NCA], b[NCA][NCB], c[NRA][NCB];  */
 
+  profile_get(&prof);
+  omp_set_num_threads(profile_threads(&prof));
+  gemm_cache_params(&params, prof.cache[1], prof.cache[2], prof.cache[3]);
+  gemm_set_params(&params);
+
+  aff_pin_threads(AFF_SPREAD);
+
   /*** Spawn a parallel region explicitly scoping all variables ***/
 #pragma omp parallel shared(a,b,c,nthreads) private(tid,i,j,k)
   {
@@ -57,15 +87,18 @@ int main (int argc, char *argv[]) {
       printf("Initializing matrices...\n");
     }
     /*** Initialize matrices ***/
-#pragma omp for nowait 
+    /* The first thread that writes to a page decides on which NUMA node
+       it is, so the rows are initialized with the schedule of the
+       multiplication */
+#pragma omp for schedule(static) nowait
     for (i=0; i<NRA; i++)
       for (j=0; j<NCA; j++)
 	a[i][j]= (double) (i+j);
-#pragma omp for nowait
+#pragma omp for schedule(static) nowait
     for (i=0; i<NCA; i++)
       for (j=0; j<NCB; j++)
 	b[i][j]= (double) (i*j);
-#pragma omp for 
+#pragma omp for schedule(static)
     for (i=0; i<NRA; i++)
       for (j=0; j<NCB; j++)
 	c[i][j]= 0.0;
@@ -76,7 +109,7 @@ int main (int argc, char *argv[]) {
     /* Do matrix multiply sharing iterations on outer loop */
     /* If DEBUG is TRUE display who does which iterations */
     printf("Thread %d starting matrix multiply...\n",tid);
-#pragma omp for nowait
+#pragma omp for schedule(static) nowait
     for (i=0; i<NRA; i++) {
       if (DEBUG) printf("Thread=%d did row=%d\n",tid,i);
       for(j=0; j<NCB; j++) {    
@@ -91,6 +124,10 @@ int main (int argc, char *argv[]) {
       printf("Time for parallel matrix multiplication: %3.2f\n", stoptime-starttime);
     }
   }   /*** End of parallel region ***/
+
+  aff_report_threads(stdout);
+  aff_page_report(stdout, "Matrix a", a_block, NRA*NCA*sizeof(double));
+  aff_page_report(stdout, "Matrix c", c_block, NRA*NCB*sizeof(double));
   
   starttime = omp_get_wtime();
   /* Do a sequential matrix multiplication and compare the results */
@@ -121,6 +158,18 @@ int main (int argc, char *argv[]) {
     }
   }
 
+  /* The same with the blocked multiplication, which needs the matrices
+     stored row by row in one block of memory, as they are here */
+  starttime = omp_get_wtime();
+  gemm(NRA, NCB, NCA, 1.0, a_block, NCA, b_block, NCB, 0.0, res_block, NCB);
+  stoptime = omp_get_wtime();
+  printf("Time for blocked matrix multiplication (%s): %3.2f\n",
+	 gemm_kernel_name(), stoptime-starttime);
+  for (i=0; i<NRA; i++)
+    for (j=0; j<NCB; j++)
+      if (res[i][j] != c[i][j])
+	printf("Different result %5.1f != %5.1f in %d %d\n ", res[i][j], c[i][j], i, j);
+
   /* If DEBUG is true, print the results */
   if (DEBUG) {
     printf("Result Matrix:\n");
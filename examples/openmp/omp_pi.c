@@ -1,15 +1,59 @@
 /*
   OpenMP example program that computes the value of Pi using the trapeziod rule.
+
+  The integral of 4/(1+x*x) from 0 to 1 is computed with n intervals of
+  width d = 1/n as d*(f(0)/2 + f(d) + f(2d) + ... + f((n-1)d) + f(1)/2),
+  so that f is evaluated once at every node. The nodes are divided into
+  one block per thread.
+
+  The loop that adds up the function values can be done with
+    -k scalar   a plain loop with one sum
+    -k simd     eight sums that are computed together with #pragma omp
+                simd, which needs OpenMP 4.0
+    -k avx      AVX instructions, four nodes in a register and two
+                registers at a time. Compile with -mavx or -march=native
+
+  and the sum with
+    -m plain     ordinary addition. The rounding error grows with the
+                 number of intervals, and for 10^7 intervals and more it
+                 is larger than the error of the method
+    -m kahan     Kahan summation, where the rounding error of every
+                 addition is kept and added back
+    -m pairwise  sums of blocks of 4096 values are added pairwise, so
+                 each value goes through about log2(n) additions
+
+  The results of the threads are added with Kahan summation in the order
+  of the threads, so the result does not depend on the timing.
+
+  With -e the computation is done for 10, 100, ... intervals up to n, and
+  the error is shown together with the error of the trapezoid rule, which
+  is about d*d/6 here. The speed is given in GFLOP/s, counting 5
+  operations per node (the node, its square, the addition of 1, the
+  division and the sum) but not the extra operations of Kahan summation.
+
+  Compile the program with 'gcc -O3 -march=native -fopenmp omp_pi.c -o omp_pi -lm'
+  Run the program with './omp_pi -i 1e9 -k avx -m kahan'
 */
 
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <math.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#define LANES 8             /* Sums in the simd kernel */
+#define PAIRBLOCK 4096      /* Values added in order in pairwise summation */
+#define MAXTHREADS 1024
+
+enum { SCALAR, SIMD, AVX } kernel = SIMD;
+enum { PLAIN, KAHAN, PAIRWISE } method = KAHAN;
 
 void print_usage(char *s) {
-  printf("Usage: %s -i <nr of intervals>\n", s);
+  printf("Usage: %s -i <nr of intervals> -k <scalar|simd|avx> -m <plain|kahan|pairwise> -e\n", s);
   exit(0);
 }
 
@@ -18,67 +62,254 @@ double f(double x) {
   return (4.0 / (1.0 + x*x));
 }
 
+/* Add x to the sum s with compensation c */
+#define KAHAN_ADD(s, c, x) do { double y_ = (x) - c, t_ = s + y_; c = (t_ - s) - y_; s = t_; } while (0)
+
+/* Sum of f(i*d) for lo <= i < hi with a plain loop. With Kahan
+   summation the compensation is returned in *comp */
+double sum_scalar(long long lo, long long hi, double d, int kahan, double *comp) {
+  double s = 0.0, c = 0.0;
+  long long i;
+
+  if (kahan) {
+    for (i=lo; i<hi; i++) KAHAN_ADD(s, c, f(d*(double)i));
+  }
+  else {
+    for (i=lo; i<hi; i++) s += f(d*(double)i);
+  }
+  *comp = c;
+  return s;
+}
+
+/* The same with LANES sums that can be computed with vector instructions */
+double sum_simd(long long lo, long long hi, double d, int kahan, double *comp) {
+  double s[LANES], c[LANES], x, y, t, sum = 0.0, csum = 0.0, rest, r;
+  long long i;
+  int j;
+
+  for (j=0; j<LANES; j++) s[j] = c[j] = 0.0;
+  for (i=lo; i+LANES<=hi; i+=LANES) {
+    if (kahan) {
+#if _OPENMP >= 201307
+#pragma omp simd private(x, y, t)
+#endif
+      for (j=0; j<LANES; j++) {
+	x = d*(double)(i+j);
+	y = 4.0/(1.0 + x*x) - c[j];
+	t = s[j] + y;
+	c[j] = (t - s[j]) - y;
+	s[j] = t;
+      }
+    }
+    else {
+#if _OPENMP >= 201307
+#pragma omp simd private(x)
+#endif
+      for (j=0; j<LANES; j++) {
+	x = d*(double)(i+j);
+	s[j] += 4.0/(1.0 + x*x);
+      }
+    }
+  }
+  for (j=0; j<LANES; j++) {
+    if (kahan) KAHAN_ADD(sum, csum, s[j] - c[j]);
+    else sum += s[j];
+  }
+  rest = sum_scalar(i, hi, d, kahan, &r);
+  if (kahan) KAHAN_ADD(sum, csum, rest - r);
+  else sum += rest;
+  *comp = csum;
+  return sum;
+}
+
+#ifdef __AVX__
+/* The same with AVX instructions, eight nodes per iteration */
+double sum_avx(long long lo, long long hi, double d, int kahan, double *comp) {
+  __m256d s0, s1, c0, c1, x0, x1, y0, y1, t0, t1, one, four, dv, step, idx;
+  double sv[8], cv[8], sum = 0.0, csum = 0.0, rest, r;
+  long long i;
+  int j;
+
+  s0 = s1 = c0 = c1 = _mm256_setzero_pd();
+  one = _mm256_set1_pd(1.0);
+  four = _mm256_set1_pd(4.0);
+  dv = _mm256_set1_pd(d);
+  step = _mm256_set1_pd(8.0);
+  idx = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+  idx = _mm256_add_pd(idx, _mm256_set1_pd((double) lo));
+  for (i=lo; i+8<=hi; i+=8) {
+    x0 = _mm256_mul_pd(idx, dv);
+    x1 = _mm256_mul_pd(_mm256_add_pd(idx, _mm256_set1_pd(4.0)), dv);
+    y0 = _mm256_div_pd(four, _mm256_add_pd(one, _mm256_mul_pd(x0, x0)));
+    y1 = _mm256_div_pd(four, _mm256_add_pd(one, _mm256_mul_pd(x1, x1)));
+    if (kahan) {
+      y0 = _mm256_sub_pd(y0, c0);
+      y1 = _mm256_sub_pd(y1, c1);
+      t0 = _mm256_add_pd(s0, y0);
+      t1 = _mm256_add_pd(s1, y1);
+      c0 = _mm256_sub_pd(_mm256_sub_pd(t0, s0), y0);
+      c1 = _mm256_sub_pd(_mm256_sub_pd(t1, s1), y1);
+      s0 = t0;
+      s1 = t1;
+    }
+    else {
+      s0 = _mm256_add_pd(s0, y0);
+      s1 = _mm256_add_pd(s1, y1);
+    }
+    idx = _mm256_add_pd(idx, step);
+  }
+  _mm256_storeu_pd(sv, s0);
+  _mm256_storeu_pd(sv+4, s1);
+  _mm256_storeu_pd(cv, c0);
+  _mm256_storeu_pd(cv+4, c1);
+  for (j=0; j<8; j++) {
+    if (kahan) KAHAN_ADD(sum, csum, sv[j] - cv[j]);
+    else sum += sv[j];
+  }
+  rest = sum_scalar(i, hi, d, kahan, &r);
+  if (kahan) KAHAN_ADD(sum, csum, rest - r);
+  else sum += rest;
+  *comp = csum;
+  return sum;
+}
+#endif
+
+/* Sum with the chosen kernel */
+double sum_kernel(long long lo, long long hi, double d, int kahan, double *comp) {
+#ifdef __AVX__
+  if (kernel == AVX) return sum_avx(lo, hi, d, kahan, comp);
+#endif
+  if (kernel == SIMD) return sum_simd(lo, hi, d, kahan, comp);
+  return sum_scalar(lo, hi, d, kahan, comp);
+}
+
+/* Pairwise summation: the sums of blocks are kept on a stack, and the two
+   top sums are added when they cover the same number of blocks, as in a
+   binary counter */
+double sum_pairwise(long long lo, long long hi, double d) {
+  double stack[64], c;
+  int level[64], top = 0;
+  long long i;
+
+  for (i=lo; i<hi; i+=PAIRBLOCK) {
+    stack[top] = sum_kernel(i, i+PAIRBLOCK < hi ? i+PAIRBLOCK : hi, d, 0, &c);
+    level[top++] = 0;
+    while (top > 1 && level[top-1] == level[top-2]) {
+      stack[top-2] += stack[top-1];
+      level[top-2]++;
+      top--;
+    }
+  }
+  while (top > 1) {
+    stack[top-2] += stack[top-1];
+    top--;
+  }
+  return top ? stack[0] : 0.0;
+}
+
+/* Pi with n intervals */
+double compute_pi(long long n, int *nthreads) {
+  double d = 1.0/(double) n, part[MAXTHREADS], comp[MAXTHREADS], sum = 0.0, c = 0.0;
+  int t;
+
+  /* Start the threads */
+#pragma omp parallel
+  {
+    int tid = omp_get_thread_num(), nt = omp_get_num_threads();
+    long long lo, hi;
+
+    /* The inner nodes 1..n-1 in one block per thread */
+    lo = 1 + (n-1)*tid/nt;
+    hi = 1 + (n-1)*(tid+1)/nt;
+    comp[tid] = 0.0;
+    if (method == PAIRWISE)
+      part[tid] = sum_pairwise(lo, hi, d);
+    else
+      part[tid] = sum_kernel(lo, hi, d, method == KAHAN, &comp[tid]);
+    if (tid == 0) *nthreads = nt;
+  }  /* The parallel section ends here */
+
+  /* f(0)/2 + f(1)/2 = 3, and the sums of the threads */
+  KAHAN_ADD(sum, c, 3.0);
+  for (t=0; t<*nthreads; t++) KAHAN_ADD(sum, c, part[t] - comp[t]);
+  return d*sum;
+}
+
 int main (int argc, char *argv[]) {
 
-  const double PI24 = 3.141592653589793238462643;  
-  int nthreads, tid;
-  double d, x, sum=0.0, pi;
-  double starttime, stoptime;
-  int n=1000, i;
-  char c;
+  const double PI24 = 3.141592653589793238462643;
+  int nthreads, sweep = 0;
+  double pi, starttime, stoptime, t;
+  long long n=1000, m;
+  char *kernels[3] = {"scalar", "simd", "avx"}, *methods[3] = {"plain", "kahan", "pairwise"};
+  int c;
 
   /* Check if we have at least one argument */
   if (argc <=1 ) {
     print_usage(argv[0]);
   }
   else {
-    /* Parse the arguments for a -h or -i flag */
-    while ((c=getopt(argc, argv, "hi:")) != EOF) {
+    /* Parse the arguments. The number of intervals can be given as 1e11 */
+    while ((c=getopt(argc, argv, "hi:k:m:e")) != EOF) {
       switch (c) {
-      case 'h':
-	print_usage(argv[0]);
       case 'i':
-	n = atoi(optarg);    /* Get number of intervals  */
+	n = (long long) atof(optarg);    /* Get number of intervals  */
+	break;
+      case 'k':
+	if (strcmp(optarg, "scalar") == 0) kernel = SCALAR;
+	else if (strcmp(optarg, "simd") == 0) kernel = SIMD;
+	else if (strcmp(optarg, "avx") == 0) kernel = AVX;
+	else print_usage(argv[0]);
+	break;
+      case 'm':
+	if (strcmp(optarg, "plain") == 0) method = PLAIN;
+	else if (strcmp(optarg, "kahan") == 0) method = KAHAN;
+	else if (strcmp(optarg, "pairwise") == 0) method = PAIRWISE;
+	else print_usage(argv[0]);
+	break;
+      case 'e':
+	sweep = 1;
 	break;
       default:
 	print_usage(argv[0]);
       }
     }
   }
+  if (n < 1 || omp_get_max_threads() > MAXTHREADS) print_usage(argv[0]);
+#ifndef __AVX__
+  if (kernel == AVX) {
+    printf("Compiled without AVX, using the simd kernel\n");
+    kernel = SIMD;
+  }
+#endif
 
-  /* Compute the size of intervals */
-  d = 1.0/(double) n;
-
-  /* Start the threads */
-#pragma omp parallel default(shared) private(nthreads, tid, x)
-  {
-    /* Get the thread number */
-    tid = omp_get_thread_num();
-    /* The master thread checks how many there are */
-    if (tid == 0) {
-      nthreads = omp_get_num_threads();
-      printf("Number of threads = %d\n", nthreads);
-      starttime = omp_get_wtime();  /* Master thread measures the execution time */
-    }
-
-    /* This loop is executed in parallel by the threads */
-#pragma omp for reduction(+:sum) 
-    for (i=0; i<n; i++) {
-      x = d*(double)i;
-      sum += f(x) + f(x+d);
+  if (sweep) {
+    printf("%s kernel, %s summation, %d threads\n", kernels[kernel], methods[method],
+	   omp_get_max_threads());
+    printf("%14s %10s %9s %12s %12s\n", "intervals", "time", "GFLOP/s", "error", "d*d/6");
+    for (m=10; ; m = m <= n/10 ? 10*m : n) {
+      t = omp_get_wtime();
+      pi = compute_pi(m, &nthreads);
+      t = omp_get_wtime() - t;
+      printf("%14lld %10.4f %9.2f %12.3e %12.3e\n", m, t, 5.0*m/t*1e-9,
+	     fabs(PI24-pi), 1.0/(6.0*(double)m*m));
+      if (m == n) break;
     }
-  }  /* The parallel section ends here */
-
-  /* The multiplication by d and division by 2 is moved out of the loop */  
-  pi = d*sum*0.5;
+    exit(0);
+  }
 
+  starttime = omp_get_wtime();  /* Measure the execution time */
+  pi = compute_pi(n, &nthreads);
   stoptime = omp_get_wtime();
+
+  printf("Number of threads = %d\n", nthreads);
+  printf("%lld intervals, %s kernel, %s summation\n", n, kernels[kernel], methods[method]);
   printf("The computed value of Pi is %2.24f\n", pi);
   printf("The  \"exact\" value of Pi is %2.24f\n", PI24);
   printf("The difference is %e\n", fabs(PI24-pi));
-  printf("Time: %3.2f seconds \n", stoptime-starttime);
+  printf("Time: %3.2f seconds, %.2f GFLOP/s \n", stoptime-starttime,
+	 5.0*n/(stoptime-starttime)*1e-9);
   printf("Clock resolution: %2.6f seconds \n\n", omp_get_wtick());
 
   exit(0);
 }
-
@@ -0,0 +1,176 @@
+/*
+  OpenMP example program that processes a stream of data in a pipeline
+  with the dataflow engine of dataflow.c, which uses tasks with depend
+  clauses (OpenMP 4.0).
+
+  The data comes in chunks, and every chunk goes through four stages:
+
+    read       makes the data of the chunk, as if it was read from a
+               file. Serial, so the chunks are read in order. With -r it
+               also waits, like a read from a slow disk
+    transform  computes a function of every element, which takes most of
+               the time. Reads the result of read
+    stats      the minimum and maximum of the chunk. Also reads the result
+               of read, so it can run at the same time as transform
+    reduce     adds the transformed values to a total, and merges the
+               minimum and maximum. Serial, so the total is always added
+               up in the same order. Reads transform and stats
+
+  The chunks use a few buffers in turn, so a chunk is not read before
+  the buffer is free.
+
+  The same is done as in omp_sections.c: each chunk is read, then
+  transform and stats run in two sections, then the chunk is reduced.
+  Only two threads can work at the same time, and the next chunk waits
+  for the previous one. In the pipeline the threads work on different
+  stages of different chunks at the same time.
+
+  Compile the program with 'gcc -O2 -fopenmp omp_pipeline.c dataflow.c -o omp_pipeline -lm'
+  Run the program with './omp_pipeline -c 64 -s 65536'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "dataflow.h"
+
+int nchunks = 64;           /* Chunks in the stream */
+int size = 65536;           /* Elements in a chunk */
+int nbuf = 4;               /* Buffers */
+int work = 20;              /* Work per element in transform */
+int delay = 0;              /* Microseconds that a read waits */
+
+double **raw, **out;        /* The buffers */
+double *cmin, *cmax;        /* Statistics of the chunks, per buffer */
+double total, gmin, gmax;   /* The result */
+
+void print_usage(char *s) {
+  printf("Usage: %s -c <chunks> -s <chunk size> -b <buffers> -w <work per element>\n", s);
+  printf("          -r <read delay in microseconds>\n");
+  exit(0);
+}
+
+void read_chunk(int c, void *arg) {
+  double *x = raw[c % nbuf];
+  unsigned int r = 12345u + 1000003u*c;
+  int i;
+
+  if (delay > 0) usleep(delay);
+  for (i=0; i<size; i++) {
+    r = r*1103515245u + 12345u;
+    x[i] = (r >> 8) / 16777216.0;
+  }
+}
+
+void transform(int c, void *arg) {
+  double *x = raw[c % nbuf], *y = out[c % nbuf], v;
+  int i, k;
+
+  for (i=0; i<size; i++) {
+    v = x[i];
+    for (k=0; k<work; k++) v = sqrt(v + 1.0);
+    y[i] = v;
+  }
+}
+
+void stats(int c, void *arg) {
+  double *x = raw[c % nbuf], lo = x[0], hi = x[0];
+  int i;
+
+  for (i=1; i<size; i++) {
+    if (x[i] < lo) lo = x[i];
+    if (x[i] > hi) hi = x[i];
+  }
+  cmin[c % nbuf] = lo;
+  cmax[c % nbuf] = hi;
+}
+
+void reduce(int c, void *arg) {
+  double *y = out[c % nbuf];
+  int i;
+
+  for (i=0; i<size; i++) total += y[i];
+  if (c == 0 || cmin[c % nbuf] < gmin) gmin = cmin[c % nbuf];
+  if (c == 0 || cmax[c % nbuf] > gmax) gmax = cmax[c % nbuf];
+}
+
+int main(int argc, char *argv[]) {
+  int b, c, opt, in[2], sread, strans, sstats;
+  double t, result[3];
+  df_pipeline *p;
+
+  while ((opt = getopt(argc, argv, "c:s:b:w:r:h")) != -1) {
+    switch (opt) {
+    case 'c': nchunks = atoi(optarg); break;
+    case 's': size = atoi(optarg); break;
+    case 'b': nbuf = atoi(optarg); break;
+    case 'w': work = atoi(optarg); break;
+    case 'r': delay = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (nchunks < 1 || size < 1 || nbuf < 1 || work < 0 || delay < 0) print_usage(argv[0]);
+
+  raw = (double **) malloc(nbuf*sizeof(double *));
+  out = (double **) malloc(nbuf*sizeof(double *));
+  for (b=0; b<nbuf; b++) {
+    raw[b] = (double *) malloc(size*sizeof(double));
+    out[b] = (double *) malloc(size*sizeof(double));
+  }
+  cmin = (double *) malloc(nbuf*sizeof(double));
+  cmax = (double *) malloc(nbuf*sizeof(double));
+
+  /* With sections, one chunk at a time */
+  total = 0.0;
+  t = omp_get_wtime();
+  for (c=0; c<nchunks; c++) {
+    read_chunk(c, NULL);
+#pragma omp parallel sections
+    {
+#pragma omp section
+      transform(c, NULL);
+#pragma omp section
+      stats(c, NULL);
+    }
+    reduce(c, NULL);
+  }
+  t = omp_get_wtime() - t;
+  result[0] = total; result[1] = gmin; result[2] = gmax;
+  printf("Sections: %.3f s, sum %.10g, min %g, max %g\n\n", t, total, gmin, gmax);
+
+  /* The pipeline */
+  p = df_create(nchunks, nbuf);
+  sread = df_stage(p, "read", read_chunk, NULL, 1, 0, NULL);
+  in[0] = sread;
+  strans = df_stage(p, "transform", transform, NULL, 0, 1, in);
+  sstats = df_stage(p, "stats", stats, NULL, 0, 1, in);
+  in[0] = strans;
+  in[1] = sstats;
+  df_stage(p, "reduce", reduce, NULL, 1, 2, in);
+
+  total = 0.0;
+  if (df_run(p) != 0) {
+    printf("The last stage does not depend on all the others\n");
+    exit(1);
+  }
+  printf("Pipeline: ");
+  df_report(p, stdout);
+  printf("Sum %.10g, min %g, max %g", total, gmin, gmax);
+  if (total != result[0] || gmin != result[1] || gmax != result[2])
+    printf(", different from the sections");
+  printf("\n");
+#if _OPENMP < 201307
+  printf("Compiled without OpenMP 4.0, the stages were run one at a time\n");
+#endif
+
+  df_free(p);
+  for (b=0; b<nbuf; b++) {
+    free(raw[b]);
+    free(out[b]);
+  }
+  free(raw); free(out); free(cmin); free(cmax);
+  exit(0);
+}
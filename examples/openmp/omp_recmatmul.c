@@ -0,0 +1,410 @@
+/*
+  OpenMP example program that multiplies matrices recursively with
+  tasks, and compares this with the parallel loops of omp_matrixmult.c.
+
+  The matrices are divided into four quadrants, and the product of two
+  matrices is computed from eight products of quadrants:
+
+    C00 = A00*B00 + A01*B10    C01 = A00*B01 + A01*B11
+    C10 = A10*B00 + A11*B10    C11 = A10*B01 + A11*B11
+
+  which are computed in the same way, until the blocks are small enough
+  to be multiplied with three loops. The four quadrants of C are computed
+  by different tasks. Tasks are only created down to a given depth of
+  the recursion, below that the products are computed by the task that
+  got there, so that there are enough tasks for the threads without too
+  much overhead.
+
+  Whatever the cache sizes are, at some depth the blocks fit in each
+  cache, so the method uses the caches well without knowing their sizes
+  (cache-oblivious). For this the matrices are stored in Morton order, or
+  Z-order: the four quadrants of a matrix are stored one after the other,
+  and so on recursively, so every block is in one piece of memory. The
+  smallest blocks are stored row by row. The matrices are converted to
+  Morton order before and back after the multiplication, and padded with
+  zeros to a size that can be halved down to the smallest blocks.
+
+  Above a cutoff size the Strassen-Winograd method can be used instead,
+  which computes the product from seven products of quadrants and 15
+  additions. This saves work for large matrices, but needs extra memory
+  and is less accurate. The cutoff is found by measuring the smallest
+  size for which one level of Strassen-Winograd is clearly faster than
+  the recursive method, or can be given with -s. All the values here are
+  small integers, so all the methods give exactly the same result.
+
+  The multiplication is done with 1, 2, 4, ... threads up to the maximum.
+  The loop version reads the columns of B with a large stride, so it gets
+  slower compared to the recursive one when the matrices are larger than
+  the caches.
+
+  Compile the program with 'gcc -O3 -fopenmp omp_recmatmul.c -o omp_recmatmul'
+  Run the program with './omp_recmatmul -n 2048'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+int leaf = 64;          /* Size of the blocks multiplied with loops */
+int maxdepth = 4;       /* Depth of the recursion down to which tasks are created */
+int cutoff = -1;        /* Strassen-Winograd for blocks larger than this, 0 = never */
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <matrix size> -l <max leaf size> -d <max task depth>\n", s);
+  printf("          -s <Strassen cutoff, 0 = off> -t <max threads>\n");
+  exit(0);
+}
+
+/* Position of element (i, j) in a matrix in Morton order. The bits of
+   the block row and column are interleaved, the row bit first */
+long morton_index(int i, int j) {
+  long z = 0;
+  int bi = i/leaf, bj = j/leaf, bit;
+
+  for (bit=0; bit<30 && (bi>>bit || bj>>bit); bit++) {
+    z |= (long) ((bi>>bit) & 1) << (2*bit+1);
+    z |= (long) ((bj>>bit) & 1) << (2*bit);
+  }
+  return z*leaf*leaf + (i%leaf)*leaf + j%leaf;
+}
+
+/* Copy an N x N matrix to an n x n matrix in Morton order, n >= N, and back */
+void to_morton(const double *src, int N, double *dst, int n) {
+  int i, j;
+
+#pragma omp parallel for private(j)
+  for (i=0; i<n; i++)
+    for (j=0; j<n; j++)
+      dst[morton_index(i, j)] = i < N && j < N ? src[(long)i*N+j] : 0.0;
+}
+
+void from_morton(const double *src, int n, double *dst, int N) {
+  int i, j;
+
+#pragma omp parallel for private(j)
+  for (i=0; i<N; i++)
+    for (j=0; j<N; j++)
+      dst[(long)i*N+j] = src[morton_index(i, j)];
+}
+
+/* C += A*B for blocks of leaf x leaf stored row by row */
+void leaf_mult(double *c, const double *a, const double *b) {
+  int i, j, k;
+  double aik;
+
+  for (i=0; i<leaf; i++)
+    for (k=0; k<leaf; k++) {
+      aik = a[i*leaf+k];
+      for (j=0; j<leaf; j++)
+	c[i*leaf+j] += aik*b[k*leaf+j];
+    }
+}
+
+/* C += A*B for s x s blocks in Morton order. The quadrants of a block are
+   at offsets 0, q, 2q and 3q */
+void rec_mult(double *c, const double *a, const double *b, int s, int depth) {
+  int h = s/2;
+  long q = (long)h*h;
+
+  if (s <= leaf) {
+    leaf_mult(c, a, b);
+    return;
+  }
+  if (depth < maxdepth) {
+    /* One task per quadrant of C, so the tasks do not write to the same
+       memory */
+#pragma omp task
+    {
+      rec_mult(c, a, b, h, depth+1);
+      rec_mult(c, a+q, b+2*q, h, depth+1);
+    }
+#pragma omp task
+    {
+      rec_mult(c+q, a, b+q, h, depth+1);
+      rec_mult(c+q, a+q, b+3*q, h, depth+1);
+    }
+#pragma omp task
+    {
+      rec_mult(c+2*q, a+2*q, b, h, depth+1);
+      rec_mult(c+2*q, a+3*q, b+2*q, h, depth+1);
+    }
+#pragma omp task
+    {
+      rec_mult(c+3*q, a+2*q, b+q, h, depth+1);
+      rec_mult(c+3*q, a+3*q, b+3*q, h, depth+1);
+    }
+#pragma omp taskwait
+  }
+  else {
+    rec_mult(c, a, b, h, depth+1);
+    rec_mult(c, a+q, b+2*q, h, depth+1);
+    rec_mult(c+q, a, b+q, h, depth+1);
+    rec_mult(c+q, a+q, b+3*q, h, depth+1);
+    rec_mult(c+2*q, a+2*q, b, h, depth+1);
+    rec_mult(c+2*q, a+3*q, b+2*q, h, depth+1);
+    rec_mult(c+3*q, a+2*q, b+q, h, depth+1);
+    rec_mult(c+3*q, a+3*q, b+3*q, h, depth+1);
+  }
+}
+
+void strassen(double *c, const double *a, const double *b, int s, int depth);
+
+/* C = A*B for s x s blocks in Morton order */
+void multiply(double *c, const double *a, const double *b, int s, int depth) {
+  if (cutoff > 0 && s > cutoff && s > leaf)
+    strassen(c, a, b, s, depth);
+  else {
+    memset(c, 0, (long)s*s*sizeof(double));
+    rec_mult(c, a, b, s, depth);
+  }
+}
+
+/* The sums of quadrants that are multiplied, for elements lo..hi-1 */
+void winograd_sums(const double *a, const double *b, double *t, long q, long lo, long hi) {
+  const double *a11 = a, *a12 = a+q, *a21 = a+2*q, *a22 = a+3*q;
+  const double *b11 = b, *b12 = b+q, *b21 = b+2*q, *b22 = b+3*q;
+  double *s1 = t, *s2 = t+q, *s3 = t+2*q, *s4 = t+3*q;
+  double *t1 = t+4*q, *t2 = t+5*q, *t3 = t+6*q, *t4 = t+7*q;
+  long l;
+
+  for (l=lo; l<hi; l++) {
+    s1[l] = a21[l] + a22[l];
+    s2[l] = s1[l] - a11[l];
+    s3[l] = a11[l] - a21[l];
+    s4[l] = a12[l] - s2[l];
+    t1[l] = b12[l] - b11[l];
+    t2[l] = b22[l] - t1[l];
+    t3[l] = b22[l] - b12[l];
+    t4[l] = t2[l] - b21[l];
+  }
+}
+
+/* The quadrants of C from the seven products, for elements lo..hi-1 */
+void winograd_result(double *c, const double *m, long q, long lo, long hi) {
+  const double *m1 = m, *m2 = m+q, *m3 = m+2*q, *m4 = m+3*q, *m5 = m+4*q,
+    *m6 = m+5*q, *m7 = m+6*q;
+  double u2, u3;
+  long l;
+
+  for (l=lo; l<hi; l++) {
+    u2 = m1[l] + m6[l];
+    u3 = u2 + m7[l];
+    c[l] = m1[l] + m2[l];
+    c[q+l] = u2 + m5[l] + m3[l];
+    c[2*q+l] = u3 - m4[l];
+    c[3*q+l] = u3 + m5[l];
+  }
+}
+
+#define CHUNK 65536
+
+/* C = A*B with one level of Strassen-Winograd */
+void strassen(double *c, const double *a, const double *b, int s, int depth) {
+  int h = s/2;
+  long q = (long)h*h, l;
+  double *t, *m;
+
+  t = (double *) malloc(8*q*sizeof(double));
+  m = (double *) malloc(7*q*sizeof(double));
+
+  if (depth < maxdepth) {
+    for (l=0; l<q; l+=CHUNK) {
+#pragma omp task
+      winograd_sums(a, b, t, q, l, l+CHUNK < q ? l+CHUNK : q);
+    }
+#pragma omp taskwait
+#pragma omp task
+    multiply(m, a, b, h, depth+1);                    /* A11*B11 */
+#pragma omp task
+    multiply(m+q, a+q, b+2*q, h, depth+1);            /* A12*B21 */
+#pragma omp task
+    multiply(m+2*q, t+3*q, b+3*q, h, depth+1);        /* S4*B22 */
+#pragma omp task
+    multiply(m+3*q, a+3*q, t+7*q, h, depth+1);        /* A22*T4 */
+#pragma omp task
+    multiply(m+4*q, t, t+4*q, h, depth+1);            /* S1*T1 */
+#pragma omp task
+    multiply(m+5*q, t+q, t+5*q, h, depth+1);          /* S2*T2 */
+#pragma omp task
+    multiply(m+6*q, t+2*q, t+6*q, h, depth+1);        /* S3*T3 */
+#pragma omp taskwait
+    for (l=0; l<q; l+=CHUNK) {
+#pragma omp task
+      winograd_result(c, m, q, l, l+CHUNK < q ? l+CHUNK : q);
+    }
+#pragma omp taskwait
+  }
+  else {
+    winograd_sums(a, b, t, q, 0, q);
+    multiply(m, a, b, h, depth+1);
+    multiply(m+q, a+q, b+2*q, h, depth+1);
+    multiply(m+2*q, t+3*q, b+3*q, h, depth+1);
+    multiply(m+3*q, a+3*q, t+7*q, h, depth+1);
+    multiply(m+4*q, t, t+4*q, h, depth+1);
+    multiply(m+5*q, t+q, t+5*q, h, depth+1);
+    multiply(m+6*q, t+2*q, t+6*q, h, depth+1);
+    winograd_result(c, m, q, 0, q);
+  }
+
+  free(t);
+  free(m);
+}
+
+/* Multiply n x n matrices in Morton order with the threads of a parallel
+   region, started by one thread */
+double run_recursive(double *c, const double *a, const double *b, int n) {
+  double t = omp_get_wtime();
+
+#pragma omp parallel
+  {
+#pragma omp single
+    multiply(c, a, b, n, 0);
+  }
+  return omp_get_wtime() - t;
+}
+
+/* The parallel loops of omp_matrixmult.c, for N x N matrices row by row */
+double run_loops(double *c, const double *a, const double *b, int N) {
+  double t = omp_get_wtime(), s;
+  int i, j, k;
+
+#pragma omp parallel for private(j, k, s)
+  for (i=0; i<N; i++)
+    for (j=0; j<N; j++) {
+      s = 0.0;
+      for (k=0; k<N; k++) s += a[(long)i*N+k]*b[(long)k*N+j];
+      c[(long)i*N+j] = s;
+    }
+  return omp_get_wtime() - t;
+}
+
+/* Time for one multiplication of s x s matrices by one thread, with the
+   current cutoff, repeated for at least 0.1 s */
+double time_one(double *c, const double *a, const double *b, int s) {
+  double t, start = omp_get_wtime();
+  int r = 0, depth = maxdepth;
+
+  maxdepth = 0;
+  do {
+    multiply(c, a, b, s, 0);
+    r++;
+    t = omp_get_wtime() - start;
+  } while (t < 0.1);
+  maxdepth = depth;
+  return t/r;
+}
+
+/* The smallest block size at which one level of Strassen-Winograd is
+   faster than the recursive method. Returns the cutoff, or 0 */
+int tune_cutoff(const double *a, const double *b, double *c, int n) {
+  double t0, t1;
+  int s;
+
+  for (s=2*leaf; s<=n && s<=2048; s*=2) {
+    cutoff = 0;
+    t0 = time_one(c, a, b, s);
+    cutoff = s/2;
+    t1 = time_one(c, a, b, s);
+    printf("Size %5d: recursive %.4f s, Strassen-Winograd %.4f s\n", s, t0, t1);
+    if (t1 < 0.95*t0) return s/2;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int N = 1024, n, levels, maxthreads, threads, i, opt, saved;
+  double *a, *b, *c, *d, *am, *bm, *cm, t, tloop, trec, tstr, trec1 = 0.0, flops, diff;
+
+  maxthreads = omp_get_max_threads();
+  while ((opt = getopt(argc, argv, "n:l:d:s:t:h")) != -1) {
+    switch (opt) {
+    case 'n': N = atoi(optarg); break;
+    case 'l': leaf = atoi(optarg); break;
+    case 'd': maxdepth = atoi(optarg); break;
+    case 's': cutoff = atoi(optarg); break;
+    case 't': maxthreads = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (N < 1 || leaf < 1 || maxdepth < 0 || maxthreads < 1) print_usage(argv[0]);
+
+  /* Halve the matrix until the blocks are at most leaf, and round the
+     block size up to a multiple of 8 */
+  for (levels=0; (N + (1<<levels) - 1)>>levels > leaf; levels++);
+  leaf = (((N + (1<<levels) - 1)>>levels) + 7)/8*8;
+  n = leaf<<levels;
+
+  a = (double *) malloc((long)N*N*sizeof(double));
+  b = (double *) malloc((long)N*N*sizeof(double));
+  c = (double *) malloc((long)N*N*sizeof(double));
+  d = (double *) malloc((long)N*N*sizeof(double));
+  am = (double *) malloc((long)n*n*sizeof(double));
+  bm = (double *) malloc((long)n*n*sizeof(double));
+  cm = (double *) malloc((long)n*n*sizeof(double));
+  for (i=0; i<N*N; i++) {
+    a[i] = (double) (i % 7 - 3);
+    b[i] = (double) (i % 5 - 2);
+  }
+
+  t = omp_get_wtime();
+  to_morton(a, N, am, n);
+  to_morton(b, N, bm, n);
+  t = omp_get_wtime() - t;
+  printf("%d x %d matrices, padded to %d = %d x 2^%d in Morton order in %.3f s\n",
+	 N, N, n, leaf, levels, t);
+
+  if (cutoff < 0) {
+    cutoff = tune_cutoff(am, bm, cm, n);
+    if (cutoff > 0)
+      printf("Strassen-Winograd for blocks larger than %d\n", cutoff);
+    else
+      printf("Strassen-Winograd is not faster for these sizes\n");
+  }
+  printf("Tasks down to depth %d of the recursion\n\n", maxdepth);
+
+  flops = 2.0*N*N*N;
+  printf("%7s %18s %18s %18s %8s %8s\n", "threads", "loops s GFLOP/s",
+	 "recursive", "Strassen", "speedup", "eff");
+  for (threads=1; ; threads = 2*threads < maxthreads ? 2*threads : maxthreads) {
+    omp_set_num_threads(threads);
+
+    tloop = run_loops(d, a, b, N);
+
+    saved = cutoff;
+    cutoff = 0;
+    trec = run_recursive(cm, am, bm, n);
+    cutoff = saved;
+    from_morton(cm, n, c, N);
+    diff = 0.0;
+    for (i=0; i<N*N; i++)
+      if (fabs(c[i] - d[i]) > diff) diff = fabs(c[i] - d[i]);
+
+    tstr = 0.0;
+    if (cutoff > 0) {
+      tstr = run_recursive(cm, am, bm, n);
+      from_morton(cm, n, c, N);
+      for (i=0; i<N*N; i++)
+	if (fabs(c[i] - d[i]) > diff) diff = fabs(c[i] - d[i]);
+    }
+
+    if (threads == 1) trec1 = trec;
+    printf("%7d %8.3f %9.2f %8.3f %9.2f", threads, tloop, flops/tloop*1e-9,
+	   trec, flops/trec*1e-9);
+    if (cutoff > 0)
+      printf(" %8.3f %9.2f", tstr, flops/tstr*1e-9);
+    else
+      printf(" %18s", "-");
+    printf(" %8.2f %7.1f%%", tloop/trec, 100.0*trec1/(trec*threads));
+    if (diff != 0.0) printf("  results differ by %g", diff);
+    printf("\n");
+    if (threads == maxthreads) break;
+  }
+  printf("\nspeedup: loops / recursive, eff: parallel efficiency of the recursive method\n");
+
+  free(a); free(b); free(c); free(d); free(am); free(bm); free(cm);
+  exit(0);
+}
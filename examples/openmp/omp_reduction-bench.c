@@ -0,0 +1,253 @@
+/*
+  OpenMP example program that compares ways to add up the results of
+  the threads, with the dot product of omp_critical.c and omp_reduction.c
+  (and pt_dotprod.c with Pthreads).
+
+  The same dot product sum(a[i]*b[i]) is computed with:
+
+    critical   every product is added to the shared sum in a critical
+               region
+    atomic     every product is added to the shared sum with
+               #pragma omp atomic
+    cas        every product is added to the shared sum with a
+               compare-and-swap loop, as lock-free code does
+    local      each thread adds its products in a private variable, and
+               the private sums are added in a critical region at the end,
+               as in omp_critical.c
+    reduction  the reduction clause, as in omp_reduction.c
+    padded     each thread adds its products in its own element of a
+               shared array, with the elements 64 bytes apart
+    unpadded   the same with the elements next to each other. They are
+               in the same cache line, so the cache line moves between
+               the cores at every addition although the threads never
+               use the same data (false sharing)
+
+  In padded and unpadded the array is declared volatile so that the
+  compiler does not keep the sums in registers, which it could do in a
+  real program but often does not when it cannot see that the pointers
+  do not overlap.
+
+  The methods are run for a range of vector sizes and 1, 2, 4, ... threads
+  up to the maximum. The time is given in nanoseconds per element, and
+  the parallel efficiency is t(1)/(p*t(p)) for p threads. The first three
+  methods are so slow with many threads that they are run with at most
+  1M elements and fewer repetitions, which does not change their time
+  per element much.
+
+  Compile the program with 'gcc -O2 -fopenmp omp_reduction-bench.c -o omp_reduction-bench'
+  Run the program with './omp_reduction-bench -n 16777216'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define PAD 8              /* Doubles in a cache line of 64 bytes */
+#define MAXTHREADS 1024
+#define CONTENDED (1<<20)  /* Elements for the methods that synchronize every element */
+#define MINTIME 0.1        /* Seconds of repetitions that are enough */
+
+volatile double partial[MAXTHREADS*PAD];
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <max vector size> -t <max threads>\n", s);
+  exit(0);
+}
+
+double dot_critical(const double *a, const double *b, long n) {
+  double sum = 0.0;
+  long i;
+
+#pragma omp parallel for
+  for (i=0; i<n; i++) {
+#pragma omp critical
+    sum += a[i]*b[i];
+  }
+  return sum;
+}
+
+double dot_atomic(const double *a, const double *b, long n) {
+  double sum = 0.0;
+  long i;
+
+#pragma omp parallel for
+  for (i=0; i<n; i++) {
+#pragma omp atomic
+    sum += a[i]*b[i];
+  }
+  return sum;
+}
+
+/* Add v to *x with compare-and-swap on the bits of the double */
+void cas_add(volatile double *x, double v) {
+  union { double d; long long l; } old, sum;
+
+  do {
+    old.d = *x;
+    sum.d = old.d + v;
+  } while (!__sync_bool_compare_and_swap((volatile long long *) x, old.l, sum.l));
+}
+
+double dot_cas(const double *a, const double *b, long n) {
+  volatile double sum = 0.0;
+  long i;
+
+#pragma omp parallel for
+  for (i=0; i<n; i++)
+    cas_add(&sum, a[i]*b[i]);
+  return sum;
+}
+
+double dot_local(const double *a, const double *b, long n) {
+  double sum = 0.0, local;
+  long i;
+
+#pragma omp parallel private(local)
+  {
+    local = 0.0;
+#pragma omp for
+    for (i=0; i<n; i++)
+      local += a[i]*b[i];
+#pragma omp critical
+    sum += local;
+  }
+  return sum;
+}
+
+double dot_reduction(const double *a, const double *b, long n) {
+  double sum = 0.0;
+  long i;
+
+#pragma omp parallel for reduction(+:sum)
+  for (i=0; i<n; i++)
+    sum += a[i]*b[i];
+  return sum;
+}
+
+/* Each thread adds to partial[tid*stride] */
+double dot_array(const double *a, const double *b, long n, int stride) {
+  double sum = 0.0;
+  int t, nthreads = 1;
+  long i;
+
+#pragma omp parallel
+  {
+    int tid = omp_get_thread_num();
+
+#pragma omp single
+    nthreads = omp_get_num_threads();
+    partial[tid*stride] = 0.0;
+#pragma omp for
+    for (i=0; i<n; i++)
+      partial[tid*stride] += a[i]*b[i];
+  }
+  for (t=0; t<nthreads; t++) sum += partial[t*stride];
+  return sum;
+}
+
+double dot_padded(const double *a, const double *b, long n) {
+  return dot_array(a, b, n, PAD);
+}
+
+double dot_unpadded(const double *a, const double *b, long n) {
+  return dot_array(a, b, n, 1);
+}
+
+struct {
+  char *name;
+  double (*dot)(const double *, const double *, long);
+  int contended;
+} methods[] = {
+  {"critical", dot_critical, 1},
+  {"atomic", dot_atomic, 1},
+  {"cas", dot_cas, 1},
+  {"local", dot_local, 0},
+  {"reduction", dot_reduction, 0},
+  {"padded", dot_padded, 0},
+  {"unpadded", dot_unpadded, 0}
+};
+#define NMETHODS (int) (sizeof(methods)/sizeof(methods[0]))
+
+/* Nanoseconds per element for n elements, with the repetitions taking
+   about 2^24 elements in total, or CONTENDED for the slow methods. The
+   repetitions stop after MINTIME seconds, since for small n each one is
+   mostly the start of a parallel region. Sets *ok to 0 if the result is
+   wrong */
+double measure(int m, const double *a, const double *b, long n, int *ok) {
+  double t, sum = 0.0, exact;
+  long reps, r, i;
+
+  if (methods[m].contended && n > CONTENDED) n = CONTENDED;
+  reps = (methods[m].contended ? CONTENDED : 1L<<24)/n;
+  if (reps < 1) reps = 1;
+
+  /* a[i]*b[i] = i%10, so the sum is exact whatever the order */
+  exact = 45.0*(n/10);
+  for (i=n/10*10; i<n; i++) exact += i%10;
+
+  methods[m].dot(a, b, n);
+  t = omp_get_wtime();
+  for (r=0; r<reps; ) {
+    sum = methods[m].dot(a, b, n);
+    r++;
+    if (omp_get_wtime() - t >= MINTIME) break;
+  }
+  t = omp_get_wtime() - t;
+  if (sum != exact) *ok = 0;
+  return t/((double)r*n)*1e9;
+}
+
+int main(int argc, char *argv[]) {
+  long maxn = 1<<22, n, i;
+  int maxthreads, threads[32], nt, t, m, ok, opt;
+  double *a, *b, ns[32], ns1;
+
+  maxthreads = omp_get_max_threads();
+  while ((opt = getopt(argc, argv, "n:t:h")) != -1) {
+    switch (opt) {
+    case 'n': maxn = atol(optarg); break;
+    case 't': maxthreads = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (maxn < 1 || maxthreads < 1 || maxthreads > MAXTHREADS) print_usage(argv[0]);
+
+  /* Thread counts 1, 2, 4, ... and the maximum */
+  nt = 0;
+  for (t=1; t<maxthreads; t*=2) threads[nt++] = t;
+  threads[nt++] = maxthreads;
+
+  a = (double *) malloc(maxn*sizeof(double));
+  b = (double *) malloc(maxn*sizeof(double));
+#pragma omp parallel for
+  for (i=0; i<maxn; i++) {
+    a[i] = (double) (i%10);
+    b[i] = 1.0;
+  }
+
+  for (n = maxn < 1024 ? maxn : 1024; ; n = 16*n < maxn ? 16*n : maxn) {
+    printf("\n%ld elements, ns per element and parallel efficiency\n%-10s", n, "threads");
+    for (t=0; t<nt; t++) printf(" %12d", threads[t]);
+    printf("\n");
+
+    for (m=0; m<NMETHODS; m++) {
+      printf("%-10s", methods[m].name);
+      ok = 1;
+      for (t=0; t<nt; t++) {
+	omp_set_num_threads(threads[t]);
+	ns[t] = measure(m, a, b, n, &ok);
+      }
+      ns1 = ns[0];
+      for (t=0; t<nt; t++)
+	printf(" %7.2f %3.0f%%", ns[t], 100.0*ns1/(threads[t]*ns[t]));
+      if (!ok) printf("  wrong sum");
+      printf("\n");
+    }
+    if (n == maxn) break;
+  }
+
+  free(a); free(b);
+  exit(0);
+}
@@ -0,0 +1,193 @@
+/*
+  OpenMP example program that compares the schedules of the for
+  construct for loops where the iterations take different times, and
+  tunes the schedule at run time with schedtune.c.
+
+  The loop has n iterations, and iteration i does cost[i] units of work.
+  Three kinds of work are used:
+
+    uniform  every iteration does the same work
+    linear   the work grows linearly with i, as in a loop over the
+             rows of a triangular matrix
+    random   the work of each iteration is random, with an exponential
+             distribution, so a few iterations take much longer
+
+  with the same total work. Each is run with the static, dynamic and
+  guided schedules with chunk sizes 1, 4, 16, ... up to n/threads, and
+  with the default static schedule and auto. The schedule is set with
+  omp_set_schedule and the loop uses schedule(runtime). The efficiency is
+  the time of the work done by one thread divided by the number of
+  threads and the time of the loop.
+
+  With static scheduling the iterations are divided in advance, which
+  costs nothing, but with uneven work some threads finish early and wait.
+  Dynamic and guided scheduling give out chunks of iterations as the
+  threads ask for them, which balances the work but costs some time for
+  every chunk.
+
+  At the end the loop for each kind of work is run a number of times with
+  the autotuner of schedtune.c, which tries the schedules in the first
+  runs and then uses the fastest one.
+
+  Compile the program with 'gcc -O2 -fopenmp omp_schedule.c schedtune.c -o omp_schedule -lm'
+  Run the program with './omp_schedule -n 2000 -w 2000'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include "schedtune.h"
+
+#define UNIFORM 0
+#define LINEAR 1
+#define RANDOM 2
+
+int n = 2000;             /* Iterations of the loop */
+double unit = 2000.0;     /* Average work of an iteration */
+int *cost;
+double *result;
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <iterations> -w <average work per iteration> -r <runs of tuned loop>\n", s);
+  exit(0);
+}
+
+/* Some work that the compiler cannot remove */
+double work(int units) {
+  double x = 0.0;
+  int k;
+
+  for (k=0; k<units; k++) x = x*0.999999 + 1.0;
+  return x;
+}
+
+void set_costs(int kind) {
+  int i;
+
+  srand(12345);
+  for (i=0; i<n; i++) {
+    switch (kind) {
+    case UNIFORM: cost[i] = (int) unit; break;
+    case LINEAR: cost[i] = (int) (2.0*unit*(i+0.5)/n); break;
+    default: cost[i] = (int) (-unit*log((rand() + 1.0)/(RAND_MAX + 2.0)));
+    }
+  }
+}
+
+/* The loop, with the schedule set by omp_set_schedule */
+double run_loop(void) {
+  double t = omp_get_wtime();
+  int i;
+
+#pragma omp parallel for schedule(runtime)
+  for (i=0; i<n; i++)
+    result[i] = work(cost[i]);
+  return omp_get_wtime() - t;
+}
+
+/* Shortest time of three runs with the given schedule */
+double measure(omp_sched_t kind, int chunk) {
+  double t, best = 1e300;
+  int r;
+
+  omp_set_schedule(kind, chunk);
+  for (r=0; r<3; r++) {
+    t = run_loop();
+    if (t < best) best = t;
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  char *names[3] = {"uniform", "linear", "random"}, buf[32];
+  omp_sched_t kinds[3] = {omp_sched_static, omp_sched_dynamic, omp_sched_guided};
+  int nthreads, w, k, chunk, i, r, runs = 50, opt, bestchunk = 0, nsched, schunk[64];
+  double serial, t, best, tuned, total;
+  omp_sched_t bestkind = omp_sched_static, skind[64];
+
+  while ((opt = getopt(argc, argv, "n:w:r:h")) != -1) {
+    switch (opt) {
+    case 'n': n = atoi(optarg); break;
+    case 'w': unit = atof(optarg); break;
+    case 'r': runs = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (n < 1 || unit < 1.0 || runs < 1) print_usage(argv[0]);
+
+  cost = (int *) malloc(n*sizeof(int));
+  result = (double *) malloc(n*sizeof(double));
+  nthreads = omp_get_max_threads();
+  printf("%d iterations, %d threads\n", n, nthreads);
+
+  /* The default static schedule, the three kinds with chunk sizes 1, 4,
+     16, ... up to n/threads, and auto */
+  nsched = 0;
+  skind[nsched] = omp_sched_static;
+  schunk[nsched++] = 0;
+  for (k=0; k<3; k++)
+    for (chunk=1; chunk <= (n + nthreads - 1)/nthreads && nsched < 62; chunk *= 4) {
+      skind[nsched] = kinds[k];
+      schunk[nsched++] = chunk;
+    }
+  skind[nsched] = omp_sched_auto;
+  schunk[nsched++] = 0;
+
+  for (w=UNIFORM; w<=RANDOM; w++) {
+    set_costs(w);
+    t = omp_get_wtime();
+    for (i=0; i<n; i++) result[i] = work(cost[i]);
+    serial = omp_get_wtime() - t;
+
+    printf("\n%s work, %.2f ms with one thread\n", names[w], serial*1e3);
+    printf("%-16s %10s %6s\n", "schedule", "time ms", "eff");
+    best = 1e300;
+    for (k=0; k<nsched; k++) {
+      t = measure(skind[k], schunk[k]);
+      printf("%-16s %10.3f %5.1f%%\n", sched_name(skind[k], schunk[k], buf),
+	     t*1e3, 100.0*serial/(nthreads*t));
+      if (t < best) {
+	best = t;
+	bestkind = skind[k];
+	bestchunk = schunk[k];
+      }
+    }
+    printf("Fastest: %s\n", sched_name(bestkind, bestchunk, buf));
+  }
+
+  /* The autotuner, with one loop id per kind of work */
+  printf("\nAutotuned, %d runs of each loop\n", runs);
+  printf("%-10s %-16s %14s %14s\n", "work", "chosen", "tuned ms/run", "all ms/run");
+  for (w=UNIFORM; w<=RANDOM; w++) {
+    set_costs(w);
+    tuned = total = 0.0;
+    k = 0;
+    for (r=0; r<runs; r++) {
+      sched_tune_begin(w);
+      t = omp_get_wtime();
+#pragma omp parallel for schedule(runtime)
+      for (i=0; i<n; i++)
+	result[i] = work(cost[i]);
+      t = omp_get_wtime() - t;
+      /* sched_tune_get before the end of the run tells if this run was
+	 done with the chosen schedule */
+      if (sched_tune_get(w, &bestkind, &bestchunk)) {
+	tuned += t;
+	k++;
+      }
+      sched_tune_end(w);
+      total += t;
+    }
+    if (sched_tune_get(w, &bestkind, &bestchunk))
+      printf("%-10s %-16s %14.3f %14.3f\n", names[w], sched_name(bestkind, bestchunk, buf),
+	     k ? tuned/k*1e3 : 0.0, total/runs*1e3);
+    else
+      printf("%-10s %-16s %14s %14.3f\n", names[w], "not yet", "-", total/runs*1e3);
+  }
+
+  free(cost); free(result);
+  exit(0);
+}
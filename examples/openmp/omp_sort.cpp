@@ -0,0 +1,256 @@
+/*
+  OpenMP example program in C++ that compares ways of sorting an array
+  of unsigned integer keys in parallel:
+
+    std::sort         the sequential sort of the C++ library
+    gnu mwms          __gnu_parallel::sort from the parallel mode of the
+    gnu quicksort     C++ library of gcc, with each of its algorithms
+    gnu balanced qs   (_SortAlgorithm MWMS, QS and QS_BALANCED), chosen
+                      with __gnu_parallel::_Settings
+    task mergesort    a mergesort that sorts the halves in OpenMP tasks
+                      and merges them with a parallel merge, and uses
+                      std::sort below a cutoff
+    radix             a parallel LSD radix sort, 8 bits per pass. Every
+                      thread counts the digits in its part of the array,
+                      the counts give every thread the place where its
+                      keys with each digit go, and the threads then move
+                      their keys there. A pass where all keys have the
+                      same digit is skipped
+
+  The keys are uniformly random, already sorted, sorted in reverse, or
+  random with only 16 different values. Every result is compared with
+  the result of std::sort.
+
+  The parallel mode can also be used by compiling with -D_GLIBCXX_PARALLEL,
+  which makes std::sort and the other algorithms parallel. Here it is
+  called explicitly so that std::sort stays sequential.
+
+  Compile the program with 'g++ -O3 -fopenmp omp_sort.cpp -o omp_sort'
+  Run the program with './omp_sort -n 100000000 -t 4'. The sizes go from
+  one million keys up to -n by factors of ten, so '-n 1000000000' sorts a
+  billion keys, which needs 16 GB of memory.
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <parallel/algorithm>
+
+#define NALGS 6
+#define NDISTS 4
+
+typedef unsigned int key;
+
+const char *alg_name[NALGS] = { "std::sort", "gnu mwms", "gnu quicksort", "gnu balanced qs",
+				"task mergesort", "radix" };
+const char *dist_name[NDISTS] = { "uniform", "sorted", "reverse", "few-unique" };
+
+long cutoff = 16384;            /* Smallest part that the mergesort splits */
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <largest number of keys> -t <threads> -c <mergesort cutoff> -r <trials>\n", s);
+  exit(0);
+}
+
+/* A random number for every index, so that the keys can be made in
+   parallel */
+key hash(unsigned long i) {
+  unsigned long long x = i*0x9e3779b97f4a7c15ULL;
+
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return (key) x;
+}
+
+void make_keys(key *a, long n, int dist) {
+  long i;
+
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++)
+    switch (dist) {
+    case 0: a[i] = hash(i); break;
+    case 1: a[i] = (key) (i*(4294967295.0/n)); break;
+    case 2: a[i] = (key) ((n-1-i)*(4294967295.0/n)); break;
+    default: a[i] = hash(i) % 16 * 268435456u; break;
+    }
+}
+
+/* Merge a and b into out. The middle element of the longer one is put
+   in its place, and the parts on both sides of it are merged in
+   parallel */
+void parallel_merge(const key *a, long na, const key *b, long nb, key *out) {
+  long ma, mb;
+
+  if (na < nb) {
+    std::swap(a, b);
+    std::swap(na, nb);
+  }
+  if (na + nb <= cutoff) {
+    std::merge(a, a+na, b, b+nb, out);
+    return;
+  }
+  ma = na/2;
+  mb = std::lower_bound(b, b+nb, a[ma]) - b;
+  out[ma+mb] = a[ma];
+#pragma omp task
+  parallel_merge(a, ma, b, mb, out);
+  parallel_merge(a+ma+1, na-ma-1, b+mb, nb-mb, out+ma+mb+1);
+#pragma omp taskwait
+}
+
+/* Sort the n keys in src, with the result in dst if in_dst is 1 and in
+   src otherwise. The other array is used for the merge. The halves are
+   sorted into the array that they are merged from */
+void task_mergesort(key *src, key *dst, long n, int in_dst) {
+  long h = n/2;
+
+  if (n <= cutoff) {
+    std::sort(src, src+n);
+    if (in_dst) std::copy(src, src+n, dst);
+    return;
+  }
+#pragma omp task
+  task_mergesort(src, dst, h, !in_dst);
+  task_mergesort(src+h, dst+h, n-h, !in_dst);
+#pragma omp taskwait
+  if (in_dst) parallel_merge(src, h, src+h, n-h, dst);
+  else parallel_merge(dst, h, dst+h, n-h, src);
+}
+
+void radix_sort(key *a, key *tmp, long n) {
+  long *count = new long[omp_get_max_threads()*256];
+  key *src = a, *dst = tmp;
+  long i, sum, v;
+  int shift, skip, t, d;
+
+  for (shift=0; shift<32; shift+=8) {
+#pragma omp parallel private(i, t, d, sum, v)
+    {
+      int me = omp_get_thread_num(), nt = omp_get_num_threads();
+      long lo = n*me/nt, hi = n*(me+1)/nt, *c = count + me*256;
+
+      for (d=0; d<256; d++) c[d] = 0;
+      for (i=lo; i<hi; i++) c[(src[i] >> shift) & 255]++;
+#pragma omp barrier
+#pragma omp single
+      {
+	/* The keys with digit d of thread t go after those with smaller
+	   digits, and after those with digit d of threads before t */
+	skip = 0;
+	sum = 0;
+	for (d=0; d<256; d++) {
+	  for (v=0, t=0; t<nt; t++) v += count[t*256+d];
+	  if (v == n) skip = 1;
+	  for (t=0; t<nt; t++) {
+	    v = count[t*256+d];
+	    count[t*256+d] = sum;
+	    sum += v;
+	  }
+	}
+      }
+      if (!skip)
+	for (i=lo; i<hi; i++)
+	  dst[c[(src[i] >> shift) & 255]++] = src[i];
+    }
+    if (!skip) std::swap(src, dst);
+  }
+  if (src != a) {
+#pragma omp parallel for schedule(static)
+    for (i=0; i<n; i++) a[i] = src[i];
+  }
+  delete [] count;
+}
+
+void gnu_sort(key *a, long n, __gnu_parallel::_SortAlgorithm alg) {
+  __gnu_parallel::_Settings s = __gnu_parallel::_Settings::get();
+
+  s.sort_algorithm = alg;
+  __gnu_parallel::_Settings::set(s);
+  __gnu_parallel::sort(a, a+n);
+}
+
+void run(int alg, key *a, key *tmp, long n) {
+  switch (alg) {
+  case 0: std::sort(a, a+n); break;
+  case 1: gnu_sort(a, n, __gnu_parallel::MWMS); break;
+  case 2: gnu_sort(a, n, __gnu_parallel::QS); break;
+  case 3: gnu_sort(a, n, __gnu_parallel::QS_BALANCED); break;
+  case 4:
+#pragma omp parallel
+#pragma omp single
+    task_mergesort(a, tmp, n, 0);
+    break;
+  case 5: radix_sort(a, tmp, n); break;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  long nmax = 10000000, n, i;
+  int nthreads = omp_get_max_threads(), trials = 1, opt, alg, dist, r;
+  double t, best, rate[NALGS][NDISTS];
+  key *input, *a, *tmp, *ref;
+  bool wrong;
+
+  while ((opt = getopt(argc, argv, "n:t:c:r:h")) != -1) {
+    switch (opt) {
+    case 'n': nmax = (long) atof(optarg); break;
+    case 't': nthreads = atoi(optarg); break;
+    case 'c': cutoff = atol(optarg); break;
+    case 'r': trials = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (nmax < 1000 || nthreads < 1 || cutoff < 2 || trials < 1) print_usage(argv[0]);
+  omp_set_num_threads(nthreads);
+
+  input = new key[nmax];
+  a = new key[nmax];
+  tmp = new key[nmax];
+  ref = new key[nmax];
+
+  for (n=nmax < 1000000 ? nmax : 1000000; n<=nmax; n = n*10 <= nmax || n == nmax ? n*10 : nmax) {
+    printf("%ld keys, %d threads, million keys per second\n", n, nthreads);
+    for (dist=0; dist<NDISTS; dist++) {
+      make_keys(input, n, dist);
+      std::copy(input, input+n, ref);
+      std::sort(ref, ref+n);
+
+      for (alg=0; alg<NALGS; alg++) {
+	best = 1e300;
+	wrong = false;
+	for (r=0; r<trials; r++) {
+#pragma omp parallel for schedule(static)
+	  for (i=0; i<n; i++) a[i] = input[i];
+	  t = omp_get_wtime();
+	  run(alg, a, tmp, n);
+	  t = omp_get_wtime() - t;
+	  if (t < best) best = t;
+	  if (!std::equal(a, a+n, ref)) wrong = true;
+	}
+	rate[alg][dist] = wrong ? -1.0 : n/best*1e-6;
+      }
+    }
+
+    printf("%-16s", "");
+    for (dist=0; dist<NDISTS; dist++) printf(" %10s", dist_name[dist]);
+    printf("\n");
+    for (alg=0; alg<NALGS; alg++) {
+      printf("%-16s", alg_name[alg]);
+      for (dist=0; dist<NDISTS; dist++)
+	if (rate[alg][dist] < 0.0) printf(" %10s", "wrong");
+	else printf(" %10.1f", rate[alg][dist]);
+      printf("\n");
+    }
+    printf("\n");
+  }
+
+  delete [] input;
+  delete [] a;
+  delete [] tmp;
+  delete [] ref;
+  exit(0);
+}
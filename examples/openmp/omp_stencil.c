@@ -0,0 +1,459 @@
+/*
+  OpenMP example program that solves the heat equation on a square (2D)
+  or a cube (3D) with the Jacobi and Gauss-Seidel methods, and shows how
+  tiling the loops makes better use of the caches.
+
+  Every update of a grid point (a lattice update, LUP) replaces it with
+  the average of its 4 (2D) or 6 (3D) neighbours. One side of the
+  boundary is kept at 1 and the others at 0. The program runs each
+  method in several ways:
+
+  Jacobi, which computes the new grid from the old one in another array
+    naive      a parallel for over the rows (2D) or planes (3D)
+    tiled      the grid is cut into columns of tiles across the rows, so
+               that the three rows or planes a tile needs stay in the
+               cache while a thread goes down its column
+    skewed     several time steps are done on a block of rows before the
+               next block, so that the block is read from memory once
+               for all of them. A block moves one row up with every time
+               step, since the rows at its top need the rows below them
+               from the step before. Blocks of a band of time steps wait
+               for the block before them, and for the blocks of the band
+               before, so they are run in waves of independent blocks:
+               block b of band t is in wave b + 2t
+  Gauss-Seidel, which updates the grid in place
+    seq        the points in order, on one thread
+    wavefront  the points in the same order as seq, so with the same
+               result, in tiles. Tile (bi, bx) of sweep s needs the tiles
+               before it in the same sweep and the tiles after it in the
+               sweep before, so wave bi + bx + 2s can be run in parallel
+               and several sweeps are done at the same time
+    naive      red-black: the points where i+j+k is even, then the odd
+               ones, each with a parallel for
+    tiled      red-black with the tiles of the Jacobi tiled mode
+
+  The results of the modes of the same method are compared with each
+  other: they must be exactly the same, except for red-black, which
+  updates the points in a different order than seq and is compared with
+  the naive red-black.
+
+  The tile sizes are computed from the cache sizes in the machine
+  profile that omp_get_env_info saves (see profile.h), or from probing
+  the machine if there is none. Unless -q is given, the program then
+  searches for better ones by timing a few steps with each of a list of
+  sizes. One thread per core is used, unless -t or OMP_NUM_THREADS
+  gives the number.
+
+  The program prints the billions of lattice updates per second
+  (GLUP/s) of every mode, and the memory traffic per update in a simple
+  model that assumes that the grid does not fit in the caches and a
+  tile does: a Jacobi update reads the old point and writes the new one,
+  which first reads the cache line, so 24 bytes. Skewing over T steps
+  divides this by T. A Gauss-Seidel sweep reads and writes every point
+  once, 16 bytes, and red-black goes through the grid twice. The GB/s
+  that the model gives can be compared with the memory bandwidth that
+  omp_stream measures: a mode that needs less traffic can be faster than
+  the memory allows for the naive one.
+
+  Compile the program with 'gcc -O3 -fopenmp omp_stencil.c profile.c -o omp_stencil'
+  Run the program with './omp_stencil -d 2 -n 4000 -s 50' or './omp_stencil -d 3 -n 256 -s 20'
+*/
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "profile.h"
+
+#define MAXCAND 32
+
+enum { J_NAIVE, J_TILED, J_SKEWED, G_SEQ, G_WAVE, G_NAIVE, G_TILED, NMODES };
+char *mode_name[NMODES] = { "naive", "tiled", "skewed", "seq", "wavefront", "naive", "tiled" };
+
+/* Tile sizes of a mode. tiled: a = rows (3D), b = columns. skewed: a =
+   rows in a block, b = time steps in a band. wavefront: a = rows, b =
+   columns (2D) or rows of a plane (3D) */
+typedef struct {
+  int a, b;
+} tile;
+
+int dim = 2, n = 4000, steps = 50;
+long si, sj;                    /* Strides of i and j, k has stride 1 */
+int jlo, jhi;                   /* Range of j, only j = 0 in 2D */
+long npoints;                   /* With the boundary */
+double *u[2];
+machine_profile prof;
+
+void print_usage(char *s) {
+  printf("Usage: %s -d <2|3> -n <grid size> -s <time steps> -t <threads> -q (no tile search)\n", s);
+  exit(0);
+}
+
+void init(void) {
+  long i, p;
+  int c;
+
+  /* The boundary planes or rows i = 0, which is hot, and i = n+1. The
+     threads set the others, so that the pages of the rows a thread
+     updates are touched first by that thread */
+  for (c=0; c<2; c++)
+    for (p=0; p<si; p++) {
+      u[c][p] = 1.0;
+      u[c][(n+1)*si + p] = 0.0;
+    }
+#pragma omp parallel for schedule(static) private(c, p)
+  for (i=1; i<=n; i++)
+    for (c=0; c<2; c++)
+      for (p=0; p<si; p++) u[c][i*si + p] = 0.0;
+}
+
+/* The updates of one row, from column k0 to k1-1. p is the index of
+   column 0 of the row */
+void jacobi_row(const double *a, double *b, long p, int k0, int k1) {
+  const double *x = a + p;
+  double *y = b + p;
+  int k;
+
+  if (dim == 2)
+    for (k=k0; k<k1; k++)
+      y[k] = 0.25*(x[k-si] + x[k+si] + x[k-1] + x[k+1]);
+  else
+    for (k=k0; k<k1; k++)
+      y[k] = (1.0/6.0)*(x[k-si] + x[k+si] + x[k-sj] + x[k+sj] + x[k-1] + x[k+1]);
+}
+
+void gs_row(double *a, long p, int k0, int k1, int step) {
+  double *x = a + p;
+  int k;
+
+  if (dim == 2)
+    for (k=k0; k<k1; k+=step)
+      x[k] = 0.25*(x[k-si] + x[k+si] + x[k-1] + x[k+1]);
+  else
+    for (k=k0; k<k1; k+=step)
+      x[k] = (1.0/6.0)*(x[k-si] + x[k+si] + x[k-sj] + x[k+sj] + x[k-1] + x[k+1]);
+}
+
+/* The red or black points of a row */
+void rb_row(double *a, int i, int j, int k0, int k1, int color) {
+  gs_row(a, i*si + j*sj, k0 + ((i + j + k0 + color) & 1), k1, 2);
+}
+
+int min(int a, int b) {
+  return a < b ? a : b;
+}
+
+int blocks(int len, int size) {
+  return (len + size - 1)/size;
+}
+
+void jacobi_naive(int nsteps) {
+  int s, i, j;
+
+  for (s=0; s<nsteps; s++) {
+#pragma omp parallel for schedule(static) private(j)
+    for (i=1; i<=n; i++)
+      for (j=jlo; j<jhi; j++)
+	jacobi_row(u[s%2], u[(s+1)%2], i*si + j*sj, 1, n+1);
+  }
+}
+
+void jacobi_tiled(int nsteps, tile t) {
+  int s, i, j, bj, bk, nbj = blocks(jhi-jlo, t.a), nbk = blocks(n, t.b);
+
+  for (s=0; s<nsteps; s++) {
+#pragma omp parallel for collapse(2) schedule(static) private(i, j)
+    for (bj=0; bj<nbj; bj++)
+      for (bk=0; bk<nbk; bk++)
+	for (i=1; i<=n; i++)
+	  for (j=jlo+bj*t.a; j<min(jlo+(bj+1)*t.a, jhi); j++)
+	    jacobi_row(u[s%2], u[(s+1)%2], i*si + j*sj, 1+bk*t.b, min(1+(bk+1)*t.b, n+1));
+  }
+}
+
+/* Block b of band band, with rows 1+b*B to 1+(b+1)*B-1 moved up by one
+   row each step. The first block starts at row 1 and the last ends at
+   row n. Step s reads u[s%2] and writes u[(s+1)%2] */
+void skewed_tile(int band, int b, int nb, int nsteps, tile t) {
+  int k, s, i, j, lo, hi;
+
+  for (k=0; k<t.b && band*t.b+k<nsteps; k++) {
+    s = band*t.b + k;
+    lo = b == 0 ? 1 : 1 + b*t.a - k;
+    hi = b == nb-1 ? n+1 : 1 + (b+1)*t.a - k;
+    for (i=lo; i<hi; i++)
+      for (j=jlo; j<jhi; j++)
+	jacobi_row(u[s%2], u[(s+1)%2], i*si + j*sj, 1, n+1);
+  }
+}
+
+void jacobi_skewed(int nsteps, tile t) {
+  int nb = n/t.a, nbands = blocks(nsteps, t.b), w, band;
+
+  if (nb < 1) nb = 1;
+  for (w=0; w<nb+2*(nbands-1); w++) {
+#pragma omp parallel for schedule(dynamic, 1)
+    for (band=0; band<nbands; band++)
+      if (w-2*band >= 0 && w-2*band < nb)
+	skewed_tile(band, w-2*band, nb, nsteps, t);
+  }
+}
+
+void gs_seq(int nsteps) {
+  int s, i, j;
+
+  for (s=0; s<nsteps; s++)
+    for (i=1; i<=n; i++)
+      for (j=jlo; j<jhi; j++)
+	gs_row(u[0], i*si + j*sj, 1, n+1, 1);
+}
+
+void gs_naive(int nsteps) {
+  int s, c, i, j;
+
+  for (s=0; s<nsteps; s++)
+    for (c=0; c<2; c++) {
+#pragma omp parallel for schedule(static) private(j)
+      for (i=1; i<=n; i++)
+	for (j=jlo; j<jhi; j++)
+	  rb_row(u[0], i, j, 1, n+1, c);
+    }
+}
+
+void gs_tiled(int nsteps, tile t) {
+  int s, c, i, j, bj, bk, nbj = blocks(jhi-jlo, t.a), nbk = blocks(n, t.b);
+
+  for (s=0; s<nsteps; s++)
+    for (c=0; c<2; c++) {
+#pragma omp parallel for collapse(2) schedule(static) private(i, j)
+      for (bj=0; bj<nbj; bj++)
+	for (bk=0; bk<nbk; bk++)
+	  for (i=1; i<=n; i++)
+	    for (j=jlo+bj*t.a; j<min(jlo+(bj+1)*t.a, jhi); j++)
+	      rb_row(u[0], i, j, 1+bk*t.b, min(1+(bk+1)*t.b, n+1), c);
+    }
+}
+
+/* Tile (bi, bx) of the wavefront: rows of a, and in 2D columns of b,
+   in 3D rows of a plane of b */
+void wave_tile(int bi, int bx, tile t) {
+  int i, j, ihi = min(1+(bi+1)*t.a, n+1);
+
+  for (i=1+bi*t.a; i<ihi; i++)
+    if (dim == 2)
+      gs_row(u[0], i*si, 1+bx*t.b, min(1+(bx+1)*t.b, n+1), 1);
+    else
+      for (j=1+bx*t.b; j<min(1+(bx+1)*t.b, n+1); j++)
+	gs_row(u[0], i*si + j*sj, 1, n+1, 1);
+}
+
+void gs_wavefront(int nsteps, tile t) {
+  int nbi = blocks(n, t.a), nbx = blocks(n, t.b), w, q, s, bi, bx;
+
+  for (w=0; w<nbi+nbx-1+2*(nsteps-1); w++) {
+#pragma omp parallel for schedule(dynamic, 1) private(s, bi, bx)
+    for (q=0; q<nsteps*nbi; q++) {
+      s = q/nbi;
+      bi = q%nbi;
+      bx = w - 2*s - bi;
+      if (bx >= 0 && bx < nbx) wave_tile(bi, bx, t);
+    }
+  }
+}
+
+/* Run a mode. Returns the time */
+double run(int mode, int nsteps, tile t) {
+  double time = omp_get_wtime();
+
+  switch (mode) {
+  case J_NAIVE: jacobi_naive(nsteps); break;
+  case J_TILED: jacobi_tiled(nsteps, t); break;
+  case J_SKEWED: jacobi_skewed(nsteps, t); break;
+  case G_SEQ: gs_seq(nsteps); break;
+  case G_NAIVE: gs_naive(nsteps); break;
+  case G_TILED: gs_tiled(nsteps, t); break;
+  case G_WAVE: gs_wavefront(nsteps, t); break;
+  }
+  return omp_get_wtime() - time;
+}
+
+/* The tile sizes to try for a mode */
+int candidates(int mode, tile *c) {
+  int m = 0, x, y;
+
+  if (mode == J_TILED || mode == G_TILED) {
+    for (x=(dim == 2 ? 1 : 8); x<=(dim == 2 ? 1 : 64); x*=2)
+      for (y=64; y<=2048; y*=2) {
+	c[m].a = x;
+	c[m++].b = y;
+      }
+  }
+  else if (mode == J_SKEWED) {
+    for (x=(dim == 2 ? 16 : 2); x<=(dim == 2 ? 128 : 16); x*=2)
+      for (y=2; y<=16 && y<=x && y<=steps; y*=2) {
+	c[m].a = x;
+	c[m++].b = y;
+      }
+  }
+  else if (mode == G_WAVE) {
+    for (x=(dim == 2 ? 32 : 4); x<=(dim == 2 ? 256 : 32); x*=2)
+      for (y=(dim == 2 ? 128 : 8); y<=(dim == 2 ? 1024 : 64); y*=2) {
+	c[m].a = x;
+	c[m++].b = y;
+      }
+  }
+  return m;
+}
+
+/* The largest power of two that is at most x, but at least lo and at
+   most hi */
+int pow2(long x, int lo, int hi) {
+  int p = lo;
+
+  while (p*2 <= x && p*2 <= hi) p *= 2;
+  return p;
+}
+
+/* Tile sizes from the caches in the machine profile. The tiled modes
+   keep the three rows of a tile that are read and the row that is
+   written in L1 (2D), or the planes of a tile in half of L2 (3D). A
+   skewed block of both arrays goes in half of L2 (2D) or in half of
+   the part of L3 that a core has (3D), and a wavefront tile in half of
+   L2 */
+tile default_tile(int mode) {
+  long l1 = prof.cache[1] > 0 ? prof.cache[1] : 32*1024;
+  long l2 = prof.cache[2] > 0 ? prof.cache[2] : 256*1024;
+  long l3 = prof.cache[3] > 0 && prof.shared[3] > 0 ? prof.cache[3]*prof.smt/prof.shared[3] : l2;
+  tile t;
+
+  if (mode == J_SKEWED) {
+    t.a = dim == 2 ? pow2(l2/2/(16L*n), 8, 256) : pow2(l3/2/(16L*n*n), 2, 64);
+    t.b = min(t.a, dim == 2 ? 8 : 4);
+  }
+  else if (mode == G_WAVE) {
+    t.b = dim == 2 ? 256 : 16;
+    t.a = dim == 2 ? pow2(l2/2/(8L*t.b), 16, 256) : pow2(l2/2/(8L*t.b*n), 2, 64);
+  }
+  else {
+    t.b = dim == 2 ? pow2(l1/(4*8), 64, 2048) : 256;
+    t.a = dim == 2 ? 1 : pow2(l2/2/(32L*t.b), 1, 64);
+  }
+  return t;
+}
+
+/* Time the tile sizes from the profile and each candidate for a few
+   steps, and return the fastest */
+tile search(int mode) {
+  tile c[MAXCAND+1], best;
+  double t, tbest = 1e300;
+  int m = candidates(mode, c+1) + 1, i, nsteps;
+
+  best = c[0] = default_tile(mode);
+
+  for (i=0; i<m; i++) {
+    nsteps = mode == J_SKEWED ? 2*c[i].b : 4;
+    if (nsteps > steps) nsteps = steps;
+    init();
+    t = run(mode, nsteps, c[i]);
+    if (t < tbest) {
+      tbest = t;
+      best = c[i];
+    }
+  }
+  return best;
+}
+
+void tile_name(int mode, tile t, char *s) {
+  if (mode == J_TILED || mode == G_TILED) {
+    if (dim == 2) sprintf(s, "%d columns", t.b);
+    else sprintf(s, "%d x %d", t.a, t.b);
+  }
+  else if (mode == J_SKEWED) sprintf(s, "%d rows, %d steps", t.a, t.b);
+  else if (mode == G_WAVE) sprintf(s, "%d x %d", t.a, t.b);
+  else strcpy(s, "-");
+}
+
+double model_bytes(int mode, tile t) {
+  switch (mode) {
+  case J_NAIVE: case J_TILED: return 24.0;
+  case J_SKEWED: return 24.0/min(t.b, steps);
+  case G_NAIVE: case G_TILED: return 32.0;
+  default: return 16.0;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int nthreads, quick = 0, opt, mode, first, last;
+  double *result, *r, t, lups, glups, maxdiff, d;
+  long p;
+  char name[64];
+  tile tl;
+
+  profile_get(&prof);
+  nthreads = profile_threads(&prof);
+  while ((opt = getopt(argc, argv, "d:n:s:t:qh")) != -1) {
+    switch (opt) {
+    case 'd': dim = atoi(optarg); break;
+    case 'n': n = atoi(optarg); break;
+    case 's': steps = atoi(optarg); break;
+    case 't': nthreads = atoi(optarg); break;
+    case 'q': quick = 1; break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if ((dim != 2 && dim != 3) || n < 4 || steps < 1 || nthreads < 1) print_usage(argv[0]);
+  omp_set_num_threads(nthreads);
+
+  /* The arrays have a layer of boundary points around the grid */
+  sj = n+2;
+  si = dim == 2 ? n+2 : (long)(n+2)*(n+2);
+  jlo = dim == 2 ? 0 : 1;
+  jhi = dim == 2 ? 1 : n+1;
+  npoints = (n+2)*si;
+  u[0] = (double *) malloc(npoints*sizeof(double));
+  u[1] = (double *) malloc(npoints*sizeof(double));
+  result = (double *) malloc(npoints*sizeof(double));
+  if (u[0] == NULL || u[1] == NULL || result == NULL) {
+    printf("Not enough memory for a grid of %d^%d\n", n, dim);
+    exit(1);
+  }
+  lups = (double) steps*n*n*(dim == 3 ? n : 1);
+
+  for (first=J_NAIVE; first<=G_SEQ; first+=G_SEQ) {
+    last = first == J_NAIVE ? J_SKEWED : G_TILED;
+    printf("%s %dD, %d^%d points, %d steps, %d threads\n", first == J_NAIVE ? "Jacobi" : "Gauss-Seidel",
+	   dim, n, dim, steps, nthreads);
+    printf("%-10s %-18s %8s %8s %10s %10s %10s\n", "mode", "tile", "time s", "GLUP/s",
+	   "B/LUP", "GB/s", "max diff");
+    for (mode=first; mode<=last; mode++) {
+      tl = quick ? default_tile(mode) : search(mode);
+      init();
+      t = run(mode, steps, tl);
+      glups = lups/t*1e-9;
+
+      /* The result is in u[steps%2] for Jacobi and in u[0] for
+	 Gauss-Seidel. The first mode and red-black are the references */
+      r = u[first == J_NAIVE ? steps%2 : 0];
+      maxdiff = 0.0;
+      if (mode == first || mode == G_NAIVE)
+	memcpy(result, r, npoints*sizeof(double));
+      else
+	for (p=0; p<npoints; p++) {
+	  d = r[p] - result[p];
+	  if (d < 0) d = -d;
+	  if (d > maxdiff) maxdiff = d;
+	}
+      tile_name(mode, tl, name);
+      printf("%-10s %-18s %8.3f %8.3f %10.1f %10.1f %10.2g\n", mode_name[mode], name, t, glups,
+	     model_bytes(mode, tl), glups*model_bytes(mode, tl), maxdiff);
+    }
+    printf("\n");
+  }
+
+  free(u[0]);
+  free(u[1]);
+  free(result);
+  exit(0);
+}
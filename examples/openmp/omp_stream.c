@@ -0,0 +1,402 @@
+/*
+  Memory bandwidth benchmark in the style of STREAM, to be used as the
+  reference for how fast a kernel that streams through memory can be
+  (the roof of a roofline plot).
+
+  The kernels work on three arrays of doubles a, b and c:
+
+    copy     c[i] = a[i]              16 bytes per element
+    scale    b[i] = s*c[i]            16 bytes
+    add      c[i] = a[i] + b[i]       24 bytes
+    triad    a[i] = b[i] + s*c[i]     24 bytes
+    read     sum += a[i]              8 bytes
+    ntcopy   copy with non-temporal stores
+    nttriad  triad with non-temporal stores
+
+  The bytes are counted as in STREAM. A normal store first reads the
+  cache line it writes to, so copy really moves 24 bytes per element
+  from and to memory, and triad 32. Non-temporal stores (_mm_stream_pd)
+  write past the caches without reading the line, so they can be faster
+  for arrays larger than the caches, but slower for arrays that would
+  have fit in them. The dot product in pt_dotprod.c is a read kernel
+  with two arrays, and the matrix multiplications read much less memory
+  per flop if they are blocked as in gemm.c.
+
+  The kernels are run by
+
+    omp       an OpenMP parallel region
+    pthreads  a pool of POSIX threads that is created once, as in
+              pt_dotprod.c, and woken up with a barrier
+    single    the main thread
+
+  Each thread always works on the same slice of the arrays, the one
+  schedule(static) would give it, so its part of the arrays stays in its
+  caches when it fits there. The arrays are initialized in parallel in
+  the same slices, so that they are in local memory on a NUMA machine.
+
+  The program first sweeps the size of the arrays from the L1 cache to
+  main memory with all threads, then the number of threads with the
+  largest arrays. It prints the best bandwidth of -r trials in GB/s.
+
+  Compile the program with 'gcc -O3 -fopenmp omp_stream.c -o omp_stream -lpthread'
+  Run the program with './omp_stream -t 4 -n 33554432'
+*/
+
+#include <omp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define NKERNELS 7
+#define MAXTHREADS 256
+#define TRIAL_BYTES 4e7         /* Bytes moved in one trial at least */
+
+enum { COPY, SCALE, ADD, TRIAD, READ, NTCOPY, NTTRIAD };
+enum { OMP, PTHREADS, SINGLE };
+
+char *kernel_name[NKERNELS] = { "copy", "scale", "add", "triad", "read", "ntcopy", "nttriad" };
+int kernel_bytes[NKERNELS] = { 16, 16, 24, 24, 8, 16, 24 };
+char *model_name[3] = { "omp", "pthreads", "single" };
+
+double *a, *b, *c;              /* The arrays, aligned to 64 bytes */
+long n;                         /* Elements used in them now */
+double sink;                    /* Keeps the sums of read */
+
+void print_usage(char *s) {
+  printf("Usage: %s -n <largest array size in elements> -t <threads> -r <trials>\n", s);
+  exit(0);
+}
+
+/* Slice of thread t of p, rounded to 64 bytes */
+void slice(int t, int p, long *lo, long *hi) {
+  *lo = (n*t/p) & ~7L;
+  *hi = t == p-1 ? n : (n*(t+1)/p) & ~7L;
+}
+
+/* Stores with _mm_stream_pd need 16 byte aligned addresses, which the
+   slices are. The sfence makes the stores visible to the other threads */
+void ntcopy(long lo, long hi) {
+  long i;
+#ifdef __SSE2__
+  for (i=lo; i+1<hi; i+=2)
+    _mm_stream_pd(&c[i], _mm_load_pd(&a[i]));
+  for (; i<hi; i++) c[i] = a[i];
+  _mm_sfence();
+#else
+  for (i=lo; i<hi; i++) c[i] = a[i];
+#endif
+}
+
+void nttriad(long lo, long hi, double s) {
+  long i;
+#ifdef __SSE2__
+  __m128d vs = _mm_set1_pd(s);
+
+  for (i=lo; i+1<hi; i+=2)
+    _mm_stream_pd(&a[i], _mm_add_pd(_mm_load_pd(&b[i]), _mm_mul_pd(vs, _mm_load_pd(&c[i]))));
+  for (; i<hi; i++) a[i] = b[i] + s*c[i];
+  _mm_sfence();
+#else
+  for (i=lo; i<hi; i++) a[i] = b[i] + s*c[i];
+#endif
+}
+
+/* The compiler may not change the order of floating point additions, so
+   with one sum every addition waits for the one before. Eight sums can
+   be added in vector registers */
+double read_sum(long lo, long hi) {
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0, s5 = 0.0, s6 = 0.0, s7 = 0.0;
+  long i;
+
+  for (i=lo; i+7<hi; i+=8) {
+    s0 += a[i];   s1 += a[i+1]; s2 += a[i+2]; s3 += a[i+3];
+    s4 += a[i+4]; s5 += a[i+5]; s6 += a[i+6]; s7 += a[i+7];
+  }
+  for (; i<hi; i++) s0 += a[i];
+  return ((s0 + s1) + (s2 + s3)) + ((s4 + s5) + (s6 + s7));
+}
+
+/* Run kernel k reps times on the elements lo to hi-1. Returns the sum
+   of read */
+double run_kernel(int k, long lo, long hi, long reps) {
+  double s = 3.0, sum = 0.0;
+  long i, r;
+
+  for (r=0; r<reps; r++)
+    switch (k) {
+    case COPY:
+      for (i=lo; i<hi; i++) c[i] = a[i];
+      break;
+    case SCALE:
+      for (i=lo; i<hi; i++) b[i] = s*c[i];
+      break;
+    case ADD:
+      for (i=lo; i<hi; i++) c[i] = a[i] + b[i];
+      break;
+    case TRIAD:
+      for (i=lo; i<hi; i++) a[i] = b[i] + s*c[i];
+      break;
+    case READ:
+      sum += read_sum(lo, hi);
+      break;
+    case NTCOPY:
+      ntcopy(lo, hi);
+      break;
+    case NTTRIAD:
+      nttriad(lo, hi, s);
+      break;
+    }
+  return sum;
+}
+
+/* The pool of POSIX threads. A barrier made of a mutex and a condition
+   variable, since pthread_barrier_t is not available everywhere */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int count, total, phase;
+} barrier_t;
+
+barrier_t start, done;
+pthread_t pool[MAXTHREADS];
+int pool_size = 0;
+int job_kernel, job_quit;
+long job_reps;
+double job_sum[MAXTHREADS*8];   /* Padded, one cache line per thread */
+
+void barrier_init(barrier_t *bar, int total) {
+  pthread_mutex_init(&bar->lock, NULL);
+  pthread_cond_init(&bar->cond, NULL);
+  bar->count = 0;
+  bar->total = total;
+  bar->phase = 0;
+}
+
+void barrier_wait(barrier_t *bar) {
+  int phase;
+
+  pthread_mutex_lock(&bar->lock);
+  phase = bar->phase;
+  if (++bar->count == bar->total) {
+    bar->count = 0;
+    bar->phase++;
+    pthread_cond_broadcast(&bar->cond);
+  }
+  else
+    while (phase == bar->phase)
+      pthread_cond_wait(&bar->cond, &bar->lock);
+  pthread_mutex_unlock(&bar->lock);
+}
+
+void *worker(void *arg) {
+  int t = (int) (long) arg;
+  long lo, hi;
+
+  while (1) {
+    barrier_wait(&start);
+    if (job_quit) break;
+    slice(t, pool_size, &lo, &hi);
+    job_sum[t*8] = run_kernel(job_kernel, lo, hi, job_reps);
+    barrier_wait(&done);
+  }
+  return NULL;
+}
+
+void pool_start(int p) {
+  long t;
+
+  pool_size = p;
+  job_quit = 0;
+  barrier_init(&start, p+1);
+  barrier_init(&done, p+1);
+  for (t=0; t<p; t++)
+    pthread_create(&pool[t], NULL, worker, (void *) t);
+}
+
+void pool_stop(void) {
+  int t;
+
+  job_quit = 1;
+  barrier_wait(&start);
+  for (t=0; t<pool_size; t++)
+    pthread_join(pool[t], NULL);
+  pool_size = 0;
+}
+
+/* Time reps runs of kernel k with p threads of the given model */
+double run(int model, int k, int p, long reps) {
+  double t, sum = 0.0;
+  long lo, hi;
+  int i;
+
+  t = omp_get_wtime();
+  if (model == OMP) {
+#pragma omp parallel num_threads(p) private(lo, hi) reduction(+:sum)
+    {
+      slice(omp_get_thread_num(), omp_get_num_threads(), &lo, &hi);
+      sum += run_kernel(k, lo, hi, reps);
+    }
+  }
+  else if (model == PTHREADS) {
+    job_kernel = k;
+    job_reps = reps;
+    barrier_wait(&start);
+    barrier_wait(&done);
+    for (i=0; i<p; i++) sum += job_sum[i*8];
+  }
+  else
+    sum = run_kernel(k, 0, n, reps);
+  t = omp_get_wtime() - t;
+  sink += sum;
+  return t;
+}
+
+/* Best bandwidth in GB/s of kernel k on arrays of n elements */
+double bandwidth(int model, int k, int p, int trials) {
+  double bytes = (double) kernel_bytes[k]*n, t, best = 1e300;
+  long reps = (long) (TRIAL_BYTES/bytes) + 1;
+  int r;
+
+  run(model, k, p, 1);          /* Warm up */
+  for (r=0; r<trials; r++) {
+    t = run(model, k, p, reps);
+    if (t < best) best = t;
+  }
+  return bytes*reps/best*1e-9;
+}
+
+/* Size in bytes of the data cache at the given level, or 0 */
+long cache_size(int level) {
+  long s = 0;
+
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+  if (level == 1) s = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  else if (level == 2) s = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  else s = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  return s > 0 ? s : 0;
+}
+
+/* Where the three arrays fit with p threads. L1 and L2 are per core */
+char *level(long bytes, int p) {
+  if (bytes/p <= cache_size(1)) return "L1";
+  if (bytes/p <= cache_size(2)) return "L2";
+  if (bytes <= cache_size(3)) return "L3";
+  return "memory";
+}
+
+void print_header(char *first) {
+  int k;
+
+  printf("%-18s", first);
+  for (k=0; k<NKERNELS; k++) printf(" %8s", kernel_name[k]);
+  printf("\n");
+}
+
+void print_row(int model, int p, int trials, double *best) {
+  double bw;
+  int k;
+
+  for (k=0; k<NKERNELS; k++) {
+    bw = bandwidth(model, k, p, trials);
+    if (bw > best[k]) best[k] = bw;
+    printf(" %8.1f", bw);
+  }
+  printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  long nmax, i, lo, hi;
+  int nthreads = omp_get_max_threads(), trials = 5, opt, model, p, k;
+  double *mem, best[NKERNELS], top[NKERNELS], peak[NKERNELS];
+  char label[64];
+
+  /* Four times the L3 cache, so that the largest arrays are in memory */
+  nmax = 4*(cache_size(3) > 0 ? cache_size(3) : 8*1024*1024)/24;
+  while ((opt = getopt(argc, argv, "n:t:r:h")) != -1) {
+    switch (opt) {
+    case 'n': nmax = atol(optarg); break;
+    case 't': nthreads = atoi(optarg); break;
+    case 'r': trials = atoi(optarg); break;
+    default:
+      print_usage(argv[0]);
+    }
+  }
+  if (nmax < 64 || nthreads < 1 || nthreads > MAXTHREADS || trials < 1) print_usage(argv[0]);
+
+  mem = (double *) malloc((3*nmax + 24)*sizeof(double));
+  if (mem == NULL) {
+    printf("Could not allocate %.1f MB\n", 3.0*nmax*8/1048576);
+    exit(1);
+  }
+  a = (double *) (((size_t) mem + 63) & ~(size_t) 63);
+  b = a + ((nmax + 7) & ~7L);
+  c = b + ((nmax + 7) & ~7L);
+
+  /* First touch in the slices of the threads */
+  n = nmax;
+#pragma omp parallel num_threads(nthreads) private(i, lo, hi)
+  {
+    slice(omp_get_thread_num(), omp_get_num_threads(), &lo, &hi);
+    for (i=lo; i<hi; i++) {
+      a[i] = 1.0;
+      b[i] = 2.0;
+      c[i] = 0.0;
+    }
+  }
+
+  printf("Caches: L1 %ld KB, L2 %ld KB, L3 %ld KB\n", cache_size(1)/1024,
+	 cache_size(2)/1024, cache_size(3)/1024);
+#ifndef __SSE2__
+  printf("Compiled without SSE2, ntcopy and nttriad use normal stores\n");
+#endif
+  printf("Bandwidth in GB/s, best of %d trials\n", trials);
+  for (k=0; k<NKERNELS; k++) top[k] = 0.0;
+
+  /* Sizes from the L1 cache to main memory */
+  for (model=OMP; model<=SINGLE; model++) {
+    p = model == SINGLE ? 1 : nthreads;
+    printf("\n%s, %d threads\n", model_name[model], p);
+    print_header("size of a+b+c");
+    if (model == PTHREADS) pool_start(p);
+    for (k=0; k<NKERNELS; k++) best[k] = 0.0;
+    for (n=128; n<=nmax; n = n*4 <= nmax || n == nmax ? n*4 : nmax) {
+      sprintf(label, "%9.0f KB %-6s", 24.0*n/1024, level(24*n, p));
+      printf("%-18s", label);
+      print_row(model, p, trials, best);
+    }
+    if (model == PTHREADS) pool_stop();
+    printf("%-18s", "best");
+    for (k=0; k<NKERNELS; k++) {
+      printf(" %8.1f", best[k]);
+      if (best[k] > top[k]) top[k] = best[k];
+    }
+    printf("\n");
+  }
+
+  /* Threads, with the largest arrays */
+  n = nmax;
+  printf("\nArrays of %.1f MB in total\n", 24.0*n/1048576);
+  print_header("threads");
+  for (k=0; k<NKERNELS; k++) peak[k] = 0.0;
+  for (model=OMP; model<=SINGLE; model++)
+    for (p=1; p<=nthreads; p = p*2 <= nthreads || p == nthreads ? p*2 : nthreads) {
+      if (model == SINGLE && p > 1) break;
+      sprintf(label, "%-8s %4d", model_name[model], p);
+      printf("%-18s", label);
+      if (model == PTHREADS) pool_start(p);
+      print_row(model, p, trials, peak);
+      if (model == PTHREADS) pool_stop();
+    }
+
+  printf("\nRoofline reference: memory %.1f GB/s with triad, %.1f GB/s with nttriad, %.1f GB/s with read\n",
+	 peak[TRIAD], peak[NTTRIAD], peak[READ]);
+  printf("Caches up to %.1f GB/s with triad, %.1f GB/s with read\n", top[TRIAD], top[READ]);
+  free(mem);
+  if (sink == 0.0) printf("\n");
+  exit(0);
+}
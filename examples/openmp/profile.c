@@ -0,0 +1,360 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+#include "profile.h"
+
+#define MAXCPUS 4096
+#define CHASE_STEPS (1L<<22)    /* Loads timed for the latency */
+#define TRIALS 5
+
+static volatile long sink;      /* Keeps the pointer chase from being removed */
+
+#ifdef __linux__
+/* A number from a file, or -1 if there is no file */
+static long read_long(const char *path) {
+  FILE *f = fopen(path, "r");
+  long x = -1;
+
+  if (f == NULL) return -1;
+  if (fscanf(f, "%ld", &x) != 1) x = -1;
+  fclose(f);
+  return x;
+}
+
+/* The first line of a file without the newline, or 0 if there is no file */
+static int read_line(const char *path, char *buf, int len) {
+  FILE *f = fopen(path, "r");
+  char *nl;
+
+  if (f == NULL) return 0;
+  if (fgets(buf, len, f) == NULL) buf[0] = '\0';
+  fclose(f);
+  if ((nl = strchr(buf, '\n')) != NULL) *nl = '\0';
+  return 1;
+}
+
+/* A size such as 48K or 32M */
+static long parse_size(const char *s) {
+  long x = atol(s);
+
+  if (strchr(s, 'K') != NULL) x *= 1024;
+  else if (strchr(s, 'M') != NULL) x *= 1024*1024;
+  else if (strchr(s, 'G') != NULL) x *= 1024L*1024*1024;
+  return x;
+}
+
+/* The number of CPUs in a list such as 0-3,8-11 */
+static int count_list(const char *s) {
+  int n = 0, a, b;
+
+  while (s != NULL && *s != '\0') {
+    if (sscanf(s, "%d-%d", &a, &b) == 2) n += b - a + 1;
+    else if (sscanf(s, "%d", &a) == 1) n++;
+    if ((s = strchr(s, ',')) != NULL) s++;
+  }
+  return n;
+}
+
+static void probe_sysfs(machine_profile *p) {
+  static int pkg[MAXCPUS], core[MAXCPUS];
+  char path[128], buf[256];
+  int cpu, n = 0, i, j, level, node;
+  long x;
+
+  /* Offline CPUs have no topology, so there can be holes */
+  for (cpu=0; cpu<MAXCPUS; cpu++) {
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    if ((x = read_long(path)) < 0) continue;
+    pkg[n] = (int) x;
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    core[n++] = (int) read_long(path);
+  }
+  if (n > 0) {
+    p->cpus = n;
+    p->cores = 0;
+    p->sockets = 0;
+    for (i=0; i<n; i++) {
+      for (j=0; j<i && (pkg[j] != pkg[i] || core[j] != core[i]); j++);
+      if (j == i) p->cores++;
+      for (j=0; j<i && pkg[j] != pkg[i]; j++);
+      if (j == i) p->sockets++;
+    }
+  }
+
+  for (i=0; i<16; i++) {
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+    if ((level = (int) read_long(path)) < 0) break;
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+    if (level < 1 || level > 3 || !read_line(path, buf, sizeof(buf)) || strcmp(buf, "Instruction") == 0)
+      continue;
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+    if (read_line(path, buf, sizeof(buf))) p->cache[level] = parse_size(buf);
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/shared_cpu_list", i);
+    if (read_line(path, buf, sizeof(buf))) p->shared[level] = count_list(buf);
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/coherency_line_size", i);
+    if ((x = read_long(path)) > 0) p->line = (int) x;
+  }
+
+  for (node=0; node<PROFILE_MAXNODES; node++) {
+    FILE *f;
+
+    sprintf(path, "/sys/devices/system/node/node%d/distance", node);
+    if ((f = fopen(path, "r")) == NULL) continue;
+    p->nodes = node+1;
+    for (j=0; j<PROFILE_MAXNODES && fscanf(f, "%d", &p->distance[node][j]) == 1; j++);
+    fclose(f);
+  }
+}
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+/* CPUID leaf 4 gives the caches one by one: type 1 is data, 2
+   instructions and 3 unified, and the size is ways x partitions x line
+   size x sets */
+static void probe_cpuid(machine_profile *p) {
+  unsigned int a, b, c, d, i, level, type;
+
+  if (__get_cpuid_max(0, NULL) < 4) return;
+  for (i=0; i<16; i++) {
+    __cpuid_count(4, i, a, b, c, d);
+    type = a & 31;
+    level = (a >> 5) & 7;
+    if (type == 0) break;
+    if (type == 2 || level < 1 || level > 3) continue;
+    p->cache[level] = (long) (((b >> 22) & 1023) + 1)*(((b >> 12) & 1023) + 1)*((b & 4095) + 1)*(c + 1);
+    p->shared[level] = ((a >> 14) & 4095) + 1;
+    p->line = (b & 4095) + 1;
+  }
+}
+#endif
+
+/* Replace the values that make no sense, which the programs could
+   divide by or size arrays with. Also used for the values read from a
+   file, which may have been edited by hand */
+static void check_profile(machine_profile *p) {
+  int i;
+
+  if (p->cpus < 1) p->cpus = 1;
+  if (p->cores < 1) p->cores = 1;
+  if (p->sockets < 1) p->sockets = 1;
+  if (p->smt < 1) p->smt = 1;
+  if (p->nodes < 1 || p->nodes > PROFILE_MAXNODES) p->nodes = 1;
+  if (p->line < 1) p->line = 64;
+  for (i=1; i<=3; i++) {
+    if (p->cache[i] < 0) p->cache[i] = 0;
+    if (p->shared[i] < 1) p->shared[i] = i < 3 ? p->smt : p->cpus/p->sockets;
+    if (p->shared[i] < 1) p->shared[i] = 1;
+  }
+  if (p->latency < 0.0) p->latency = 0.0;
+  if (p->bandwidth < 0.0) p->bandwidth = 0.0;
+}
+
+void profile_probe(machine_profile *p) {
+  memset(p, 0, sizeof(machine_profile));
+  p->cpus = omp_get_num_procs();
+  p->cores = p->cpus;
+  p->sockets = 1;
+  p->nodes = 1;
+  p->line = 64;
+  p->distance[0][0] = 10;
+#ifdef __linux__
+  probe_sysfs(p);
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+  if (p->cache[1] == 0) probe_cpuid(p);
+#endif
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+  if (p->cache[1] == 0) p->cache[1] = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  if (p->cache[2] == 0) p->cache[2] = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (p->cache[3] == 0) p->cache[3] = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+
+  if (p->cores < 1) p->cores = 1;
+  p->smt = p->cpus/p->cores > 0 ? p->cpus/p->cores : 1;
+  check_profile(p);
+}
+
+/* The average time of a load in a chain of pointers through bytes of
+   memory, one per cache line, in a random order that makes prefetching
+   useless. The order is a random permutation (Fisher-Yates), and each
+   line points to the next one in it */
+static double measure_latency(long bytes, int line) {
+  long stride = line/sizeof(long), nlines = bytes/line, i, j, k, tmp;
+  long *next = (long *) malloc(nlines*line), *order = (long *) malloc(nlines*sizeof(long));
+  unsigned long long x = 88172645463325252ULL;
+  double t;
+
+  if (next == NULL || order == NULL) {
+    free(next);
+    free(order);
+    return 0.0;
+  }
+  for (i=0; i<nlines; i++) order[i] = i;
+  for (i=nlines-1; i>0; i--) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    j = (long) (x % (i+1));
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+  for (i=0; i<nlines; i++)
+    next[order[i]*stride] = order[(i+1) % nlines]*stride;
+
+  k = order[0]*stride;
+  t = omp_get_wtime();
+  for (i=0; i<CHASE_STEPS; i++) k = next[k];
+  t = omp_get_wtime() - t;
+  sink = k;
+
+  free(next);
+  free(order);
+  return t/CHASE_STEPS*1e9;
+}
+
+/* The triad with all threads, on arrays of n doubles that each thread
+   initializes its part of */
+static double measure_bandwidth(long n) {
+  double *a = (double *) malloc(n*sizeof(double)), *b = (double *) malloc(n*sizeof(double));
+  double *c = (double *) malloc(n*sizeof(double)), t, best = 1e300;
+  long i;
+  int r;
+
+  if (a == NULL || b == NULL || c == NULL) {
+    free(a);
+    free(b);
+    free(c);
+    return 0.0;
+  }
+#pragma omp parallel for schedule(static)
+  for (i=0; i<n; i++) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+  for (r=0; r<TRIALS; r++) {
+    t = omp_get_wtime();
+#pragma omp parallel for schedule(static)
+    for (i=0; i<n; i++)
+      a[i] = b[i] + 3.0*c[i];
+    t = omp_get_wtime() - t;
+    if (t < best) best = t;
+  }
+  free(a);
+  free(b);
+  free(c);
+  return 3.0*sizeof(double)*n/best*1e-9;
+}
+
+void profile_measure(machine_profile *p) {
+  /* Four times the last cache, as STREAM asks for, and at least 64 MB */
+  long bytes = 4*(p->cache[3] > 0 ? p->cache[3] : p->cache[2]);
+
+  if (bytes < 64L*1024*1024) bytes = 64L*1024*1024;
+  if (bytes > 1024L*1024*1024) bytes = 1024L*1024*1024;
+  p->latency = measure_latency(bytes, p->line > 0 ? p->line : 64);
+  p->bandwidth = measure_bandwidth(bytes/sizeof(double));
+}
+
+int profile_save(const machine_profile *p, const char *file) {
+  FILE *f = fopen(file, "w");
+  int i, j;
+
+  if (f == NULL) return 0;
+  fprintf(f, "# Machine profile written by omp_get_env_info\n");
+  fprintf(f, "cpus %d\ncores %d\nsockets %d\nsmt %d\nnodes %d\nline %d\n",
+	  p->cpus, p->cores, p->sockets, p->smt, p->nodes, p->line);
+  for (i=1; i<=3; i++) fprintf(f, "l%d %ld\n", i, p->cache[i]);
+  for (i=1; i<=3; i++) fprintf(f, "l%d_shared %d\n", i, p->shared[i]);
+  fprintf(f, "latency %.1f\nbandwidth %.2f\n", p->latency, p->bandwidth);
+  fprintf(f, "# distance <node> <distances to nodes 0, 1, ...>\n");
+  for (i=0; i<p->nodes; i++) {
+    fprintf(f, "distance %d", i);
+    for (j=0; j<p->nodes; j++) fprintf(f, " %d", p->distance[i][j]);
+    fprintf(f, "\n");
+  }
+  return fclose(f) == 0;
+}
+
+int profile_load(machine_profile *p, const char *file) {
+  FILE *f = fopen(file, "r");
+  char line[1024], name[32], *v;
+  int i, j, node, len;
+
+  if (f == NULL) return 0;
+  profile_probe(p);
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#' || sscanf(line, "%31s%n", name, &len) != 1) continue;
+    v = line + len;
+    if (strcmp(name, "cpus") == 0) p->cpus = atoi(v);
+    else if (strcmp(name, "cores") == 0) p->cores = atoi(v);
+    else if (strcmp(name, "sockets") == 0) p->sockets = atoi(v);
+    else if (strcmp(name, "smt") == 0) p->smt = atoi(v);
+    else if (strcmp(name, "nodes") == 0) p->nodes = atoi(v);
+    else if (strcmp(name, "line") == 0) p->line = atoi(v);
+    else if (strcmp(name, "latency") == 0) p->latency = atof(v);
+    else if (strcmp(name, "bandwidth") == 0) p->bandwidth = atof(v);
+    else if (name[0] == 'l' && name[1] >= '1' && name[1] <= '3') {
+      i = name[1] - '0';
+      if (name[2] == '\0') p->cache[i] = atol(v);
+      else if (strcmp(name+2, "_shared") == 0) p->shared[i] = atoi(v);
+    }
+    else if (strcmp(name, "distance") == 0 && sscanf(v, "%d%n", &node, &len) == 1 &&
+	     node >= 0 && node < PROFILE_MAXNODES) {
+      v += len;
+      for (j=0; j<PROFILE_MAXNODES && sscanf(v, "%d%n", &p->distance[node][j], &len) == 1; j++)
+	v += len;
+    }
+  }
+  fclose(f);
+  check_profile(p);
+  return 1;
+}
+
+const char *profile_file(void) {
+  char *s = getenv("MACHINE_PROFILE");
+
+  return s != NULL && s[0] != '\0' ? s : PROFILE_FILE;
+}
+
+int profile_get(machine_profile *p) {
+  if (profile_load(p, profile_file())) return 1;
+  profile_probe(p);
+  return 0;
+}
+
+int profile_threads(const machine_profile *p) {
+  int n = p->cores;
+
+  if (getenv("OMP_NUM_THREADS") != NULL) return omp_get_max_threads();
+  if (n > omp_get_num_procs()) n = omp_get_num_procs();
+  return n > 0 ? n : 1;
+}
+
+void profile_print(FILE *f, const machine_profile *p) {
+  int i, j;
+
+  fprintf(f, "Sockets = %d, cores = %d, hardware threads = %d (%d per core)\n",
+	  p->sockets, p->cores, p->cpus, p->smt);
+  for (i=1; i<=3; i++)
+    if (p->cache[i] > 0)
+      fprintf(f, "L%d%s cache = %ld KB, shared by %d hardware threads\n",
+	      i, i == 1 ? " data" : "", p->cache[i]/1024, p->shared[i]);
+  fprintf(f, "Cache line = %d bytes\n", p->line);
+  fprintf(f, "NUMA nodes = %d, distances:\n%6s", p->nodes, "");
+  for (j=0; j<p->nodes; j++) fprintf(f, " %4d", j);
+  fprintf(f, "\n");
+  for (i=0; i<p->nodes; i++) {
+    fprintf(f, "%6d", i);
+    for (j=0; j<p->nodes; j++) fprintf(f, " %4d", p->distance[i][j]);
+    fprintf(f, "\n");
+  }
+  if (p->latency > 0.0) fprintf(f, "Memory latency = %.1f ns\n", p->latency);
+  if (p->bandwidth > 0.0) fprintf(f, "Memory bandwidth (triad) = %.2f GB/s\n", p->bandwidth);
+}
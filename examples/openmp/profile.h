@@ -0,0 +1,75 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+  A profile of the machine: how many sockets, cores and hardware threads
+  it has, the sizes of its caches, the distances between its NUMA nodes,
+  and the latency and bandwidth of its memory.
+
+  omp_get_env_info finds these out and saves them in a profile file, and
+  the other programs read the file to choose their block sizes and
+  number of threads, instead of using fixed numbers that only suit one
+  machine. The file is PROFILE_FILE in the current directory, or the one
+  that the environment variable MACHINE_PROFILE names.
+
+  The topology and the caches are read from /sys/devices/system on
+  Linux. Elsewhere the caches are asked from the processor with the
+  CPUID instruction on x86 (leaf 4, which Intel processors have), or
+  from sysconf, and the number of cores is taken to be the number of
+  processors that OpenMP sees. The latency is the time of a load that
+  misses all caches, measured by following a chain of pointers in
+  random order through an array much larger than the last cache. The
+  bandwidth is that of the STREAM triad a[i] = b[i] + s*c[i] with all
+  threads, counting the bytes that the program reads and writes.
+
+  The file has one value per line, as 'name value', and lines starting
+  with # are comments. A value that is missing from the file is probed
+  when the file is read.
+*/
+
+#include <stdio.h>
+
+#define PROFILE_FILE "machine.profile"
+#define PROFILE_MAXNODES 16
+
+typedef struct {
+  int cpus;                     /* Hardware threads */
+  int cores;
+  int sockets;
+  int smt;                      /* Hardware threads per core */
+  int nodes;                    /* NUMA nodes */
+  long cache[4];                /* Bytes of the L1 data, L2 and L3 caches, 0 if none */
+  int shared[4];                /* Hardware threads that share each of them */
+  int line;                     /* Cache line size in bytes */
+  int distance[PROFILE_MAXNODES][PROFILE_MAXNODES];  /* As in the ACPI SLIT, 10 is local */
+  double latency;               /* Memory latency in ns, 0 if not measured */
+  double bandwidth;             /* Memory bandwidth in GB/s, 0 if not measured */
+} machine_profile;
+
+/* Find the topology and the caches, without measuring */
+void profile_probe(machine_profile *p);
+
+/* Measure the latency and the bandwidth of the memory. Takes a few
+   seconds, and must be called outside of a parallel region */
+void profile_measure(machine_profile *p);
+
+/* Write the profile to a file, or read it. Both return 1 if they
+   succeed and 0 if not */
+int profile_save(const machine_profile *p, const char *file);
+int profile_load(machine_profile *p, const char *file);
+
+/* The name of the profile file */
+const char *profile_file(void);
+
+/* Read the profile file, or probe the machine if there is none. Returns
+   1 if the file was read */
+int profile_get(machine_profile *p);
+
+/* The number of threads to use: one per core, unless OMP_NUM_THREADS is
+   set */
+int profile_threads(const machine_profile *p);
+
+/* Print the profile */
+void profile_print(FILE *f, const machine_profile *p);
+
+#endif
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include "schedtune.h"
+
+/* The schedules that are tried. Chunk 0 is the default chunk size */
+static struct {
+  omp_sched_t kind;
+  int chunk;
+} candidates[] = {
+  {omp_sched_static, 0},
+  {omp_sched_static, 1},
+  {omp_sched_static, 16},
+  {omp_sched_dynamic, 1},
+  {omp_sched_dynamic, 16},
+  {omp_sched_dynamic, 64},
+  {omp_sched_guided, 1},
+  {omp_sched_guided, 16},
+  {omp_sched_auto, 0}
+};
+#define NCAND (int) (sizeof(candidates)/sizeof(candidates[0]))
+
+static struct {
+  int tuned;               /* 1 when the schedule has been chosen */
+  int runs;                /* Runs measured while trying */
+  double best[NCAND];      /* Shortest time of each candidate */
+  double start;
+  omp_sched_t kind;
+  int chunk;
+  omp_sched_t saved_kind;  /* The schedule before sched_tune_begin */
+  int saved_chunk;
+} loops[SCHED_MAXLOOPS];
+
+void sched_tune_begin(int id) {
+  int c;
+
+  if (id < 0 || id >= SCHED_MAXLOOPS) return;
+  omp_get_schedule(&loops[id].saved_kind, &loops[id].saved_chunk);
+  if (loops[id].tuned)
+    omp_set_schedule(loops[id].kind, loops[id].chunk);
+  else {
+    c = loops[id].runs/SCHED_TRIALS;
+    omp_set_schedule(candidates[c].kind, candidates[c].chunk);
+  }
+  loops[id].start = omp_get_wtime();
+}
+
+void sched_tune_end(int id) {
+  double t;
+  int c, best;
+
+  if (id < 0 || id >= SCHED_MAXLOOPS) return;
+  t = omp_get_wtime() - loops[id].start;
+  /* Other schedule(runtime) loops keep the schedule they had */
+  omp_set_schedule(loops[id].saved_kind, loops[id].saved_chunk);
+  if (loops[id].tuned) return;
+  c = loops[id].runs/SCHED_TRIALS;
+  if (loops[id].runs % SCHED_TRIALS == 0 || t < loops[id].best[c])
+    loops[id].best[c] = t;
+
+  if (++loops[id].runs == NCAND*SCHED_TRIALS) {
+    best = 0;
+    for (c=1; c<NCAND; c++)
+      if (loops[id].best[c] < loops[id].best[best]) best = c;
+    loops[id].kind = candidates[best].kind;
+    loops[id].chunk = candidates[best].chunk;
+    loops[id].tuned = 1;
+  }
+}
+
+int sched_tune_get(int id, omp_sched_t *kind, int *chunk) {
+  if (id < 0 || id >= SCHED_MAXLOOPS || !loops[id].tuned) return 0;
+  *kind = loops[id].kind;
+  *chunk = loops[id].chunk;
+  return 1;
+}
+
+void sched_tune_reset(int id) {
+  if (id < 0 || id >= SCHED_MAXLOOPS) return;
+  loops[id].tuned = 0;
+  loops[id].runs = 0;
+}
+
+const char *sched_name(omp_sched_t kind, int chunk, char *buf) {
+  const char *name;
+
+  switch (kind) {
+  case omp_sched_static: name = "static"; break;
+  case omp_sched_dynamic: name = "dynamic"; break;
+  case omp_sched_guided: name = "guided"; break;
+  default: name = "auto";
+  }
+  if (chunk > 0 && kind != omp_sched_auto)
+    sprintf(buf, "%s,%d", name, chunk);
+  else
+    sprintf(buf, "%s", name);
+  return buf;
+}
@@ -0,0 +1,50 @@
+#ifndef SCHEDTUNE_H
+#define SCHEDTUNE_H
+
+/*
+  Run-time tuning of the schedule of OpenMP loops.
+
+  A loop that is run many times, for example once per time step, gets
+  an id chosen by the program, and is written with schedule(runtime):
+
+    sched_tune_begin(id);
+  #pragma omp parallel for schedule(runtime)
+    for (i=0; i<n; i++)
+      ...
+    sched_tune_end(id);
+
+  During the first runs of the loop sched_tune_begin sets a different
+  schedule with omp_set_schedule every time, and sched_tune_end measures
+  the time. sched_tune_end then sets the schedule back to what it was
+  before sched_tune_begin, so other schedule(runtime) loops are not
+  affected. When all the candidates have been tried the fastest one is
+  kept for that id and used for all later runs. Each loop id has its own
+  schedule, so loops with different kinds of work get different ones.
+
+  The candidates are static, dynamic and guided with some chunk sizes,
+  and auto. Every candidate is tried SCHED_TRIALS times and the shortest
+  time counts, so that a single disturbed run does not decide.
+
+  The functions must be called outside of parallel regions.
+*/
+
+#include <omp.h>
+
+#define SCHED_MAXLOOPS 64
+#define SCHED_TRIALS 2
+
+/* Start and end of a run of loop id, 0 <= id < SCHED_MAXLOOPS */
+void sched_tune_begin(int id);
+void sched_tune_end(int id);
+
+/* Returns 1 and the chosen schedule when loop id has been tuned, or 0
+   while it is still trying */
+int sched_tune_get(int id, omp_sched_t *kind, int *chunk);
+
+/* Forget the schedule of loop id, for example if the work has changed */
+void sched_tune_reset(int id);
+
+/* A name such as "dynamic,16" for a schedule */
+const char *sched_name(omp_sched_t kind, int chunk, char *buf);
+
+#endif